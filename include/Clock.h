@@ -0,0 +1,159 @@
+// Copyright 2017-2019 Paul Nettle
+//
+// This file is part of Gobbledegook.
+//
+// Use of this source code is governed by a BSD-style license that can be found
+// in the LICENSE file in the root of the source tree.
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//
+// >>
+// >>>  INSIDE THIS FILE
+// >>
+//
+// The server's source of time: time queries, sleeps, waits and main loop timers
+//
+// >>
+// >>>  DISCUSSION
+// >>
+//
+// See the discussion at the top of Clock.cpp
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+#pragma once
+
+#include <glib.h>
+#include <stdint.h>
+#include <time.h>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+
+namespace ggk {
+
+// ---------------------------------------------------------------------------------------------------------------------------------
+// Clock interface
+// ---------------------------------------------------------------------------------------------------------------------------------
+
+// Timing measurements for a periodic timer (see `Clock::addPeriodicTimer()`)
+//
+// Lateness is how long after its deadline each call was dispatched. Jitter is the standard deviation of the lateness. Drift is the
+// lateness of the most recent call minus that of the first, so a timer that keeps to its grid shows a drift near zero however long
+// it runs.
+struct PeriodicTimerStats
+{
+	uint64_t intervalUS;
+	uint64_t calls;
+	uint64_t missedDeadlines;
+	uint64_t minLatenessUS;
+	uint64_t maxLatenessUS;
+	uint64_t meanLatenessUS;
+	uint64_t jitterUS;
+	int64_t driftUS;
+};
+
+// Clocks are shared: the main loop timers a clock adds hold a reference to it, so a clock must be owned by a `std::shared_ptr` (as
+// `setInstance()` requires) before any of its timers are added.
+class Clock : public std::enable_shared_from_this<Clock>
+{
+public:
+	// Called each time a periodic timer (see `addPeriodicTimer()`) serves a deadline
+	//
+	// `deadlineUS` is the deadline being served, on the `getMonotonicUS()` time line. `missed` is the number of deadlines that
+	// passed unserved since the previous call because the main loop fell behind. Return FALSE to remove the timer.
+	typedef gboolean (*PeriodicFunc)(uint64_t deadlineUS, uint64_t missed, gpointer pUserData);
+
+	virtual ~Clock() {}
+
+	// Returns a monotonic time in microseconds (the starting point is arbitrary)
+	virtual uint64_t getMonotonicUS() const = 0;
+
+	// Returns the wall clock time, as `time()` would
+	virtual time_t getWallTime() const = 0;
+
+	// Blocks the calling thread for `milliseconds`
+	virtual void sleepMS(int milliseconds) = 0;
+
+	// Waits up to `timeoutMS` for `fd` to become readable
+	//
+	// Returns a positive value if the descriptor is readable, 0 on timeout or a negative value on error (as `select()` does)
+	virtual int waitReadable(int fd, int timeoutMS);
+
+	// Adds a timer to the default main context that calls `func` every `intervalMS` until it returns FALSE
+	//
+	// Returns the source ID (for `g_source_remove()`), or 0 on failure
+	virtual guint addTimeout(unsigned int intervalMS, GSourceFunc func, gpointer pUserData) = 0;
+
+	// Same as `addTimeout()`, but with an interval in seconds
+	virtual guint addTimeoutSeconds(unsigned int intervalSeconds, GSourceFunc func, gpointer pUserData) = 0;
+
+	// Adds a timer to the default main context that calls `func` on a fixed grid of deadlines, `intervalUS` apart, starting
+	// `intervalUS` from now
+	//
+	// Deadlines are absolute, so a late call never delays the ones after it. If the main loop falls more than a period behind, the
+	// deadlines it missed are skipped and reported through `func`'s `missed` parameter rather than served in a burst.
+	//
+	// This version polls `getMonotonicUS()` from the main loop. Returns the source ID (for `g_source_remove()`), or 0 on failure.
+	virtual guint addPeriodicTimer(uint64_t intervalUS, PeriodicFunc func, gpointer pUserData);
+
+	// Copies the timing measurements of the periodic timer with source ID `sourceId` into `stats`
+	//
+	// Returns false if there is no such periodic timer. This is safe to call from any thread.
+	static bool getPeriodicTimerStats(guint sourceId, PeriodicTimerStats &stats);
+
+	// Returns the clock used by the server
+	static Clock &getInstance();
+
+	// Replaces the clock used by the server. Passing nullptr restores the system clock.
+	//
+	// The clock can only be replaced while the server is stopped (or not yet started), since the server's threads hold on to the
+	// clock they are using. Returns false (and leaves the clock as it is) if the server is running.
+	static bool setInstance(std::shared_ptr<Clock> pClock);
+};
+
+// ---------------------------------------------------------------------------------------------------------------------------------
+// Real time
+// ---------------------------------------------------------------------------------------------------------------------------------
+
+class SystemClock : public Clock
+{
+public:
+	virtual uint64_t getMonotonicUS() const;
+	virtual time_t getWallTime() const;
+	virtual void sleepMS(int milliseconds);
+	virtual guint addTimeout(unsigned int intervalMS, GSourceFunc func, gpointer pUserData);
+	virtual guint addTimeoutSeconds(unsigned int intervalSeconds, GSourceFunc func, gpointer pUserData);
+
+	// Same as `Clock::addPeriodicTimer()`, but driven by a `timerfd` with absolute CLOCK_MONOTONIC deadlines
+	virtual guint addPeriodicTimer(uint64_t intervalUS, PeriodicFunc func, gpointer pUserData);
+};
+
+// ---------------------------------------------------------------------------------------------------------------------------------
+// Virtual time
+// ---------------------------------------------------------------------------------------------------------------------------------
+
+class VirtualClock : public Clock
+{
+public:
+	// Starts the clock at the given wall clock time, with a monotonic time of zero
+	VirtualClock(time_t startWallTime);
+
+	virtual uint64_t getMonotonicUS() const;
+	virtual time_t getWallTime() const;
+	virtual void sleepMS(int milliseconds);
+	virtual guint addTimeout(unsigned int intervalMS, GSourceFunc func, gpointer pUserData);
+	virtual guint addTimeoutSeconds(unsigned int intervalSeconds, GSourceFunc func, gpointer pUserData);
+
+	// Moves time forward by `milliseconds`
+	//
+	// Timers that come due fire on the main loop once for each of their periods that has elapsed.
+	void advanceMS(uint64_t milliseconds);
+
+private:
+	mutable std::mutex timeMutex;
+	std::condition_variable timeAdvanced;
+	uint64_t nowUS;
+	time_t startWallTime;
+};
+
+}; // namespace ggk
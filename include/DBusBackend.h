@@ -0,0 +1,200 @@
+// Copyright 2017-2019 Paul Nettle
+//
+// This file is part of Gobbledegook.
+//
+// Use of this source code is governed by a BSD-style license that can be found
+// in the LICENSE file in the root of the source tree.
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//
+// >>
+// >>>  INSIDE THIS FILE
+// >>
+//
+// This is the interface to the D-Bus transport used by the server (GDBus or sd-bus)
+//
+// >>
+// >>>  DISCUSSION
+// >>
+//
+// See the discussion at the top of DBusBackend.cpp
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+#pragma once
+
+#include <gio/gio.h>
+#include <stdint.h>
+#include <string>
+
+#include "DBusObjectPath.h"
+
+namespace ggk {
+
+struct DBusObject;
+
+struct DBusBackend
+{
+	//
+	// Callback types
+	//
+
+	// Called once the bus connection is available (pConnection is non-null) or could not be established (pErrorMessage is set)
+	typedef void (*BusAcquiredCallback)(GDBusConnection *pConnection, const char *pErrorMessage);
+
+	// Called when our owned name is acquired or lost
+	typedef void (*NameCallback)(const char *pName);
+
+	// Called with the reply to an outgoing method call. On failure, `pReply` is null and `pErrorMessage` is set. The reply is
+	// owned by the backend and is only valid for the duration of the callback.
+	typedef void (*CallReplyCallback)(GVariant *pReply, const char *pErrorMessage, void *pUserData);
+
+	// Called when a subscribed signal arrives. The parameters are owned by the backend and are only valid for the duration of
+	// the callback.
+	typedef void (*SignalCallback)(const char *pObjectPath, GVariant *pParameters, void *pUserData);
+
+	// Our dispatch table for incoming method calls and property access
+	//
+	// These have the same shape as their GDBus counterparts so the server's handlers can be used with any backend.
+	struct Dispatch
+	{
+		GDBusInterfaceMethodCallFunc methodCall;
+		GDBusInterfaceGetPropertyFunc getProperty;
+		GDBusInterfaceSetPropertyFunc setProperty;
+	};
+
+	// Message counters, used to compare backends
+	struct Stats
+	{
+		uint64_t methodCallsIn;
+		uint64_t methodCallsOut;
+		uint64_t methodReplies;
+		uint64_t signalsOut;
+		uint64_t errors;
+	};
+
+	// Returns the backend selected at configure time (see `--with-dbus-backend`)
+	static DBusBackend &getInstance();
+
+	virtual ~DBusBackend() {}
+
+	// Returns a short name for the backend ("gdbus" or "sd-bus")
+	virtual const char *getName() const = 0;
+
+	// Returns the message counters for this backend
+	const Stats &getStats() const { return stats; }
+
+	//
+	// Bus connection
+	//
+
+	// Asynchronously connect to the SYSTEM bus. The callback is always called from the main loop.
+	virtual void acquireBus(BusAcquiredCallback callback) = 0;
+
+	// Release the bus connection
+	virtual void releaseBus() = 0;
+
+	// Returns the connection handle passed to all server callbacks, or nullptr if we are not connected
+	//
+	// IMPORTANT: This is only a real `GDBusConnection` with the GDBus backend. With other backends, it is an opaque handle and
+	// must not be passed to GIO.
+	virtual GDBusConnection *getConnection() const = 0;
+
+	//
+	// Name ownership
+	//
+
+	// Request an owned name on the bus
+	virtual bool ownName(const std::string &name, NameCallback acquiredCallback, NameCallback lostCallback) = 0;
+
+	// Release our owned name, if we have one
+	virtual void unownName() = 0;
+
+	//
+	// Object registration
+	//
+
+	// Register an object (and its children) with the bus, dispatching all method calls and property access through `dispatch`
+	virtual bool registerObject(const DBusObject &object, const Dispatch &dispatch) = 0;
+
+	// Unregister all objects registered through `registerObject()`
+	virtual void unregisterObjects() = 0;
+
+	// Returns true if any objects are registered
+	virtual bool hasRegisteredObjects() const = 0;
+
+	//
+	// Method replies
+	//
+	// Both of these take ownership of the invocation. `pParameters` must be a tuple; floating references are consumed.
+	//
+
+	// Reply to a method invocation with a value
+	virtual void methodReturnValue(GDBusMethodInvocation *pInvocation, GVariant *pParameters) = 0;
+
+	// Reply to a method invocation with a D-Bus error
+	virtual void methodReturnError(GDBusMethodInvocation *pInvocation, const std::string &errorName, const std::string &errorMessage) = 0;
+
+	// Returns true if the most recent reply sent from this thread was an error reply to `pInvocation`
+	//
+	// A handler's caller can use this, right after the handler returns, to learn whether it failed.
+	static bool lastReplyWasError(GDBusMethodInvocation *pInvocation);
+
+	//
+	// Local invocations
+	//
+	// A local invocation lets the server call one of its own method handlers and collect the reply instead of sending it over the
+	// bus. The handle is passed to the handler in place of a real invocation; both reply methods above recognize it.
+	//
+
+	// Creates an invocation handle whose reply is captured rather than sent
+	static GDBusMethodInvocation *beginLocalInvocation();
+
+	// Finishes a local invocation and returns its reply (with a reference owned by the caller), or nullptr if the handler replied
+	// with an error, with no value or not at all. The handle must not be used after this call.
+	//
+	// A handler that has not replied yet may still do so later; that reply is discarded.
+	static GVariant *endLocalInvocation(GDBusMethodInvocation *pInvocation);
+
+	//
+	// Signals
+	//
+
+	// Emit a signal from `path`. `pParameters` must be a tuple; floating references are consumed.
+	virtual bool emitSignal(GDBusConnection *pConnection, const DBusObjectPath &path, const std::string &interfaceName, const std::string &signalName, GVariant *pParameters) = 0;
+
+	//
+	// Outgoing method calls
+	//
+
+	// Asynchronously call a method on a remote object. `pParameters` must be a tuple (or nullptr); floating references are
+	// consumed.
+	virtual void callMethod(const std::string &busName, const DBusObjectPath &path, const std::string &interfaceName, const std::string &methodName, GVariant *pParameters, CallReplyCallback callback, void *pUserData) = 0;
+
+	//
+	// Signal subscriptions
+	//
+
+	// Subscribe to a signal sent by `busName`. The callback is always called from the main loop.
+	//
+	// Only signals whose first argument is the object path `arg0Path` are delivered. This filter is part of the match rule, so the
+	// bus daemon drops everything else before it ever reaches us.
+	//
+	// Returns a subscription ID, or 0 on failure
+	virtual unsigned int subscribeSignal(const std::string &busName, const std::string &interfaceName, const std::string &signalName, const DBusObjectPath &arg0Path, SignalCallback callback, void *pUserData) = 0;
+
+	// Cancel a subscription made with `subscribeSignal()`
+	virtual void unsubscribeSignal(unsigned int subscriptionId) = 0;
+
+protected:
+	DBusBackend() : stats() {}
+
+	// If `pInvocation` is a local invocation, records its reply (consuming a floating reference to `pParameters`) and returns true
+	//
+	// Backends call this before sending any method reply. `pErrorName` is set for error replies. It also notes the reply for
+	// `lastReplyWasError()`.
+	static bool completeLocalInvocation(GDBusMethodInvocation *pInvocation, GVariant *pParameters, const char *pErrorName);
+
+	Stats stats;
+};
+
+}; // namespace ggk
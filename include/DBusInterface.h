@@ -23,6 +23,7 @@
 #pragma once
 
 #include <gio/gio.h>
+#include <memory>
 #include <string>
 #include <list>
 
@@ -104,6 +105,9 @@ struct DBusInterface
 
 	DBusInterface &addMethod(const std::string &name, const char *pInArgs[], const char *pOutArgs, DBusMethod::Callback callback);
 
+	// Returns the methods added with `addMethod()`
+	const std::list<DBusMethod> &getMethods() const;
+
 	// NOTE: Subclasses are encouraged to override this method in order to support different callback types that are specific to
 	// their subclass type.
 	virtual bool callMethod(const std::string &methodName, GDBusConnection *pConnection, GVariant *pParameters, GDBusMethodInvocation *pInvocation, gpointer pUserData) const;
@@ -119,14 +123,17 @@ struct DBusInterface
 
 	// NOTE: Subclasses are encouraged to override this method in order to support different callback types that are specific to
 	// their subclass type.
-	virtual void tickEvents(GDBusConnection *pConnection, void *pUserData) const;
+	//
+	// `ticks` is the number of periodic timer ticks that have passed since the last call (more than one if the timer missed
+	// deadlines)
+	virtual void tickEvents(GDBusConnection *pConnection, void *pUserData, int ticks = 1) const;
 
 	// Internal method used to generate introspection XML used to describe our services on D-Bus
 	virtual std::string generateIntrospectionXML(int depth) const;
 
 protected:
 	DBusObject &owner;
-	std::string name;
+	std::shared_ptr<const std::string> name;
 	std::list<DBusMethod> methods;
 	std::list<TickEvent> events;
 };
@@ -33,7 +33,9 @@
 #include <vector>
 
 #include "Globals.h"
+#include "DBusBackend.h"
 #include "DBusObjectPath.h"
+#include "HandlerProfiler.h"
 #include "Logger.h"
 #include "Server.h"
 
@@ -91,11 +93,12 @@ struct DBusMethod
 		if (!callback)
 		{
 			Logger::error(std::ostringstream().flush() << "DBusMethod contains no callback: [" << path << "]:[" << interfaceName << "]:[" << methodName << "]");
-			g_dbus_method_invocation_return_dbus_error(pInvocation, kErrorNotImplemented.c_str(), "This method is not implemented");
+			DBusBackend::getInstance().methodReturnError(pInvocation, kErrorNotImplemented, "This method is not implemented");
 			return;
 		}
 
 		Logger::info(std::ostringstream().flush() << "Calling method: [" << path << "]:[" << interfaceName << "]:[" << methodName << "]");
+		HandlerProfiler::Scope profile(HandlerProfiler::EMethod, path.c_str(), methodName.c_str());
 		callback(*static_cast<const T *>(pOwner), pConnection, methodName, pParameters, pInvocation, pUserData);
 	}
 
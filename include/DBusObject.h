@@ -109,7 +109,10 @@ struct DBusObject
 	bool callMethod(const DBusObjectPath &path, const std::string &interfaceName, const std::string &methodName, GDBusConnection *pConnection, GVariant *pParameters, GDBusMethodInvocation *pInvocation, gpointer pUserData, const DBusObjectPath &basePath = DBusObjectPath()) const;
 
 	// Periodic timer tick propagation
-	void tickEvents(GDBusConnection *pConnection, void *pUserData = nullptr) const;
+	//
+	// `ticks` is the number of periodic timer ticks that have passed since the last call (more than one if the timer missed
+	// deadlines)
+	void tickEvents(GDBusConnection *pConnection, void *pUserData = nullptr, int ticks = 1) const;
 
 	// -----------------------------------------------------------------------------------------------------------------------------
 	// D-Bus signals
@@ -26,6 +26,8 @@
 #include <gio/gio.h>
 #include <string>
 #include <list>
+#include <atomic>
+#include <vector>
 
 #include "Utils.h"
 #include "TickEvent.h"
@@ -56,6 +58,12 @@ struct DBusObject;
 	void *pUserData \
 ) -> bool
 
+#define CHARACTERISTIC_COMPUTE_VALUE_CALLBACK_LAMBDA [] \
+( \
+	const ggk::GattCharacteristic &self, \
+	void *pUserData \
+) -> GVariant *
+
 #define CHARACTERISTIC_EVENT_CALLBACK_LAMBDA [] \
 ( \
 	const ggk::GattCharacteristic &self, \
@@ -86,6 +94,48 @@ struct GattCharacteristic : GattInterface
 	typedef void (*MethodCallback)(const GattCharacteristic &self, GDBusConnection *pConnection, const std::string &methodName, GVariant *pParameters, GDBusMethodInvocation *pInvocation, void *pUserData);
 	typedef void (*EventCallback)(const GattCharacteristic &self, const TickEvent &event, GDBusConnection *pConnection, void *pUserData);
 	typedef bool (*UpdatedValueCallback)(const GattCharacteristic &self, GDBusConnection *pConnection, void *pUserData);
+	typedef GVariant *(*ComputeValueCallback)(const GattCharacteristic &self, void *pUserData);
+
+	// The link quality of the connected devices, as seen by a characteristic's `LinkQualityPolicy`
+	enum LinkQuality
+	{
+		ELinkQualityGood,
+		ELinkQualityDegraded,
+		ELinkQualityPoor
+	};
+
+	// How important a characteristic's notifications are when the server is overloaded
+	//
+	// Notifications from low priority characteristics are the first to be dropped (see `GGKOverloadLevel` in Gobbledegook.h.)
+	enum NotifyPriority
+	{
+		ENotifyPriorityNormal,
+		ENotifyPriorityLow
+	};
+
+	// Describes how a characteristic's notifications adapt to the link quality of the connected devices
+	//
+	// Notifications go to every subscriber, so the weakest RSSI among the connected devices sets the link quality. At or below
+	// `degradedRssi` (dBm) the link is degraded and at or below `poorRssi` it is poor. In each of those states, the
+	// characteristic's tick events fire `*TickMultiplier` times less often and byte array notifications are limited to
+	// `*MaxPayload` bytes (0 means no limit.)
+	//
+	// Handlers should check `getNotifyPayloadLimit()` and send a value that fits. A larger value is not sent at all, since
+	// cutting a structured value short would hand the client a corrupt value it can't tell from a good one. Set
+	// `truncateOversize` for values where a prefix is still meaningful, and they are cut to the limit instead.
+	//
+	// Link quality comes from periodic polling (see `Server::getConnectionInfoPollIntervalMS()`.) Until the first poll
+	// completes, the link is considered good.
+	struct LinkQualityPolicy
+	{
+		int8_t degradedRssi;
+		int degradedTickMultiplier;
+		size_t degradedMaxPayload;
+		int8_t poorRssi;
+		int poorTickMultiplier;
+		size_t poorMaxPayload;
+		bool truncateOversize;
+	};
 
 	// Construct a GattCharacteristic
 	//
@@ -103,18 +153,102 @@ struct GattCharacteristic : GattInterface
 	GattService &gattCharacteristicEnd();
 
 	// Locates a D-Bus method within this D-Bus interface and invokes the method
+	//
+	// Reads of a characteristic with conditional reads enabled are answered by ConditionalRead, which calls `callHandler()` for
+	// the value.
 	virtual bool callMethod(const std::string &methodName, GDBusConnection *pConnection, GVariant *pParameters, GDBusMethodInvocation *pInvocation, gpointer pUserData) const;
 
+	// Invokes the handler registered for a D-Bus method directly, with this characteristic's data keys prefetched
+	//
+	// Returns false if there is no handler for `methodName`
+	bool callHandler(const std::string &methodName, GDBusConnection *pConnection, GVariant *pParameters, GDBusMethodInvocation *pInvocation, gpointer pUserData) const;
+
 	// Adds an event to the characteristic and returns a refereence to 'this` to enable method chaining in the server description
 	//
 	// NOTE: We specifically overload this method in order to accept our custom EventCallback type and transform it into a
 	// TickEvent::Callback type. We also return our own type. This simplifies the server description by allowing call to chain.
 	GattCharacteristic &onEvent(int tickFrequency, void *pUserData, EventCallback callback);
 
+	// Declares a link quality policy for this characteristic and returns a reference to 'this' to enable method chaining in the
+	// server description
+	//
+	// See `LinkQualityPolicy` for details.
+	GattCharacteristic &linkQualityPolicy(const LinkQualityPolicy &policy);
+
+	// Returns the current link quality as judged by this characteristic's policy
+	//
+	// Characteristics without a policy always report `ELinkQualityGood`
+	LinkQuality getLinkQuality() const;
+
+	// Returns the maximum notification payload size for the current link quality, or 0 if there is no limit
+	//
+	// Handlers should use this to send a smaller representation of their value, since larger values are not sent (see
+	// `LinkQualityPolicy`.)
+	size_t getNotifyPayloadLimit() const;
+
+	// Sets the priority of this characteristic's notifications and returns a reference to 'this' to enable method chaining in the
+	// server description
+	//
+	// See `NotifyPriority` for details.
+	GattCharacteristic &notifyPriority(NotifyPriority priority);
+
+	// Returns the priority of this characteristic's notifications
+	NotifyPriority getNotifyPriority() const { return priority; }
+
+	// Sends this characteristic's queued updates through its service's aggregation channel and returns a reference to 'this' to
+	// enable method chaining in the server description
+	//
+	// `recordId` identifies this characteristic's records within the channel's notifications. See
+	// `GattService::gattAggregationCharacteristicBegin()`.
+	GattCharacteristic &aggregate(uint8_t recordId);
+
+	// Returns true if this characteristic's updates go through an aggregation channel
+	bool isAggregated() const { return bAggregated; }
+
+	// Returns this characteristic's record ID within its aggregation channel
+	uint8_t getAggregateId() const { return aggregateId; }
+
+	// Returns the service this characteristic belongs to
+	const GattService &getService() const { return service; }
+
+	// Declares the server data keys this characteristic's handlers read and returns a reference to 'this' to enable method chaining
+	// in the server description
+	//
+	// The keys are fetched together (through the application's `GGKServerDataBatchGetter`, if it registered one) before each of
+	// this characteristic's handlers runs, so `getDataValue()` and `getDataPointer()` don't call the data getter once per key. See
+	// DataPrefetch.cpp.
+	GattCharacteristic &dataKeys(const std::vector<std::string> &keys);
+
+	// Returns the server data keys declared with `dataKeys()`
+	const std::vector<std::string> &getDataKeys() const { return dataKeyNames; }
+
+	// Lets clients skip re-reading a value they already have, and returns a reference to 'this' to enable method chaining in the
+	// server description
+	//
+	// A descriptor is added through which a client opts in by telling us the version it last saw. Reads from that client are
+	// answered with the value's version ahead of the value, or a one-byte "unchanged" reply if it is up to date. Other clients
+	// read the plain value. See ConditionalRead.cpp for the protocol.
+	GattCharacteristic &conditionalReads();
+
+	// Returns true if conditional reads are enabled (see `conditionalReads()`)
+	bool hasConditionalReads() const { return bConditionalReads; }
+
+	// Returns the version of this characteristic's value
+	//
+	// The version starts at 1 and goes up whenever the value may have changed: when a client writes it successfully and when a
+	// change notification is sent for it (on its own or as a record on an aggregation channel.)
+	uint32_t getValueVersion() const { return valueVersion.load(); }
+
+	// Records that this characteristic's value has changed without a notification (see `getValueVersion()`)
+	void markValueChanged() const;
+
 	// Ticks events within this characteristic
 	//
 	// Note: we specifically override this method in order to translate the generic TickEvent::Callback into our own EventCallback
-	virtual void tickEvents(GDBusConnection *pConnection, void *pUserData) const;
+	//
+	// `ticks` is the number of periodic timer ticks that have passed since the last call (more than one if the timer missed
+	// deadlines)
+	virtual void tickEvents(GDBusConnection *pConnection, void *pUserData, int ticks = 1) const;
 
 	// Specialized support for Characteristic ReadlValue method
 	//
@@ -149,6 +283,34 @@ struct GattCharacteristic : GattInterface
 	// `callOnUpdatedValue` for more information.
 	GattCharacteristic &onUpdatedValue(UpdatedValueCallback callback);
 
+	// Custom support for computing a characteristic's updated value off the main loop
+	//
+	// Defined as: (NOT defined by Bluetooth or BlueZ - this method is internal only)
+	//
+	// When set, this replaces `onUpdatedValue` for updates coming through the update queue (`ggkNofifyUpdatedCharacteristic()`.)
+	// The callback is called on a worker thread, in parallel with the callbacks of other updated characteristics. It should fetch
+	// its data, encode it and return the new value (for example, from `Utils::gvariantFromByteArray()`), or return nullptr to skip
+	// the notification. The server then sends all of the computed values as change notifications from the main loop.
+	//
+	// Because it runs on a worker thread, the callback must not send notifications or make D-Bus calls itself, and the data
+	// getter it uses must be thread-safe.
+	GattCharacteristic &onComputeValue(ComputeValueCallback callback);
+
+	// Returns true if an onComputeValue method was set
+	bool hasComputeValue() const { return nullptr != pOnComputeValueFunc; }
+
+	// Calls the onComputeValue method, if one was set
+	//
+	// Returns the computed value with a reference owned by the caller, or nullptr if there was no method or no value
+	GVariant *callOnComputeValue(void *pUserData) const;
+
+	// Reads this characteristic's current value through its own `onReadValue` method (or its `onComputeValue` method, if it has
+	// no `onReadValue`) without going through D-Bus
+	//
+	// Returns the byte array value with a reference owned by the caller, or nullptr if no value was returned. If `pReadable` is
+	// not null, it is set to false if the characteristic has neither method.
+	GVariant *readValueLocally(GDBusConnection *pConnection, bool *pReadable = nullptr) const;
+
 	// Calls the onUpdatedValue method, if one was set.
 	//
 	// Returns false if there was no method set, otherwise, returns the boolean result of the method call.
@@ -195,6 +357,9 @@ struct GattCharacteristic : GattInterface
 	//
 	// The caller may choose to consult HciAdapter::getInstance().getActiveConnectionCount() in order to determine if there are any
 	// active connections before sending a change notification.
+	//
+	// If this characteristic has a link quality policy, byte array values larger than `getNotifyPayloadLimit()` bytes are not
+	// sent, or are truncated to that size if the policy's `truncateOversize` is set.
 	void sendChangeNotificationVariant(GDBusConnection *pBusConnection, GVariant *pNewValue) const;
 
 	// Sends a change notification to subscribers to this characteristic
@@ -215,6 +380,15 @@ protected:
 
 	GattService &service;
 	UpdatedValueCallback pOnUpdatedValueFunc;
+	ComputeValueCallback pOnComputeValueFunc;
+	bool hasLinkQualityPolicy;
+	LinkQualityPolicy linkPolicy;
+	NotifyPriority priority;
+	bool bAggregated;
+	uint8_t aggregateId;
+	std::vector<std::string> dataKeyNames;
+	bool bConditionalReads;
+	mutable std::atomic<uint32_t> valueVersion;
 };
 
 }; // namespace ggk
\ No newline at end of file
@@ -102,6 +102,9 @@ struct GattDescriptor : GattInterface
 	// This method compliments `GattCharacteristic::gattDescriptorBegin()`
 	GattCharacteristic &gattDescriptorEnd();
 
+	// Returns the characteristic this descriptor belongs to
+	const GattCharacteristic &getCharacteristic() const { return characteristic; }
+
 	// Locates a D-Bus method within this D-Bus interface and invokes the method
 	virtual bool callMethod(const std::string &methodName, GDBusConnection *pConnection, GVariant *pParameters, GDBusMethodInvocation *pInvocation, gpointer pUserData) const;
 
@@ -114,7 +117,10 @@ struct GattDescriptor : GattInterface
 	// Ticks events within this descriptor
 	//
 	// Note: we specifically override this method in order to translate the generic TickEvent::Callback into our own EventCallback
-	virtual void tickEvents(GDBusConnection *pConnection, void *pUserData) const;
+	//
+	// `ticks` is the number of periodic timer ticks that have passed since the last call (more than one if the timer missed
+	// deadlines)
+	virtual void tickEvents(GDBusConnection *pConnection, void *pUserData, int ticks = 1) const;
 
 	// Specialized support for Descriptor ReadlValue method
 	//
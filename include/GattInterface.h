@@ -31,6 +31,7 @@
 #include "GattProperty.h"
 #include "GattUuid.h"
 #include "Server.h"
+#include "SnapshotGroup.h"
 #include "Utils.h"
 
 namespace ggk {
@@ -132,6 +133,30 @@ struct GattInterface : DBusInterface
 		return addProperty<T>(GattProperty(name, Utils::gvariantFromBoolean(value), getter, setter));
 	}
 
+	// Return a raw data pointer from the server's registered data getter (GGKServerDataGetter), or from the values prefetched for
+	// the current handler (see `GattCharacteristic::dataKeys()`)
+	//
+	// In general, use `getDataValue()` or `getDataPointer()` instead.
+	const void *getData(const char *pName) const;
+
+	// Sends a raw data pointer to the server's registered data setter (GGKServerDataSetter), forgetting any value prefetched for
+	// `pName` so that later reads see the change
+	//
+	// In general, use `setDataValue()` or `setDataPointer()` instead.
+	bool setData(const char *pName, const void *pData) const;
+
+	// Fetches several data pointers at once, through the application's batch data getter (GGKServerDataBatchGetter) if it
+	// registered one
+	//
+	// `ppValues[i]` receives the value for `ppNames[i]`, or nullptr if there is none. Returns the number of values found.
+	//
+	// This method is intended to be used in the server description. An example usage would be:
+	//
+	//     const char *names[] = { "sensors/x", "sensors/y", "sensors/z" };
+	//     const void *values[3];
+	//     self.getDataPointers(names, values, 3);
+	int getDataPointers(const char *const *ppNames, const void **ppValues, int count) const;
+
 	// Return a data value from the server's registered data getter (GGKServerDataGetter)
 	//
 	// This method is for use with non-pointer types. For pointer types, use `getDataPointer()` instead.
@@ -142,7 +167,7 @@ struct GattInterface : DBusInterface
 	template<typename T>
 	T getDataValue(const char *pName, const T defaultValue) const
 	{
-		const void *pData = TheServer->getDataGetter()(pName);
+		const void *pData = getData(pName);
 		return nullptr == pData ? defaultValue : *static_cast<const T *>(pData);
 	}
 
@@ -156,10 +181,27 @@ struct GattInterface : DBusInterface
 	template<typename T>
 	T getDataPointer(const char *pName, const T defaultValue) const
 	{
-		const void *pData = TheServer->getDataGetter()(pName);
+		const void *pData = getData(pName);
 		return nullptr == pData ? defaultValue : static_cast<const T>(pData);
 	}
 
+	// Return a consistent copy of a snapshot group (see `ggkSnapshotGroupCreate()`)
+	//
+	// All members of the group are guaranteed to come from the same publish. This never blocks on the application's producer
+	// threads. If the group doesn't exist, doesn't match the size of T, or a consistent copy could not be made, `defaultValue` is
+	// returned.
+	//
+	// This method is intended to be used in the server description. An example usage would be:
+	//
+	//     AccelSample sample = self.getSnapshot<AccelSample>("sensors/accel", AccelSample());
+	template<typename T>
+	T getSnapshot(const char *pGroupName, const T &defaultValue) const
+	{
+		T snapshot;
+		SnapshotGroup *pGroup = SnapshotGroup::find(pGroupName);
+		return nullptr != pGroup && pGroup->read(&snapshot, sizeof(T)) ? snapshot : defaultValue;
+	}
+
 	// Sends a data value from the server back to the application through the server's registered data setter
 	// (GGKServerDataSetter)
 	//
@@ -171,7 +213,7 @@ struct GattInterface : DBusInterface
 	template<typename T>
 	bool setDataValue(const char *pName, const T value) const
 	{
-		return TheServer->getDataSetter()(pName, static_cast<const void *>(&value)) != 0;
+		return setData(pName, static_cast<const void *>(&value));
 	}
 
 	// Sends a data pointer from the server back to the application through the server's registered data setter
@@ -185,7 +227,7 @@ struct GattInterface : DBusInterface
 	template<typename T>
 	bool setDataPointer(const char *pName, const T pointer) const
 	{
-		return TheServer->getDataSetter()(pName, static_cast<const void *>(pointer)) != 0;
+		return setData(pName, static_cast<const void *>(pointer));
 	}
 
 	// When responding to a ReadValue method, we need to return a GVariant value in the form "(ay)" (a tuple containing an array of
@@ -209,10 +251,30 @@ struct GattInterface : DBusInterface
 		methodReturnVariant(pInvocation, pVariant, wrapInTuple);
 	}
 
+	// Changes the value of one of this interface's properties while the server is running
+	//
+	// The change is applied on the main loop at the start of the next idle pass, along with any other changes made since the last
+	// one, and announced to BlueZ with a single `PropertiesChanged` signal for this interface. Until then, the property keeps its
+	// previous value. This method may be called from any thread.
+	//
+	// A floating `pValue` is sunk; otherwise the property takes its own reference to it. Returns false (and releases a floating
+	// `pValue`) if this interface has no property called `name`.
+	//
+	// This is the generalized form that accepts a GVariant *. There are helper methods (`updateProperty()`) for common types.
+	bool updatePropertyVariant(const std::string &name, GVariant *pValue) const;
+
+	// Helper methods for changing the value of a property with common types (see `updatePropertyVariant()`)
+	bool updateProperty(const std::string &name, const std::string &str) const { return updatePropertyVariant(name, Utils::gvariantFromString(str)); }
+	bool updateProperty(const std::string &name, const char *pStr) const { return updatePropertyVariant(name, Utils::gvariantFromString(pStr)); }
+	bool updateProperty(const std::string &name, const std::vector<std::string> &arr) const { return updatePropertyVariant(name, Utils::gvariantFromStringArray(arr)); }
+	bool updateProperty(const std::string &name, const std::vector<const char *> &arr) const { return updatePropertyVariant(name, Utils::gvariantFromStringArray(arr)); }
+	bool updateProperty(const std::string &name, bool value) const { return updatePropertyVariant(name, Utils::gvariantFromBoolean(value)); }
+
 	// Locates a `GattProperty` within the interface
 	//
 	// This method returns a pointer to the property or nullptr if not found
 	const GattProperty *findProperty(const std::string &name) const;
+	GattProperty *findProperty(const std::string &name);
 
 	// Internal method used to generate introspection XML used to describe our services on D-Bus
 	virtual std::string generateIntrospectionXML(int depth) const;
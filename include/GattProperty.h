@@ -23,6 +23,7 @@
 #pragma once
 
 #include <gio/gio.h>
+#include <memory>
 #include <string>
 
 namespace ggk {
@@ -36,8 +37,15 @@ struct GattProperty
 	//
 	// In general, properties should not be constructed directly as properties are typically instanticated by adding them to to an
 	// interface using one of the the interface's `addProperty` methods.
+	//
+	// A floating `pValue` is sunk; otherwise the property takes its own reference to it.
 	GattProperty(const std::string &name, GVariant *pValue, GDBusInterfaceGetPropertyFunc getter = nullptr, GDBusInterfaceSetPropertyFunc setter = nullptr);
 
+	// Copies share a reference to the same value
+	GattProperty(const GattProperty &other);
+	GattProperty &operator =(const GattProperty &other);
+	~GattProperty();
+
 	//
 	// Name
 	//
@@ -58,10 +66,13 @@ struct GattProperty
 	// Returns the property's value
 	const GVariant *getValue() const;
 
-	// Sets the property's value
+	// Sets the property's value and releases the previous one
+	//
+	// A floating `pValue` is sunk; otherwise the property takes its own reference to it.
 	//
 	// In general, this method should not be called directly as properties are typically added to an interface using one of the the
-	// interface's `addProperty` methods.
+	// interface's `addProperty` methods. To change a property's value while the server is running, use
+	// `GattInterface::updatePropertyVariant()`, which also tells D-Bus about the change.
 	GattProperty &setValue(GVariant *pValue);
 
 	//
@@ -91,7 +102,7 @@ struct GattProperty
 
 private:
 
-	std::string name;
+	std::shared_ptr<const std::string> name;
 	GVariant *pValue;
 	GDBusInterfaceGetPropertyFunc getterFunc;
 	GDBusInterfaceSetPropertyFunc setterFunc;
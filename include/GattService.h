@@ -86,6 +86,24 @@ struct GattService : GattInterface
 	//
 	GattCharacteristic &gattCharacteristicBegin(const std::string &pathElement, const GattUuid &uuid, const std::vector<const char *> &flags);
 
+	// Convenience function to add a batch read characteristic to the hierarchy
+	//
+	// A client writes a list of characteristic UUIDs to this characteristic, then reads back the current values of all of them in
+	// a single frame. The values come from each characteristic's own `onReadValue` method. See the discussion at the top of
+	// BatchRead.cpp for the request and frame formats.
+	//
+	// To end the characteristic, call `gattCharacteristicEnd()`
+	GattCharacteristic &gattBatchReadCharacteristicBegin(const std::string &pathElement, const GattUuid &uuid);
+
+	// Convenience function to add an aggregation channel characteristic to the hierarchy
+	//
+	// Characteristics in this service that call `aggregate()` have their queued updates packed together into this
+	// characteristic's notifications rather than sending their own. `maxFrameSize` is the largest notification the channel sends
+	// and should be the clients' ATT MTU minus 3. See the discussion at the top of AggregationChannel.cpp for the frame format.
+	//
+	// To end the characteristic, call `gattCharacteristicEnd()`
+	GattCharacteristic &gattAggregationCharacteristicBegin(const std::string &pathElement, const GattUuid &uuid, size_t maxFrameSize = 20);
+
 	// Returns a string identifying the type of interface
 	virtual const std::string getInterfaceType() const { return GattService::kInterfaceType; }
 };
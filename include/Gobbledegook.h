@@ -111,6 +111,24 @@ typedef const void *(*GGKServerDataGetter)(const char *pName);
 //   * Any other failure, as deemed by the delegate handler
 typedef int (*GGKServerDataSetter)(const char *pName, const void *pData);
 
+// Type definition for an optional delegate that fetches several named values from the host application in one call
+//
+// `ppNames` holds `count` names, as they would be passed to `GGKServerDataGetter`. Fill `ppValues[i]` with the value for
+// `ppNames[i]` (or null if there isn't one) and return a non-zero value. Returning 0 makes the server fall back to calling the
+// `GGKServerDataGetter` for each name.
+//
+// The server uses this whenever it needs several values at once: for the data keys a characteristic declares with
+// `dataKeys()`, which are fetched together before each of its handlers runs, and for every characteristic in a batch read.
+//
+// IMPORTANT:
+//
+// The same rules apply as for `GGKServerDataGetter`. This may be called from the server's thread or its worker threads.
+typedef int (*GGKServerDataBatchGetter)(const char *const *ppNames, const void **ppValues, int count);
+
+// Registers a batch data getter. Registering `nullptr` removes it, so each value is fetched with its own `GGKServerDataGetter`
+// call. This may be called at any time.
+void ggkRegisterDataBatchGetter(GGKServerDataBatchGetter getter);
+
 // -----------------------------------------------------------------------------------------------------------------------------
 // SERVER DATA UPDATE MANAGEMENT
 // -----------------------------------------------------------------------------------------------------------------------------
@@ -155,6 +173,131 @@ int ggkUpdateQueueSize();
 // Removes all entries from the queue
 void ggkUpdateQueueClear();
 
+// -----------------------------------------------------------------------------------------------------------------------------
+// SNAPSHOT GROUPS
+// -----------------------------------------------------------------------------------------------------------------------------
+
+// A snapshot group is a named, fixed-size block of related values (typically a plain struct, such as the x/y/z axes of a sensor
+// along with a timestamp.) The application publishes the whole block at once and the server always reads a consistent copy, so a
+// notification can never mix members from two different updates.
+//
+// Publishing never blocks the server and reading never blocks the application. Multiple producer threads may publish to the same
+// group; they are serialized with each other.
+
+// Creates a snapshot group of `size` bytes. All bytes are initially zero.
+//
+// Creating a group that already exists with the same size succeeds and has no effect.
+//
+// Returns non-zero value on success or 0 on failure.
+int ggkSnapshotGroupCreate(const char *pGroupName, int size);
+
+// Publishes all members of a snapshot group at once. `size` must match the size the group was created with.
+//
+// Returns non-zero value on success or 0 on failure.
+int ggkSnapshotGroupPublish(const char *pGroupName, const void *pData, int size);
+
+// Copies a consistent snapshot of a group into `pData`. `size` must match the size the group was created with.
+//
+// If `pVersion` is not null, it receives the number of times the group has been published as of the copied snapshot (0 if it
+// has never been published.)
+//
+// Returns non-zero value on success or 0 on failure.
+int ggkSnapshotGroupRead(const char *pGroupName, void *pData, int size, unsigned long long *pVersion);
+
+// -----------------------------------------------------------------------------------------------------------------------------
+// CONNECTION EVENTS
+// -----------------------------------------------------------------------------------------------------------------------------
+
+// A device connecting to or disconnecting from the adapter
+//
+// `addressType` follows the Bluetooth Management API: 0 = BR/EDR, 1 = LE public, 2 = LE random.
+//
+// For disconnections, `reason` is the Bluetooth Management API's reason code: 0 = unspecified, 1 = connection timeout,
+// 2 = terminated locally, 3 = terminated by the remote device, 4 = authentication failure. It is 0 for connections.
+struct GGKConnectionEvent
+{
+    int connected;
+    char address[18];
+    int addressType;
+    int reason;
+};
+
+// Type definition for a callback that receives connection events
+//
+// Events are delivered in batches, oldest first, on the server's thread (never on the thread that reads from the adapter.) The
+// events are only valid for the duration of the call.
+typedef void (*GGKConnectionCallback)(const struct GGKConnectionEvent *pEvents, int eventCount, void *pUserData);
+
+// Registers a callback to receive connection events. Registering a new callback replaces the previous one and registering
+// `NULL` removes it. This may be called at any time.
+void ggkRegisterConnectionCallback(GGKConnectionCallback callback, void *pUserData);
+
+// A connected device and the most recent link quality the server polled for it (see `connectionInfoPollIntervalMS` in Server.cpp)
+//
+// `addressType` is as for `GGKConnectionEvent`. `rssi`, `txPower` and `maxTxPower` are in dBm, or 127 until the first poll for
+// the device completes (or if the adapter couldn't report them.)
+struct GGKConnectionInfo
+{
+    char address[18];
+    int addressType;
+    int rssi;
+    int txPower;
+    int maxTxPower;
+};
+
+// Copies the connected devices into `pInfo`, up to `maxCount` of them. This may be called from any thread.
+//
+// Returns the number of connected devices, which may be more than `maxCount`. Pass a `maxCount` of 0 to just count them.
+int ggkGetConnectionInfo(struct GGKConnectionInfo *pInfo, int maxCount);
+
+// -----------------------------------------------------------------------------------------------------------------------------
+// HANDLER PROFILING
+// -----------------------------------------------------------------------------------------------------------------------------
+
+// When enabled, the server measures the wall time and thread CPU time of every D-Bus method, tick event, `onUpdatedValue`
+// callback and property getter/setter it calls, aggregated per object path and method/property name. Use this to find the
+// handler responsible for a busy main loop.
+
+// Enables (non-zero) or disables (0) handler profiling
+//
+// Profiling is disabled by default. Disabling it keeps the samples collected so far.
+void ggkProfilingEnable(int enable);
+
+// Discards all profiling samples collected so far
+void ggkProfilingReset();
+
+// Logs (at the status level) the `topN` most expensive handlers, ranked by total wall time and by 99th percentile wall time.
+// Each entry also includes the handler's CPU time. If `topN` is not positive, the top 10 are reported.
+void ggkProfilingDump(int topN);
+
+// -----------------------------------------------------------------------------------------------------------------------------
+// VIRTUAL TIME
+// -----------------------------------------------------------------------------------------------------------------------------
+
+// For simulations and soak tests, the server can run on a virtual clock instead of real time. Virtual time stands still until
+// the application advances it, so days of tick events, retries and other timed behavior can be run through in seconds with the
+// same results every time. The timeouts passed to `ggkStart()` and `ggkRestart()` are always measured in real time, since the
+// calling thread can't advance the virtual clock while it waits.
+//
+// The clock can only be changed while the server is not running.
+
+// Switches the server to a virtual clock. The virtual wall clock starts at `startWallTime` (seconds since the epoch, as from
+// `time()`), or at the current time if `startWallTime` is 0.
+//
+// Returns non-zero value on success or 0 if the server is running.
+int ggkUseVirtualClock(long long startWallTime);
+
+// Switches the server back to real time
+//
+// Returns non-zero value on success or 0 if the server is running.
+int ggkUseSystemClock();
+
+// Moves the virtual clock forward by `milliseconds`. Timers that come due fire on the server's thread, once for each of their
+// periods that has elapsed.
+//
+// Returns non-zero value on success or 0 if the server is not using a virtual clock.
+int ggkAdvanceVirtualClock(unsigned long long milliseconds);
+
 // -----------------------------------------------------------------------------------------------------------------------------
 // SERVER CONTROL
 // -----------------------------------------------------------------------------------------------------------------------------
@@ -213,6 +356,21 @@ void ggkUpdateQueueClear();
 int ggkStart(const char *pServiceName, const char *pAdvertisingName, const char *pAdvertisingShortName,
     GGKServerConfigurator configurator, GGKServerDataGetter getter, GGKServerDataSetter setter, int maxAsyncInitTimeoutMS);
 
+// Performs a warm restart of a running server, rebuilding the server description with `configurator`
+//
+// Unlike stopping and starting the server, the D-Bus connection, the owned name and the adapter configuration are all kept. Only
+// the GATT object tree is rebuilt, swapped in and re-registered with BlueZ, which typically takes milliseconds rather than
+// seconds. Connected clients will see the services change.
+//
+// If `configurator` is null, the configurator from `ggkStart()` (or the previous restart) is used again. The service name,
+// advertising names and data getter/setter are unchanged.
+//
+// This method blocks for up to maxAsyncRestartTimeoutMS milliseconds until the restart completes. It must not be called from the
+// server's thread (such as from within a lambda in the server description.)
+//
+// Returns non-zero value on success or 0 on failure (including a timeout, in which case the restart may still complete later.)
+int ggkRestart(GGKServerConfigurator configurator, int maxAsyncRestartTimeoutMS);
+
 // Blocks for up to maxAsyncInitTimeoutMS milliseconds until the server shuts down.
 //
 // If shutdown is successful, this method will return a non-zero value. Otherwise, it will return 0.
@@ -297,3 +455,138 @@ enum GGKServerHealth ggkGetServerHealth();
 
 // Convert a `GGKServerHealth` into a human-readable string
 const char *ggkGetServerHealthString(enum GGKServerHealth state);
+
+// -----------------------------------------------------------------------------------------------------------------------------
+// SERVER LOAD
+// -----------------------------------------------------------------------------------------------------------------------------
+
+// The server watches its own load (the depth of the update queue and how late the main loop is in dispatching work.) When it
+// falls behind, it sheds load in steps, each including the ones before it:
+//
+//     EOverloadNormal          - no load shedding
+//     EOverloadStretchTicks    - tick events fire less often
+//     EOverloadCoalesce        - duplicate entries in the update queue are merged
+//     EOverloadDropLowPriority - notifications from characteristics marked low priority are dropped
+//     EOverloadRejectReads     - new ReadValue requests are rejected with a fast error
+//
+// The server escalates as soon as a threshold is crossed and steps back down one level at a time once the load has stayed low
+// for a while.
+enum GGKOverloadLevel
+{
+    EOverloadNormal,
+    EOverloadStretchTicks,
+    EOverloadCoalesce,
+    EOverloadDropLowPriority,
+    EOverloadRejectReads
+};
+
+// Load shedding statistics, as reported by `ggkGetOverloadStats()`
+struct GGKOverloadStats
+{
+    // The current level
+    enum GGKOverloadLevel level;
+
+    // Total number of level changes, and the number of times each level has been entered
+    unsigned long long transitions;
+    unsigned long long levelEntries[EOverloadRejectReads + 1];
+
+    // Work shed at each level
+    unsigned long long coalescedUpdates;
+    unsigned long long droppedNotifications;
+    unsigned long long rejectedReads;
+
+    // The most recent measurements, and the worst dispatch lag seen
+    int queueDepth;
+    int dispatchLagMS;
+    int maxDispatchLagMS;
+};
+
+// Retrieve the current load shedding level
+enum GGKOverloadLevel ggkGetOverloadLevel();
+
+// Convert a `GGKOverloadLevel` into a human-readable string
+const char *ggkGetOverloadLevelString(enum GGKOverloadLevel level);
+
+// Copies the current load shedding statistics into `pStats`
+void ggkGetOverloadStats(struct GGKOverloadStats *pStats);
+
+// -----------------------------------------------------------------------------------------------------------------------------
+// NOTIFICATION BATCHING
+// -----------------------------------------------------------------------------------------------------------------------------
+
+// The server sends the notifications for queued updates in batches. It measures how long each signal takes to emit, how much
+// each batch costs beyond that, and how quickly updates arrive, and from those tunes two things:
+//
+//     batch size   - the most updates sent in one batch
+//     flush delay  - how long updates are allowed to gather before a batch is sent
+//
+// Slow devices benefit from a longer flush delay, which spreads the cost of each batch over more notifications. Products that
+// need every update sent at once should leave the maximum flush delay at 0 (the default.)
+
+// Notification batching decisions and statistics, as reported by `ggkGetBatchingStats()`
+struct GGKBatchingStats
+{
+    // The bounds set with `ggkSetBatchingBounds()`
+    int minFlushDelayMS;
+    int maxFlushDelayMS;
+    int maxBatchSize;
+
+    // The current decisions
+    int batchSize;
+    int flushDelayUS;
+
+    // The smoothed measurements behind them
+    int emitCostUS;
+    int passOverheadUS;
+    int arrivalsPerSecond;
+
+    // Batches sent, times a batch was held back to let more updates gather, and the number of times the decisions changed
+    unsigned long long passes;
+    unsigned long long deferredPasses;
+    unsigned long long adjustments;
+};
+
+// Sets the bounds within which the flush delay and batch size are tuned
+//
+// The defaults are a flush delay of 0ms (send immediately) and a batch size of up to 64 updates. This may be called at any time.
+//
+// Returns non-zero value on success or 0 if the bounds are invalid (negative delays, a minimum above the maximum or a batch
+// size below 1.)
+int ggkSetBatchingBounds(int minFlushDelayMS, int maxFlushDelayMS, int maxBatchSize);
+
+// Copies the current notification batching decisions and statistics into `pStats`
+void ggkGetBatchingStats(struct GGKBatchingStats *pStats);
+
+// -----------------------------------------------------------------------------------------------------------------------------
+// PERIODIC TIMER
+// -----------------------------------------------------------------------------------------------------------------------------
+
+// Tick events (and so most periodic notifications) are driven by a timer whose deadlines sit on a fixed grid of monotonic time,
+// so they neither drift nor round to whole seconds. If the server falls more than a period behind, the deadlines it missed are
+// skipped and counted rather than served in a burst. The timer measures how late each of its calls runs, which shows how well a
+// device keeps to the grid.
+
+// Periodic timer measurements, as reported by `ggkGetTimerStats()`
+struct GGKTimerStats
+{
+    // The timer's period
+    unsigned long long intervalUS;
+
+    // Calls made, and deadlines skipped because the server fell more than a period behind
+    unsigned long long calls;
+    unsigned long long missedDeadlines;
+
+    // How long after its deadline each call ran: the smallest, largest and mean, and the standard deviation (jitter)
+    unsigned long long minLatenessUS;
+    unsigned long long maxLatenessUS;
+    unsigned long long meanLatenessUS;
+    unsigned long long jitterUS;
+
+    // The lateness of the most recent call minus that of the first (this stays near zero unless the timer drifts)
+    long long driftUS;
+};
+
+// Copies the periodic timer's measurements into `pStats`
+//
+// Returns a non-zero value on success or 0 if the timer isn't running (before the server has started or after it has stopped)
+int ggkGetTimerStats(struct GGKTimerStats *pStats);
@@ -0,0 +1,88 @@
+// Copyright 2017-2019 Paul Nettle
+//
+// This file is part of Gobbledegook.
+//
+// Use of this source code is governed by a BSD-style license that can be found
+// in the LICENSE file in the root of the source tree.
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//
+// >>
+// >>>  INSIDE THIS FILE
+// >>
+//
+// An opt-in profiler that measures the cost of each handler called from the server's main loop
+//
+// >>
+// >>>  DISCUSSION
+// >>
+//
+// See the discussion at the top of HandlerProfiler.cpp
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+#pragma once
+
+#include <stdint.h>
+#include <atomic>
+#include <string>
+
+namespace ggk {
+
+class HandlerProfiler
+{
+public:
+	// The kinds of handlers we profile
+	enum EHandlerKind
+	{
+		EMethod,
+		ETickEvent,
+		EUpdatedValue,
+		EPropertyGet,
+		EPropertySet,
+
+		EHandlerKindCount
+	};
+
+	// Maximum number of distinct handlers (kind, path and name) that can be tracked. Samples for handlers beyond this are dropped.
+	static const int kMaxHandlers = 128;
+
+	// Number of histogram buckets per measurement (see `bucketFor()` in HandlerProfiler.cpp)
+	static const int kHistogramBuckets = 64;
+
+	// Measures a single handler call from construction to destruction
+	//
+	// When profiling is disabled, this costs a single atomic load. The strings must outlive the scope.
+	class Scope
+	{
+	public:
+		Scope(EHandlerKind kind, const char *pPath, const char *pName);
+		~Scope();
+
+	private:
+		bool active;
+		EHandlerKind kind;
+		const char *pPath;
+		const char *pName;
+		uint64_t startWallNS;
+		uint64_t startCpuNS;
+	};
+
+	// Enables or disables profiling. Disabling profiling keeps the samples collected so far.
+	static void setEnabled(bool enable);
+
+	// Returns true if profiling is enabled
+	static bool isEnabled() { return enabled.load(std::memory_order_relaxed); }
+
+	// Discards all samples
+	static void reset();
+
+	// Returns a report of the `topN` most expensive handlers, ranked by total wall time and by 99th percentile wall time
+	static std::string report(int topN);
+
+private:
+	static void record(EHandlerKind kind, const char *pPath, const char *pName, uint64_t wallNS, uint64_t cpuNS);
+
+	static std::atomic<bool> enabled;
+};
+
+}; // namespace ggk
@@ -83,12 +83,29 @@ struct Server
 	// Returns the requested setting the bondable state (true = enabled, false = disabled)
 	bool getEnableBondable() const { return enableBondable; }
 
+	// Returns the interval at which we poll the link quality (RSSI and TX power) of connected devices, in milliseconds
+	//
+	// A value of 0 disables polling. Characteristics with a link quality policy (see `GattCharacteristic::linkQualityPolicy()`)
+	// require polling to be enabled.
+	int getConnectionInfoPollIntervalMS() const { return connectionInfoPollIntervalMS; }
+
 	// Returns our registered data getter
 	GGKServerDataGetter getDataGetter() const { return dataGetter; }
 
 	// Returns our registered data setter
 	GGKServerDataSetter getDataSetter() const { return dataSetter; }
 
+	// Returns the application's batch data getter, or nullptr if it hasn't registered one (see `ggkRegisterDataBatchGetter()`)
+	//
+	// Unlike the other delegates, this one outlives any particular server, so it carries across restarts.
+	static GGKServerDataBatchGetter getDataBatchGetter();
+
+	// Registers the application's batch data getter
+	static void setDataBatchGetter(GGKServerDataBatchGetter getter);
+
+	// Returns the configurator that built our server description
+	GGKServerConfigurator getConfigurator() const { return configurator; }
+
 	// advertisingName: The name for this controller, as advertised over LE
 	//
 	// This is set from the constructor.
@@ -203,12 +220,18 @@ private:
 	// Bondable requested state
 	bool enableBondable;
 
+	// Link quality polling interval in milliseconds (0 = disabled)
+	int connectionInfoPollIntervalMS;
+
 	// The getter callback that is responsible for returning current server data that is shared over Bluetooth
 	GGKServerDataGetter dataGetter;
 
 	// The setter callback that is responsible for storing current server data that is shared over Bluetooth
 	GGKServerDataSetter dataSetter;
 
+	// The configurator callback that builds our server description (kept for warm restarts)
+	GGKServerConfigurator configurator;
+
 	// advertisingName: The name for this controller, as advertised over LE
 	//
 	// This is set from the constructor.
@@ -240,6 +263,10 @@ private:
 };
 
 // Our one and only server. It's a global.
+//
+// It is only replaced on the main loop thread (by a warm restart, see `ggkRestart()`) or while the server thread isn't running, and
+// always with `std::atomic_store()`. Code on the main loop thread may read it directly. Code that may run on any other thread (a
+// worker computing a value, or the application's own threads) must read it with `std::atomic_load()`.
 extern std::shared_ptr<Server> TheServer;
 
 }; // namespace ggk
@@ -0,0 +1,103 @@
+// Copyright 2017-2019 Paul Nettle
+//
+// This file is part of Gobbledegook.
+//
+// Use of this source code is governed by a BSD-style license that can be found
+// in the LICENSE file in the root of the source tree.
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//
+// >>
+// >>>  INSIDE THIS FILE
+// >>
+//
+// A named group of related values that are published and read as a single consistent snapshot
+//
+// >>
+// >>>  DISCUSSION
+// >>
+//
+// See the discussion at the top of SnapshotGroup.cpp
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+#pragma once
+
+#include <stdint.h>
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace ggk {
+
+class SnapshotGroup
+{
+public:
+	// Maximum number of groups that can be created over the lifetime of the process
+	static const int kMaxGroups = 32;
+
+	// Number of optimistic read attempts before a read gives up (see `read()`)
+	static const int kMaxReadAttempts = 8;
+
+	// Creates a new group of `size` bytes with the given name, initialized to all zeros
+	//
+	// If a group with this name already exists and has the same size, the existing group is returned. Otherwise, returns
+	// nullptr on failure.
+	static SnapshotGroup *create(const std::string &name, size_t size);
+
+	// Returns the group with the given name, or nullptr if no such group exists
+	//
+	// This does not take any locks and is safe to call from any thread.
+	static SnapshotGroup *find(const std::string &name);
+
+	// Returns the name of this group
+	const std::string &getName() const { return name; }
+
+	// Returns the size of this group, in bytes
+	size_t getSize() const { return size; }
+
+	// Returns the version of the most recently published snapshot (0 if nothing has been published yet)
+	uint64_t getVersion() const { return version.load(std::memory_order_acquire); }
+
+	// Returns the number of reads that gave up because producers kept publishing during the copy
+	uint64_t getReadFailures() const { return readFailures.load(std::memory_order_relaxed); }
+
+	// Publishes a complete snapshot of the group
+	//
+	// `dataSize` must match the size of the group. Producers are serialized with each other, but never with readers.
+	//
+	// Returns true on success, false if the size does not match
+	bool publish(const void *pData, size_t dataSize);
+
+	// Copies the most recently published snapshot into `pData`
+	//
+	// `dataSize` must match the size of the group. If `pVersion` is not null, it receives the version of the snapshot that was
+	// copied.
+	//
+	// This method never blocks. Returns false if the size does not match or if a consistent copy could not be made within
+	// `kMaxReadAttempts` attempts, in which case `pData` is left in an undefined state.
+	bool read(void *pData, size_t dataSize, uint64_t *pVersion = nullptr) const;
+
+private:
+	// One half of our double buffer
+	//
+	// `sequence` is odd while the slot is being written
+	struct Slot
+	{
+		std::atomic<uint32_t> sequence;
+		uint64_t version;
+		std::vector<uint8_t> data;
+	};
+
+	SnapshotGroup(const std::string &name, size_t size);
+
+	std::string name;
+	size_t size;
+	Slot slots[2];
+	std::atomic<int> currentSlot;
+	std::atomic<uint64_t> version;
+	mutable std::atomic<uint64_t> readFailures;
+	std::mutex publishMutex;
+};
+
+}; // namespace ggk
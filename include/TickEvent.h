@@ -26,8 +26,9 @@
 //
 // The tick event's frequency is set when a tick event is added via the `onEvent()` method to the server description.
 //
-// The driving timer's frequency is a one-second-resolution low-frequency timer with a default of one second. To modify this, see
-// `kPeriodicTimerFrequencySeconds` at the top of Init.cpp. Note that the periodic timer (which drives tick events) is intentionally
+// The driving timer is a low-frequency timer with a default period of one second. To modify this, see
+// `kPeriodicTimerFrequencySeconds` at the top of Init.cpp. Its deadlines sit on a fixed grid (see `Clock::addPeriodicTimer()`), so
+// tick events don't drift however long the server runs. Note that the periodic timer (which drives tick events) is intentionally
 // a low-frequency timer. Higher frequency timers would lend themselves to using more battery on both, the server and client.
 //
 // When using a TickEvent, be careful not to demand too much of your client. Notifiations that are too frequent may place undue
@@ -40,6 +41,7 @@
 #include <string>
 
 #include "DBusObjectPath.h"
+#include "HandlerProfiler.h"
 #include "Logger.h"
 
 namespace ggk {
@@ -110,20 +112,27 @@ struct TickEvent
 	// the `callback` is only called after a period of time equal to the time between firings of the periodic timer, multiplied by
 	// `tickFrequency`.
 	//
+	// The owner may stretch the interval by passing a `frequencyMultiplier` greater than 1 (see `GattCharacteristic::LinkQualityPolicy`)
+	//
+	// If the periodic timer missed deadlines, `ticks` counts them as well. The event then fires once (not once per missed period)
+	// and keeps the remainder, so that it stays on the same grid of ticks rather than restarting its count from the late tick.
+	//
 	// Returns true if event fires, false otherwise
 	template<typename T>
-	void tick(const DBusObjectPath &path, GDBusConnection *pConnection, void *pUserData) const
+	void tick(const DBusObjectPath &path, GDBusConnection *pConnection, void *pUserData, int frequencyMultiplier = 1, int ticks = 1) const
 	{
-		elapsedTicks += 1;
-		if (elapsedTicks >= tickFrequency)
+		int period = tickFrequency * frequencyMultiplier;
+		elapsedTicks += ticks;
+		if (elapsedTicks >= period)
 		{
 			if (nullptr != callback)
 			{
 				Logger::debug(SSTR << "Ticking at path '" << path << "'");
+				HandlerProfiler::Scope profile(HandlerProfiler::ETickEvent, path.c_str(), nullptr);
 				callback(*static_cast<const T *>(pOwner), *this, pConnection, pUserData);
 			}
 
-			elapsedTicks = 0;
+			elapsedTicks = period > 0 ? elapsedTicks % period : 0;
 		}
 	}
 
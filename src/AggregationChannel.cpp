@@ -0,0 +1,335 @@
+// Copyright 2017-2019 Paul Nettle
+//
+// This file is part of Gobbledegook.
+//
+// Use of this source code is governed by a BSD-style license that can be found
+// in the LICENSE file in the root of the source tree.
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//
+// >>
+// >>>  INSIDE THIS FILE
+// >>
+//
+// A characteristic that packs the updates of many characteristics into shared notifications
+//
+// >>
+// >>>  DISCUSSION
+// >>
+//
+// Every change notification costs a `PropertiesChanged` signal, a trip through BlueZ and an ATT notification with its own header
+// and its own slot in a connection event. When a service has many small values that change together (eight 2-byte sensor
+// readings, say) most of that cost is overhead.
+//
+// An aggregation channel (see `GattService::gattAggregationCharacteristicBegin()`) is a notify-only characteristic that carries
+// the updates of the other characteristics in its service. Characteristics opt in with `GattCharacteristic::aggregate(recordId)`.
+// When an update for one of them comes through the update queue, its value is read (through its own `onReadValue` or
+// `onComputeValue` method) and queued as a record rather than being notified on its own. At the end of each drain of the update
+// queue (see idleFunc() in Init.cpp) the queued records are packed into frames and sent as notifications of the channel:
+//
+//     record id  (1 byte)   - the member's `recordId`
+//     length     (1 byte)   - the length of the value
+//     value      (length bytes)
+//
+// Records are packed into as few frames as possible, none larger than the channel's maximum frame size. That size should be the
+// clients' ATT MTU minus 3. Every subscriber receives every frame, so frames must also fit the smallest MTU among the clients. BlueZ
+// passes the client's MTU and device with each read, and the channel remembers them (for up to `kMaxClients` clients) until the
+// client disconnects, shrinking its frames to fit the smallest. If a member is updated more than once in a drain, only its latest
+// value is sent. A value too large for a record or a frame, or queued for a channel that has gone missing, is notified by its own
+// characteristic as usual.
+//
+// Reading the channel returns the most recent frame.
+//
+// Channels are forgotten when the server stops, and those that aren't part of the new server are forgotten after a warm restart.
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+#include <algorithm>
+#include <iterator>
+#include <map>
+#include <mutex>
+#include <vector>
+
+#include "AggregationChannel.h"
+#include "../include/DBusInterface.h"
+#include "../include/GattCharacteristic.h"
+#include "../include/GattService.h"
+#include "../include/Server.h"
+#include "../include/Utils.h"
+#include "../include/Logger.h"
+
+namespace ggk {
+
+// A queued update
+struct AggregationRecord
+{
+	std::shared_ptr<const GattCharacteristic> pMember;
+	uint8_t id;
+	std::vector<guint8> value;
+};
+
+// A channel and its queued updates
+struct AggregationChannelState
+{
+	std::string channelPath;
+	size_t maxFrameSize;
+	std::map<std::string, size_t> clientFrameSizes;
+	std::vector<AggregationRecord> records;
+	std::vector<guint8> lastFrame;
+};
+
+// Our channels, keyed by the path of the service they belong to
+static std::mutex channelsMutex;
+static std::map<std::string, AggregationChannelState> channels;
+
+// Returns the characteristic at `path`, or nullptr if there isn't one
+static std::shared_ptr<const GattCharacteristic> findCharacteristic(const std::string &path)
+{
+	std::shared_ptr<const DBusInterface> pInterface = TheServer->findInterface(DBusObjectPath(path), "org.bluez.GattCharacteristic1");
+	if (nullptr == pInterface)
+	{
+		return nullptr;
+	}
+
+	return TRY_GET_CONST_INTERFACE_OF_TYPE(pInterface, GattCharacteristic);
+}
+
+// Declares the aggregation channel for the service at `servicePath`
+void AggregationChannel::registerChannel(const DBusObjectPath &servicePath, const DBusObjectPath &channelPath, size_t maxFrameSize)
+{
+	std::lock_guard<std::mutex> lock(channelsMutex);
+
+	AggregationChannelState &channel = channels[servicePath.toString()];
+	channel.channelPath = channelPath.toString();
+	channel.maxFrameSize = maxFrameSize;
+	channel.clientFrameSizes.clear();
+	channel.records.clear();
+	channel.lastFrame.clear();
+}
+
+// Forgets every channel and anything queued on them (main loop only)
+void AggregationChannel::clear()
+{
+	std::lock_guard<std::mutex> lock(channelsMutex);
+	channels.clear();
+}
+
+// Forgets the channels that aren't part of the current server, and anything queued on the others (main loop only)
+void AggregationChannel::removeStale()
+{
+	std::lock_guard<std::mutex> lock(channelsMutex);
+
+	for (auto it = channels.begin(); it != channels.end();)
+	{
+		if (nullptr == findCharacteristic(it->second.channelPath))
+		{
+			Logger::debug(SSTR << "Forgetting aggregation channel '" << it->second.channelPath << "'");
+			it = channels.erase(it);
+			continue;
+		}
+
+		// Queued records may belong to the old server
+		it->second.records.clear();
+		++it;
+	}
+}
+
+// Forgets the MTU of the client at `address` (ex: "AA:BB:CC:DD:EE:FF") on every channel (main loop only)
+void AggregationChannel::forgetClient(const std::string &address)
+{
+	// BlueZ names a client's device after its address (ex: "/org/bluez/hci0/dev_AA_BB_CC_DD_EE_FF")
+	std::string deviceName = "dev_" + address;
+	std::replace(deviceName.begin(), deviceName.end(), ':', '_');
+
+	std::lock_guard<std::mutex> lock(channelsMutex);
+	for (auto &entry : channels)
+	{
+		std::map<std::string, size_t> &clients = entry.second.clientFrameSizes;
+		for (auto it = clients.begin(); it != clients.end();)
+		{
+			const std::string &device = it->first;
+			bool matches = device.size() >= deviceName.size() && 0 == device.compare(device.size() - deviceName.size(), deviceName.size(), deviceName);
+			it = matches ? clients.erase(it) : std::next(it);
+		}
+	}
+}
+
+// Returns the largest frame every client of `channel` can receive
+static size_t getFrameSize(const AggregationChannelState &channel)
+{
+	size_t frameSize = channel.maxFrameSize;
+	for (const auto &client : channel.clientFrameSizes)
+	{
+		if (client.second < frameSize)
+		{
+			frameSize = client.second;
+		}
+	}
+
+	return frameSize;
+}
+// Queues a record holding `pValue` (a byte array) for the next `flush()`, replacing any record still queued for `pMember`
+//
+// The caller keeps its reference to `pValue`. Returns false if the member's service has no channel or the value is too large for a
+// record, in which case the caller should send the update as it normally would.
+bool AggregationChannel::addRecord(const std::shared_ptr<const GattCharacteristic> &pMember, GVariant *pValue)
+{
+	gsize size = 0;
+	const guint8 *pBytes = static_cast<const guint8 *>(g_variant_get_fixed_array(pValue, &size, 1));
+	if (size > kMaxRecordValueSize)
+	{
+		return false;
+	}
+
+	std::lock_guard<std::mutex> lock(channelsMutex);
+
+	auto it = channels.find(pMember->getService().getPath().toString());
+	if (it == channels.end())
+	{
+		return false;
+	}
+
+	std::vector<AggregationRecord> &records = it->second.records;
+
+	AggregationRecord *pRecord = nullptr;
+	for (AggregationRecord &record : records)
+	{
+		if (record.pMember == pMember) { pRecord = &record; break; }
+	}
+
+	if (nullptr == pRecord)
+	{
+		records.push_back(AggregationRecord());
+		pRecord = &records.back();
+		pRecord->pMember = pMember;
+	}
+
+	pRecord->id = pMember->getAggregateId();
+	pRecord->value.assign(pBytes, pBytes + size);
+	return true;
+}
+
+// Sends all queued records, packed into as few notifications as possible (main loop only)
+void AggregationChannel::flush(GDBusConnection *pConnection)
+{
+	// Take everything that's queued, so we aren't holding the lock while we send
+	std::vector<std::pair<std::string, AggregationChannelState> > pending;
+
+	{
+		std::lock_guard<std::mutex> lock(channelsMutex);
+		for (auto &entry : channels)
+		{
+			if (!entry.second.records.empty())
+			{
+				pending.push_back(std::make_pair(entry.first, AggregationChannelState()));
+				AggregationChannelState &state = pending.back().second;
+				state.channelPath = entry.second.channelPath;
+				state.maxFrameSize = getFrameSize(entry.second);
+				state.records.swap(entry.second.records);
+			}
+		}
+	}
+
+	for (auto &entry : pending)
+	{
+		const AggregationChannelState &state = entry.second;
+
+		std::shared_ptr<const GattCharacteristic> pChannel = findCharacteristic(state.channelPath);
+		if (nullptr == pChannel)
+		{
+			Logger::warn(SSTR << "Aggregation channel '" << state.channelPath << "' not found; notifying " << state.records.size() << " record(s) individually");
+			for (const AggregationRecord &record : state.records)
+			{
+				record.pMember->sendChangeNotificationVariant(pConnection, Utils::gvariantFromByteArray(record.value));
+			}
+			continue;
+		}
+
+		size_t frameSize = state.maxFrameSize;
+
+		// Don't build frames that the channel's link quality policy would truncate
+		size_t payloadLimit = pChannel->getNotifyPayloadLimit();
+		if (payloadLimit > 0 && payloadLimit < frameSize)
+		{
+			frameSize = payloadLimit;
+		}
+
+		std::vector<guint8> frame;
+		int frameCount = 0;
+		for (const AggregationRecord &record : state.records)
+		{
+			size_t recordSize = kRecordHeaderSize + record.value.size();
+
+			// A record that can never fit in a frame goes out on its own characteristic
+			if (recordSize > frameSize)
+			{
+				record.pMember->sendChangeNotificationVariant(pConnection, Utils::gvariantFromByteArray(record.value));
+				continue;
+			}
+
+			if (frame.size() + recordSize > frameSize)
+			{
+				pChannel->sendChangeNotificationVariant(pConnection, Utils::gvariantFromByteArray(frame));
+				frameCount += 1;
+				frame.clear();
+			}
+
+			frame.push_back(record.id);
+			frame.push_back(static_cast<guint8>(record.value.size()));
+			frame.insert(frame.end(), record.value.begin(), record.value.end());
+
+			// The record stands in for the member's own change notification
+			record.pMember->markValueChanged();
+		}
+
+		if (!frame.empty())
+		{
+			pChannel->sendChangeNotificationVariant(pConnection, Utils::gvariantFromByteArray(frame));
+			frameCount += 1;
+
+			std::lock_guard<std::mutex> lock(channelsMutex);
+			channels[entry.first].lastFrame = frame;
+		}
+
+		Logger::debug(SSTR << "Aggregated " << state.records.size() << " update(s) into " << frameCount << " notification(s) on '" << state.channelPath << "'");
+	}
+}
+
+// Our `ReadValue` handler: returns the most recent frame and notes the client's MTU
+void AggregationChannel::onReadValue(const GattCharacteristic &self, GDBusConnection * /*pConnection*/, const std::string & /*methodName*/, GVariant *pParameters, GDBusMethodInvocation *pInvocation, void * /*pUserData*/)
+{
+	guint16 mtu = 0;
+	std::string device;
+	if (nullptr != pParameters && g_variant_n_children(pParameters) > 0)
+	{
+		GVariant *pOptions = g_variant_get_child_value(pParameters, 0);
+		const gchar *pDevice = nullptr;
+		g_variant_lookup(pOptions, "mtu", "q", &mtu);
+		if (g_variant_lookup(pOptions, "device", "&o", &pDevice))
+		{
+			device = pDevice;
+		}
+		g_variant_unref(pOptions);
+	}
+
+	std::vector<guint8> frame;
+
+	{
+		std::lock_guard<std::mutex> lock(channelsMutex);
+		auto it = channels.find(self.getService().getPath().toString());
+		if (it != channels.end())
+		{
+			// A notification carries at most MTU - 3 bytes
+			std::map<std::string, size_t> &clients = it->second.clientFrameSizes;
+			if (mtu > 3 && (clients.find(device) != clients.end() || clients.size() < kMaxClients))
+			{
+				clients[device] = mtu - 3;
+			}
+
+			frame = it->second.lastFrame;
+		}
+	}
+
+	self.methodReturnVariant(pInvocation, Utils::gvariantFromByteArray(frame), true);
+}
+
+}; // namespace ggk
@@ -0,0 +1,77 @@
+// Copyright 2017-2019 Paul Nettle
+//
+// This file is part of Gobbledegook.
+//
+// Use of this source code is governed by a BSD-style license that can be found
+// in the LICENSE file in the root of the source tree.
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//
+// >>
+// >>>  INSIDE THIS FILE
+// >>
+//
+// A characteristic that packs the updates of many characteristics into shared notifications
+//
+// >>
+// >>>  DISCUSSION
+// >>
+//
+// See the discussion at the top of AggregationChannel.cpp
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+#pragma once
+
+#include <gio/gio.h>
+#include <stddef.h>
+#include <memory>
+#include <string>
+
+#include "../include/DBusObjectPath.h"
+
+namespace ggk {
+
+struct GattCharacteristic;
+
+class AggregationChannel
+{
+public:
+	// The size of each record's header (id and length)
+	static const size_t kRecordHeaderSize = 2;
+
+	// The largest value a record can hold
+	static const size_t kMaxRecordValueSize = 255;
+
+	// The number of clients whose MTU each channel remembers at once
+	static const size_t kMaxClients = 16;
+
+	// Declares the aggregation channel for the service at `servicePath`
+	//
+	// `maxFrameSize` is the largest notification payload the channel sends (the clients' ATT MTU minus 3.)
+	static void registerChannel(const DBusObjectPath &servicePath, const DBusObjectPath &channelPath, size_t maxFrameSize);
+
+	// Forgets every channel and anything queued on them (main loop only)
+	static void clear();
+
+	// Forgets the channels that aren't part of the current server, and anything queued on the others (main loop only)
+	//
+	// Call this after a warm restart swaps in a new server.
+	static void removeStale();
+
+	// Forgets the MTU of the client at `address` (ex: "AA:BB:CC:DD:EE:FF") on every channel (main loop only)
+	static void forgetClient(const std::string &address);
+
+	// Queues a record holding `pValue` (a byte array) for the next `flush()`, replacing any record still queued for `pMember`
+	//
+	// The caller keeps its reference to `pValue`. Returns false if the member's service has no channel or the value is too large
+	// for a record, in which case the caller should send the update as it normally would.
+	static bool addRecord(const std::shared_ptr<const GattCharacteristic> &pMember, GVariant *pValue);
+
+	// Sends all queued records, packed into as few notifications as possible (main loop only)
+	static void flush(GDBusConnection *pConnection);
+
+	// Our `ReadValue` handler: returns the most recent frame and notes the client's MTU
+	static void onReadValue(const GattCharacteristic &self, GDBusConnection *pConnection, const std::string &methodName, GVariant *pParameters, GDBusMethodInvocation *pInvocation, void *pUserData);
+};
+
+}; // namespace ggk
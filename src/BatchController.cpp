@@ -0,0 +1,317 @@
+// Copyright 2017-2019 Paul Nettle
+//
+// This file is part of Gobbledegook.
+//
+// Use of this source code is governed by a BSD-style license that can be found
+// in the LICENSE file in the root of the source tree.
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//
+// >>
+// >>>  INSIDE THIS FILE
+// >>
+//
+// Tunes how many updates each idle pass drains, and how long it waits for them, from measured costs
+//
+// >>
+// >>>  DISCUSSION
+// >>
+//
+// Each idle pass (see idleFunc() in Init.cpp) drains a batch of entries from the update queue and sends their notifications. No
+// fixed batch suits every device. On a small board each pass carries a fixed cost (waking up, looking up interfaces, flushing
+// the connection) that is worth spreading over many notifications, so it pays to wait a little for updates to gather. A
+// low-latency product wants every update sent the moment it arrives.
+//
+// So rather than fix the batch, we measure three things and tune it:
+//
+//     * Emit cost        - how long a single signal takes to emit (timed in DBusObject::emitSignal, which every notification and
+//                          property change goes through)
+//     * Pass overhead    - how long each idle pass takes beyond the time spent emitting
+//     * Arrival rate     - how quickly entries are added to the update queue
+//
+// Every `OverloadController::kSampleIntervalMS` the measurements are smoothed and two decisions are made:
+//
+//     * Flush delay      - how long an idle pass lets updates gather before draining them. We want the time spent emitting in a
+//                          pass to be at least `kAmortization` times the pass overhead, so the delay is however long it takes
+//                          for that many updates to arrive. It is always kept within the configured bounds.
+//
+//     * Batch size       - the most entries one pass drains. It is large enough to hold everything that gathers during the flush
+//                          delay, and otherwise as many as can be emitted within `kPassBudgetUS`, so that a pass never holds the
+//                          main loop for long. It never exceeds the configured maximum.
+//
+// A pass drains early if a full batch is already waiting. The bounds are set with `ggkSetBatchingBounds()`. The defaults (no
+// delay, at most 64 entries per pass) keep the server's original behavior: with no delay allowed, nothing is tuned and every pass
+// drains up to the maximum. The measurements are still taken. The current decisions and measurements are reported by
+// `ggkGetBatchingStats()`.
+//
+// All times here are real time, even under a virtual clock, since they measure the real cost of the real main loop.
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+
+#include "BatchController.h"
+#include "../include/Logger.h"
+
+namespace ggk {
+
+// The emit time we aim for in each pass, as a multiple of the pass overhead
+static const double kAmortization = 4.0;
+
+// Room in each batch for this many times what we expect to gather during the flush delay, so that a burst above the average arrival
+// rate still goes out in one pass rather than leaving a remainder behind for the next
+static const double kGatherHeadroom = 2.0;
+
+// The weight of each new measurement in the smoothed values
+static const double kSmoothing = 0.125;
+
+// The bounds
+static std::atomic<int> minFlushDelayMS(BatchController::kDefaultMinFlushDelayMS);
+static std::atomic<int> maxFlushDelayMS(BatchController::kDefaultMaxFlushDelayMS);
+static std::atomic<int> maxBatchSize(BatchController::kDefaultMaxBatchSize);
+
+// The current decisions
+static std::atomic<int> batchSize(BatchController::kDefaultMaxBatchSize);
+static std::atomic<int> flushDelayUS(BatchController::kDefaultMinFlushDelayMS * 1000);
+
+// When the oldest undrained entry arrived (0 if there isn't one)
+static std::atomic<uint64_t> firstPendingUS(0);
+
+// Measurements since the last sample
+static std::atomic<uint64_t> arrivals(0);
+static std::atomic<uint64_t> emits(0);
+static std::atomic<uint64_t> emitTotalUS(0);
+static uint64_t passes = 0;
+static uint64_t passTotalUS = 0;
+static uint64_t passEntries = 0;
+
+// Smoothed measurements (main loop only)
+static std::chrono::steady_clock::time_point lastSampleTime;
+static bool bHaveLastSample = false;
+static double emitCostUS = 0.0;
+static double passOverheadUS = 0.0;
+static double arrivalsPerSecond = 0.0;
+
+// Statistics
+static std::mutex statsMutex;
+static GGKBatchingStats stats = {};
+static std::atomic<unsigned long long> deferredPasses(0);
+
+// Returns the real monotonic time in microseconds, for timing the things we measure
+uint64_t BatchController::nowUS()
+{
+	return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+// Folds a new measurement into a smoothed value (the first measurement is taken as is)
+static void smooth(double &average, double measurement)
+{
+	average = average <= 0.0 ? measurement : average + (measurement - average) * kSmoothing;
+}
+
+// Returns `value` clamped to [low, high]
+static double clamp(double value, double low, double high)
+{
+	return value < low ? low : (value > high ? high : value);
+}
+
+// Sets the bounds within which the batch size and flush delay are tuned
+//
+// Returns false (and changes nothing) if the bounds are invalid
+bool BatchController::setBounds(int minDelayMS, int maxDelayMS, int maxSize)
+{
+	if (minDelayMS < 0 || maxDelayMS < minDelayMS || maxSize < 1)
+	{
+		Logger::error(SSTR << "Invalid batching bounds (flush delay " << minDelayMS << "-" << maxDelayMS << "ms, batch size " << maxSize << ")");
+		return false;
+	}
+
+	minFlushDelayMS = minDelayMS;
+	maxFlushDelayMS = maxDelayMS;
+	maxBatchSize = maxSize;
+
+	// Bring the current decisions inside the new bounds right away, rather than waiting for the next sample
+	flushDelayUS = static_cast<int>(clamp(flushDelayUS.load(), minDelayMS * 1000.0, maxDelayMS * 1000.0));
+	batchSize = static_cast<int>(clamp(batchSize.load(), 1.0, maxSize));
+
+	Logger::info(SSTR << "Batching bounds set (flush delay " << minDelayMS << "-" << maxDelayMS << "ms, batch size up to " << maxSize << ")");
+	return true;
+}
+
+// Records an entry added to the update queue (any thread)
+void BatchController::countArrival()
+{
+	arrivals.fetch_add(1, std::memory_order_relaxed);
+
+	uint64_t none = 0;
+	firstPendingUS.compare_exchange_strong(none, nowUS());
+}
+
+// Records the time taken to emit one signal (main loop only)
+void BatchController::recordEmit(uint64_t durationUS)
+{
+	emits.fetch_add(1, std::memory_order_relaxed);
+	emitTotalUS.fetch_add(durationUS, std::memory_order_relaxed);
+}
+
+// Records the time taken by one idle pass that sent `entries` updates (main loop only)
+void BatchController::recordFlush(uint64_t durationUS, size_t entries)
+{
+	passes += 1;
+	passTotalUS += durationUS;
+	passEntries += entries;
+
+	std::lock_guard<std::mutex> guard(statsMutex);
+	stats.passes += 1;
+}
+
+// Retunes the batch size and flush delay from the measurements since the last sample (call from the main loop every
+// `OverloadController::kSampleIntervalMS`)
+void BatchController::sample()
+{
+	std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+	if (!bHaveLastSample)
+	{
+		lastSampleTime = now;
+		bHaveLastSample = true;
+		return;
+	}
+
+	double intervalUS = static_cast<double>(std::chrono::duration_cast<std::chrono::microseconds>(now - lastSampleTime).count());
+	lastSampleTime = now;
+	if (intervalUS <= 0.0)
+	{
+		return;
+	}
+
+	// Fold in the new measurements
+	smooth(arrivalsPerSecond, arrivals.exchange(0) * 1000000.0 / intervalUS);
+
+	uint64_t emitCount = emits.exchange(0);
+	uint64_t emitUS = emitTotalUS.exchange(0);
+	if (emitCount > 0)
+	{
+		smooth(emitCostUS, static_cast<double>(emitUS) / emitCount);
+	}
+
+	if (passes > 0)
+	{
+		double perPassUS = static_cast<double>(passTotalUS) / passes;
+		double emitPerPassUS = emitCostUS * passEntries / passes;
+		smooth(passOverheadUS, perPassUS > emitPerPassUS ? perPassUS - emitPerPassUS : 0.0);
+		passes = 0;
+		passTotalUS = 0;
+		passEntries = 0;
+	}
+
+	// Wait long enough for the emit time to outweigh the pass overhead
+	double minDelayUS = minFlushDelayMS * 1000.0;
+	double maxDelayUS = maxFlushDelayMS * 1000.0;
+	double delayUS = minDelayUS;
+	if (maxDelayUS > minDelayUS && emitCostUS > 0.0 && arrivalsPerSecond > 0.0)
+	{
+		delayUS = kAmortization * passOverheadUS / (emitCostUS * arrivalsPerSecond / 1000000.0);
+	}
+	delayUS = clamp(delayUS, minDelayUS, maxDelayUS);
+
+	// Hold everything that gathers during the delay, or as much as fits in our time budget. With no delay allowed (the default) we
+	// keep the maximum, as the server always has.
+	double maxSize = maxBatchSize.load();
+	double size = maxSize;
+	if (maxDelayUS > 0.0)
+	{
+		double gathered = kGatherHeadroom * arrivalsPerSecond * delayUS / 1000000.0;
+		double budgeted = emitCostUS > 0.0 ? kPassBudgetUS / emitCostUS : maxSize;
+		size = clamp(gathered > budgeted ? gathered : budgeted, 1.0, maxSize);
+	}
+
+	int newDelayUS = static_cast<int>(delayUS);
+	int newBatchSize = static_cast<int>(size);
+	int oldDelayUS = flushDelayUS.exchange(newDelayUS);
+	int oldBatchSize = batchSize.exchange(newBatchSize);
+
+	std::lock_guard<std::mutex> guard(statsMutex);
+	stats.emitCostUS = static_cast<int>(emitCostUS);
+	stats.passOverheadUS = static_cast<int>(passOverheadUS);
+	stats.arrivalsPerSecond = static_cast<int>(arrivalsPerSecond);
+	if (oldDelayUS != newDelayUS || oldBatchSize != newBatchSize)
+	{
+		stats.adjustments += 1;
+		Logger::debug(SSTR << "Batching retuned: batch size " << oldBatchSize << " -> " << newBatchSize << ", flush delay " << oldDelayUS << "us -> " << newDelayUS << "us");
+	}
+}
+
+// Clears the measurements and returns to the bounds' starting point (but not the statistics)
+void BatchController::reset()
+{
+	bHaveLastSample = false;
+	emitCostUS = 0.0;
+	passOverheadUS = 0.0;
+	arrivalsPerSecond = 0.0;
+	passes = 0;
+	passTotalUS = 0;
+	passEntries = 0;
+	arrivals = 0;
+	emits = 0;
+	emitTotalUS = 0;
+	firstPendingUS = 0;
+	flushDelayUS = minFlushDelayMS * 1000;
+	batchSize = maxBatchSize.load();
+}
+
+// Returns the most updates one idle pass should drain
+int BatchController::getBatchSize()
+{
+	return batchSize.load(std::memory_order_relaxed);
+}
+
+// Returns true if an idle pass should drain the update queue now, or false to let more updates gather (main loop only)
+//
+// Counts the passes that are deferred.
+bool BatchController::shouldDrain(size_t queueDepth)
+{
+	int delayUS = flushDelayUS.load(std::memory_order_relaxed);
+	if (0 == queueDepth || delayUS <= 0 || queueDepth >= static_cast<size_t>(getBatchSize()))
+	{
+		return true;
+	}
+
+	// If we missed the arrival time, don't hold the entries back
+	uint64_t firstUS = firstPendingUS.load();
+	if (0 == firstUS || nowUS() - firstUS >= static_cast<uint64_t>(delayUS))
+	{
+		return true;
+	}
+
+	deferredPasses.fetch_add(1, std::memory_order_relaxed);
+	return false;
+}
+
+// Records that an idle pass drained the queue, leaving `queueDepth` entries behind (main loop only)
+void BatchController::drained(size_t queueDepth)
+{
+	// Entries left behind are already overdue, so they keep their arrival time and go out on the next pass
+	if (0 == queueDepth)
+	{
+		firstPendingUS = 0;
+	}
+}
+
+// Copies the current decisions and statistics
+void BatchController::getStats(GGKBatchingStats &result)
+{
+	{
+		std::lock_guard<std::mutex> guard(statsMutex);
+		result = stats;
+	}
+
+	result.minFlushDelayMS = minFlushDelayMS.load();
+	result.maxFlushDelayMS = maxFlushDelayMS.load();
+	result.maxBatchSize = maxBatchSize.load();
+	result.batchSize = batchSize.load();
+	result.flushDelayUS = flushDelayUS.load();
+	result.deferredPasses = deferredPasses.load(std::memory_order_relaxed);
+}
+
+}; // namespace ggk
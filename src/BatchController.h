@@ -0,0 +1,82 @@
+// Copyright 2017-2019 Paul Nettle
+//
+// This file is part of Gobbledegook.
+//
+// Use of this source code is governed by a BSD-style license that can be found
+// in the LICENSE file in the root of the source tree.
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//
+// >>
+// >>>  INSIDE THIS FILE
+// >>
+//
+// Tunes how many updates each idle pass drains, and how long it waits for them, from measured costs
+//
+// >>
+// >>>  DISCUSSION
+// >>
+//
+// See the discussion at the top of BatchController.cpp
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "../include/Gobbledegook.h"
+
+namespace ggk {
+
+class BatchController
+{
+public:
+	// The default bounds (see `setBounds()`): no added delay and the batch size the server has always used
+	static const int kDefaultMinFlushDelayMS = 0;
+	static const int kDefaultMaxFlushDelayMS = 0;
+	static const int kDefaultMaxBatchSize = 64;
+
+	// The longest we'd like one idle pass to hold the main loop while it sends notifications
+	static const int kPassBudgetUS = 5000;
+
+	// Returns the real monotonic time in microseconds, for timing the things we measure
+	static uint64_t nowUS();
+
+	// Sets the bounds within which the batch size and flush delay are tuned
+	//
+	// Returns false (and changes nothing) if the bounds are invalid
+	static bool setBounds(int minFlushDelayMS, int maxFlushDelayMS, int maxBatchSize);
+
+	// Records an entry added to the update queue (any thread)
+	static void countArrival();
+
+	// Records the time taken to emit one signal (main loop only)
+	static void recordEmit(uint64_t durationUS);
+
+	// Records the time taken by one idle pass that sent `entries` updates (main loop only)
+	static void recordFlush(uint64_t durationUS, size_t entries);
+
+	// Retunes the batch size and flush delay from the measurements since the last sample (call from the main loop every
+	// `OverloadController::kSampleIntervalMS`)
+	static void sample();
+
+	// Clears the measurements and returns to the bounds' starting point (but not the statistics)
+	static void reset();
+
+	// Returns the most updates one idle pass should drain
+	static int getBatchSize();
+
+	// Returns true if an idle pass should drain the update queue now, or false to let more updates gather (main loop only)
+	//
+	// Counts the passes that are deferred.
+	static bool shouldDrain(size_t queueDepth);
+
+	// Records that an idle pass drained the queue, leaving `queueDepth` entries behind (main loop only)
+	static void drained(size_t queueDepth);
+
+	// Copies the current decisions and statistics
+	static void getStats(GGKBatchingStats &stats);
+};
+
+}; // namespace ggk
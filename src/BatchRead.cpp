@@ -0,0 +1,362 @@
+// Copyright 2017-2019 Paul Nettle
+//
+// This file is part of Gobbledegook.
+//
+// Use of this source code is governed by a BSD-style license that can be found
+// in the LICENSE file in the root of the source tree.
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//
+// >>
+// >>>  INSIDE THIS FILE
+// >>
+//
+// A characteristic that reads the values of many characteristics in a single exchange
+//
+// >>
+// >>>  DISCUSSION
+// >>
+//
+// A client that reads twenty characteristics on every connection pays for twenty ATT round trips, each of which becomes a separate
+// `ReadValue` call from BlueZ. A batch read characteristic (see `GattService::gattBatchReadCharacteristicBegin()`) replaces those
+// with one write and one (long) read.
+//
+// The client writes a request listing the characteristics it wants. Each entry is a length byte (2, 4 or 16) followed by a UUID
+// of that many bytes, in little-endian order as ATT sends UUIDs. A request may name up to `kMaxEntries` characteristics and may be
+// sent as a long write. (Clients name characteristics by UUID because ATT handles are assigned by BlueZ and are never seen here.)
+//
+// The client then reads the characteristic. A read at offset 0 builds a frame from the current values; it holds one entry for
+// each requested UUID, in request order:
+//
+//     status  (1 byte)   - see `BatchRead::EntryStatus`
+//     length  (2 bytes)  - little-endian length of the value (0 unless the status is EEntryOk)
+//     value   (length bytes)
+//
+// Values come from each characteristic's own `ReadValue` handler (see `GattCharacteristic::readValueLocally()`), so a batch read
+// returns exactly what individual reads would. Characteristics without a `ReadValue` handler are served from their
+// `onComputeValue` method, if they have one. The data keys of every characteristic in the request (see
+// `GattCharacteristic::dataKeys()`) are fetched from the application together before any of them is read.
+//
+// A frame never exceeds `kMaxFrameSize` bytes, the most ATT allows for an attribute value. Every entry's header always fits; a
+// value that doesn't gets the status EEntryNoRoom and should be requested again in another batch. Each read returns at most
+// MTU - 1 bytes of the frame, starting at the requested offset, so the client fetches the rest with ordinary long reads. The frame
+// is only rebuilt at offset 0, so every piece of a long read comes from the same consistent frame.
+//
+// Requests and frames are kept per client (using the "device" option that BlueZ passes with every call) for up to `kMaxClients`
+// clients at once.
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+#include <stdint.h>
+#include <stdio.h>
+#include <map>
+#include <vector>
+
+#include "BatchRead.h"
+#include "DataPrefetch.h"
+#include "../include/DBusBackend.h"
+#include "../include/DBusInterface.h"
+#include "../include/DBusObject.h"
+#include "../include/GattCharacteristic.h"
+#include "../include/GattProperty.h"
+#include "../include/GattUuid.h"
+#include "../include/Server.h"
+#include "../include/Utils.h"
+#include "../include/Logger.h"
+
+namespace ggk {
+
+// A client's most recent request and the frame built for it
+struct BatchReadClient
+{
+	std::vector<guint8> request;
+	std::vector<guint8> frame;
+	uint64_t lastUsed;
+};
+
+// Our clients, keyed by characteristic path and device path (main loop only)
+static std::map<std::string, BatchReadClient> clients;
+static uint64_t useCounter = 0;
+
+// The longest request we accept
+static const size_t kMaxRequestSize = BatchRead::kMaxEntries * 17;
+
+// The size of each entry's header in a frame
+static const size_t kEntryHeaderSize = 3;
+
+// ---------------------------------------------------------------------------------------------------------------------------------
+// Helpers
+// ---------------------------------------------------------------------------------------------------------------------------------
+
+// Returns the options dictionary (at `index` within the method parameters), or nullptr if there isn't one
+static GVariant *getOptions(GVariant *pParameters, gsize index)
+{
+	if (nullptr == pParameters || g_variant_n_children(pParameters) <= index)
+	{
+		return nullptr;
+	}
+
+	return g_variant_get_child_value(pParameters, index);
+}
+
+// Returns the key for the client making this call
+static std::string getClientKey(const GattCharacteristic &self, GVariant *pOptions)
+{
+	const char *pDevice = nullptr;
+	if (nullptr != pOptions)
+	{
+		g_variant_lookup(pOptions, "device", "&o", &pDevice);
+	}
+
+	return self.getPath().toString() + " " + (nullptr == pDevice ? "" : pDevice);
+}
+
+// Returns the state for a client, making room for it if necessary
+static BatchReadClient &getClient(const std::string &key)
+{
+	auto it = clients.find(key);
+	if (it == clients.end() && clients.size() >= BatchRead::kMaxClients)
+	{
+		// Forget the client we heard from least recently
+		auto oldest = clients.begin();
+		for (auto candidate = clients.begin(); candidate != clients.end(); ++candidate)
+		{
+			if (candidate->second.lastUsed < oldest->second.lastUsed) { oldest = candidate; }
+		}
+		clients.erase(oldest);
+	}
+
+	BatchReadClient &client = clients[key];
+	client.lastUsed = ++useCounter;
+	return client;
+}
+
+// Parses a request into a list of 128-bit UUID strings
+//
+// Returns false if the request is malformed
+static bool parseRequest(const std::vector<guint8> &request, std::vector<std::string> &uuids)
+{
+	size_t index = 0;
+	while (index < request.size())
+	{
+		size_t length = request[index++];
+		if ((length != 2 && length != 4 && length != 16) || index + length > request.size() || uuids.size() >= BatchRead::kMaxEntries)
+		{
+			return false;
+		}
+
+		// UUIDs arrive little-endian; GattUuid wants them written out most significant byte first
+		std::string hex;
+		for (size_t i = 0; i < length; ++i)
+		{
+			char digits[3];
+			snprintf(digits, sizeof(digits), "%02x", request[index + length - 1 - i]);
+			hex += digits;
+		}
+
+		uuids.push_back(GattUuid(hex).toString128());
+		index += length;
+	}
+
+	return !uuids.empty();
+}
+
+// Recursively collects every characteristic beneath `object`, keyed by UUID
+static void collectCharacteristics(const DBusObject &object, std::map<std::string, std::shared_ptr<const GattCharacteristic> > &characteristics)
+{
+	for (std::shared_ptr<const DBusInterface> pInterface : object.getInterfaces())
+	{
+		if (std::shared_ptr<const GattCharacteristic> pCharacteristic = TRY_GET_CONST_INTERFACE_OF_TYPE(pInterface, GattCharacteristic))
+		{
+			const GattProperty *pUuid = pCharacteristic->findProperty("UUID");
+			if (nullptr != pUuid)
+			{
+				const char *pUuidString = g_variant_get_string(const_cast<GVariant *>(pUuid->getValue()), nullptr);
+				characteristics[GattUuid(pUuidString).toString128()] = pCharacteristic;
+			}
+		}
+	}
+
+	for (const DBusObject &child : object.getChildren())
+	{
+		collectCharacteristics(child, characteristics);
+	}
+}
+
+// Builds a frame of the current values of the characteristics named in a request
+//
+// Returns false if the request is malformed
+static bool buildFrame(const GattCharacteristic &self, GDBusConnection *pConnection, const std::vector<guint8> &request, std::vector<guint8> &frame)
+{
+	std::vector<std::string> uuids;
+	if (!parseRequest(request, uuids))
+	{
+		return false;
+	}
+
+	std::map<std::string, std::shared_ptr<const GattCharacteristic> > characteristics;
+	for (const DBusObject &object : TheServer->getObjects())
+	{
+		collectCharacteristics(object, characteristics);
+	}
+
+	// Fetch the data behind every requested characteristic in one go
+	std::vector<std::string> keys;
+	for (const std::string &uuid : uuids)
+	{
+		auto it = characteristics.find(uuid);
+		if (it != characteristics.end())
+		{
+			const std::vector<std::string> &characteristicKeys = it->second->getDataKeys();
+			keys.insert(keys.end(), characteristicKeys.begin(), characteristicKeys.end());
+		}
+	}
+
+	DataPrefetch prefetch(keys);
+
+	// Every header always fits (see kMaxEntries); values share whatever room is left
+	size_t valueRoom = BatchRead::kMaxFrameSize - uuids.size() * kEntryHeaderSize;
+
+	frame.clear();
+	for (const std::string &uuid : uuids)
+	{
+		BatchRead::EntryStatus status = BatchRead::EEntryUnknown;
+		GVariant *pValue = nullptr;
+		gsize length = 0;
+		const guint8 *pBytes = nullptr;
+
+		auto it = characteristics.find(uuid);
+		if (it != characteristics.end())
+		{
+			// Don't let a batch read read itself
+			if (it->second.get() == &self)
+			{
+				status = BatchRead::EEntryNotReadable;
+			}
+			else
+			{
+				bool readable = false;
+				pValue = it->second->readValueLocally(pConnection, &readable);
+				status = nullptr != pValue ? BatchRead::EEntryOk : readable ? BatchRead::EEntryNoValue : BatchRead::EEntryNotReadable;
+			}
+		}
+
+		if (nullptr != pValue)
+		{
+			pBytes = static_cast<const guint8 *>(g_variant_get_fixed_array(pValue, &length, 1));
+			if (length > valueRoom)
+			{
+				status = BatchRead::EEntryNoRoom;
+				length = 0;
+			}
+		}
+
+		if (status != BatchRead::EEntryOk)
+		{
+			length = 0;
+		}
+
+		frame.push_back(static_cast<guint8>(status));
+		frame.push_back(static_cast<guint8>(length & 0xff));
+		frame.push_back(static_cast<guint8>((length >> 8) & 0xff));
+		if (length > 0)
+		{
+			frame.insert(frame.end(), pBytes, pBytes + length);
+			valueRoom -= length;
+		}
+
+		if (nullptr != pValue) { g_variant_unref(pValue); }
+	}
+
+	Logger::debug(SSTR << "Built a batch read frame of " << frame.size() << " bytes for " << uuids.size() << " characteristics");
+	return true;
+}
+
+// ---------------------------------------------------------------------------------------------------------------------------------
+// Handlers
+// ---------------------------------------------------------------------------------------------------------------------------------
+
+// Our `WriteValue` handler: stores the client's list of characteristic UUIDs
+void BatchRead::onWriteValue(const GattCharacteristic &self, GDBusConnection * /*pConnection*/, const std::string & /*methodName*/, GVariant *pParameters, GDBusMethodInvocation *pInvocation, void * /*pUserData*/)
+{
+	GVariant *pOptions = getOptions(pParameters, 1);
+	guint16 offset = 0;
+	if (nullptr != pOptions) { g_variant_lookup(pOptions, "offset", "q", &offset); }
+
+	BatchReadClient &client = getClient(getClientKey(self, pOptions));
+	if (nullptr != pOptions) { g_variant_unref(pOptions); }
+
+	GVariant *pValue = g_variant_get_child_value(pParameters, 0);
+	gsize size = 0;
+	const guint8 *pBytes = static_cast<const guint8 *>(g_variant_get_fixed_array(pValue, &size, 1));
+
+	// A long write arrives in pieces, each at the offset where the last one ended
+	if (0 == offset)
+	{
+		client.request.clear();
+	}
+	else if (offset != client.request.size())
+	{
+		g_variant_unref(pValue);
+		DBusBackend::getInstance().methodReturnError(pInvocation, "org.bluez.Error.InvalidOffset", "Unexpected offset");
+		return;
+	}
+
+	if (client.request.size() + size > kMaxRequestSize)
+	{
+		client.request.clear();
+		g_variant_unref(pValue);
+		DBusBackend::getInstance().methodReturnError(pInvocation, "org.bluez.Error.InvalidValueLength", "Too many entries");
+		return;
+	}
+
+	client.request.insert(client.request.end(), pBytes, pBytes + size);
+	client.frame.clear();
+	g_variant_unref(pValue);
+
+	self.methodReturnVariant(pInvocation, NULL);
+}
+
+// Our `ReadValue` handler: builds a frame of current values (at offset 0) and serves it in MTU-sized pieces
+void BatchRead::onReadValue(const GattCharacteristic &self, GDBusConnection *pConnection, const std::string & /*methodName*/, GVariant *pParameters, GDBusMethodInvocation *pInvocation, void * /*pUserData*/)
+{
+	GVariant *pOptions = getOptions(pParameters, 0);
+	guint16 offset = 0;
+	guint16 mtu = 0;
+	if (nullptr != pOptions)
+	{
+		g_variant_lookup(pOptions, "offset", "q", &offset);
+		g_variant_lookup(pOptions, "mtu", "q", &mtu);
+	}
+
+	BatchReadClient &client = getClient(getClientKey(self, pOptions));
+	if (nullptr != pOptions) { g_variant_unref(pOptions); }
+
+	if (client.request.empty())
+	{
+		DBusBackend::getInstance().methodReturnError(pInvocation, "org.bluez.Error.NotPermitted", "No batch read request has been written");
+		return;
+	}
+
+	if (0 == offset && !buildFrame(self, pConnection, client.request, client.frame))
+	{
+		DBusBackend::getInstance().methodReturnError(pInvocation, "org.bluez.Error.InvalidValueLength", "Malformed batch read request");
+		return;
+	}
+
+	if (offset > client.frame.size())
+	{
+		DBusBackend::getInstance().methodReturnError(pInvocation, "org.bluez.Error.InvalidOffset", "Offset is beyond the end of the frame");
+		return;
+	}
+
+	// An ATT read response carries at most MTU - 1 bytes
+	size_t count = client.frame.size() - offset;
+	if (mtu > 1 && count > static_cast<size_t>(mtu - 1))
+	{
+		count = mtu - 1;
+	}
+
+	self.methodReturnVariant(pInvocation, Utils::gvariantFromByteArray(client.frame.data() + offset, static_cast<int>(count)), true);
+}
+
+}; // namespace ggk
@@ -0,0 +1,62 @@
+// Copyright 2017-2019 Paul Nettle
+//
+// This file is part of Gobbledegook.
+//
+// Use of this source code is governed by a BSD-style license that can be found
+// in the LICENSE file in the root of the source tree.
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//
+// >>
+// >>>  INSIDE THIS FILE
+// >>
+//
+// A characteristic that reads the values of many characteristics in a single exchange
+//
+// >>
+// >>>  DISCUSSION
+// >>
+//
+// See the discussion at the top of BatchRead.cpp
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+#pragma once
+
+#include <gio/gio.h>
+#include <stddef.h>
+#include <string>
+
+namespace ggk {
+
+struct GattCharacteristic;
+
+class BatchRead
+{
+public:
+	// The largest frame we build (the largest attribute value ATT allows)
+	static const size_t kMaxFrameSize = 512;
+
+	// The most characteristics a single request may name
+	static const size_t kMaxEntries = 64;
+
+	// The number of clients whose requests we remember at once
+	static const size_t kMaxClients = 16;
+
+	// The status of each entry in a frame
+	enum EntryStatus
+	{
+		EEntryOk = 0x00,
+		EEntryUnknown = 0x01,
+		EEntryNotReadable = 0x02,
+		EEntryNoValue = 0x03,
+		EEntryNoRoom = 0x04
+	};
+
+	// Our `WriteValue` handler: stores the client's list of characteristic UUIDs
+	static void onWriteValue(const GattCharacteristic &self, GDBusConnection *pConnection, const std::string &methodName, GVariant *pParameters, GDBusMethodInvocation *pInvocation, void *pUserData);
+
+	// Our `ReadValue` handler: builds a frame of current values (at offset 0) and serves it in MTU-sized pieces
+	static void onReadValue(const GattCharacteristic &self, GDBusConnection *pConnection, const std::string &methodName, GVariant *pParameters, GDBusMethodInvocation *pInvocation, void *pUserData);
+};
+
+}; // namespace ggk
@@ -0,0 +1,494 @@
+// Copyright 2017-2019 Paul Nettle
+//
+// This file is part of Gobbledegook.
+//
+// Use of this source code is governed by a BSD-style license that can be found
+// in the LICENSE file in the root of the source tree.
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//
+// >>
+// >>>  INSIDE THIS FILE
+// >>
+//
+// The server's source of time: time queries, sleeps, waits and main loop timers
+//
+// >>
+// >>>  DISCUSSION
+// >>
+//
+// All of the server's timing logic (the periodic timer that drives tick events and retries, connection polling, the idle sleep
+// and the HCI socket's wait for data) asks `Clock::getInstance()` for the time rather than asking the system directly. Normally that is a `SystemClock`, which simply forwards to the system and to GLib.
+//
+// A `VirtualClock` lets simulations and soak tests run the server's timing logic faster than real time. Time stands still until
+// `advanceMS()` is called, so days of ticks and retries can be run in seconds and every run sees the same sequence of timer
+// firings. Its timers are a small custom GSource (`ClockSource`, which the periodic timers below use as well) that compares a
+// deadline against the virtual time; advancing the clock wakes the main loop so they are dispatched. A timer that falls several
+// periods behind fires once per missed period so that no ticks are lost.
+//
+// Virtual sleeps return once the virtual time has passed their deadline, but never block for longer than the same sleep would in
+// real time. Most of the server's sleeps are polling for work from another thread (the idle function, for example) so they must
+// not stall just because nobody is advancing the clock. Loops that time out do so in virtual time. For the same reason,
+// `waitReadable()` keeps its real-time behavior: data from the adapter arrives in real time.
+//
+// The waits in `ggkStart()` and `ggkRestart()` don't use the clock at all. They block the application's thread, which is the
+// thread that would advance a virtual clock, so they time out in real time.
+//
+// The clock can only be replaced (see `Clock::setInstance()`) while the server is stopped. Timers hold a reference to the clock
+// that added them, so a timer that outlives its server never finds its clock destroyed underneath it.
+//
+// PERIODIC TIMERS:
+//
+// GLib's timeouts are relative: each one is rescheduled from the time it was dispatched, so any lateness carries into every
+// period after it, and `g_timeout_add_seconds()` deliberately rounds its wake-ups to whole seconds as well. A periodic timer (see
+// `addPeriodicTimer()`) keeps to a fixed grid of absolute deadlines instead. `SystemClock` drives it with a `timerfd` armed with
+// TFD_TIMER_ABSTIME on CLOCK_MONOTONIC (the clock behind `g_get_monotonic_time()`), whose expiration count also tells us how many
+// deadlines went by while the main loop was busy. Other clocks poll `getMonotonicUS()` instead, and so does a timer whose timerfd
+// fails to read. Either way a timer that falls behind serves the most recent deadline once and reports the ones it skipped, so the
+// next call is back on the grid.
+//
+// Every periodic timer measures itself (see `PeriodicTimerStats`): how late each call was dispatched, how much that varies and
+// whether it is creeping, which makes the timer its own jitter and drift harness. The server reports the measurements of the
+// timer that drives tick events through `ggkGetTimerStats()`.
+//
+// A few measurements stay on real time on purpose, since they describe the real machine: the handler profiler
+// (HandlerProfiler.cpp) and the main loop's dispatch lag (OverloadController.cpp.) The sd-bus backend also uses real time for
+// sd-bus's own timeouts.
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+#include <sys/select.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+#include <math.h>
+#include <chrono>
+#include <map>
+#include <new>
+#include <thread>
+
+#include "../include/Gobbledegook.h"
+#include "../include/Clock.h"
+#include "../include/Logger.h"
+
+namespace ggk {
+
+// The server's clock
+//
+// This is only replaced while the server is stopped, but other threads (the application's, for example) may be reading it at the
+// time, so it is always accessed with std::atomic_load and std::atomic_store.
+static std::shared_ptr<Clock> pClockInstance = std::make_shared<SystemClock>();
+
+// ---------------------------------------------------------------------------------------------------------------------------------
+// Main loop timers
+// ---------------------------------------------------------------------------------------------------------------------------------
+
+// A main loop timer driven by a Clock rather than by GLib's own clock
+//
+// This serves both kinds of timer. A periodic timer (`periodicFunc`) keeps to a fixed grid of absolute deadlines and skips the ones
+// it missed (see PERIODIC TIMERS at the top of this file). A timeout (`timeoutFunc`) serves its missed deadlines one at a time, so
+// that it catches up without losing any calls.
+struct ClockSource
+{
+	GSource source;
+	std::shared_ptr<const Clock> pClock;  // Keeps the clock alive for as long as the timer is
+	GPollFD pollFd;                       // The timerfd, or -1 if we poll the clock
+	uint64_t intervalUS;
+	uint64_t deadlineUS;                  // The next deadline to serve
+	Clock::PeriodicFunc periodicFunc;
+	GSourceFunc timeoutFunc;
+	gpointer pUserData;
+	guint id;
+
+	// Measurements of a periodic timer (guarded by periodicSourcesMutex)
+	PeriodicTimerStats stats;
+	double latenessMeanUS;
+	double latenessSquaresUS;
+	int64_t firstLatenessUS;
+};
+
+// Our periodic timers, keyed by source ID, so their measurements can be found from any thread
+static std::mutex periodicSourcesMutex;
+static std::map<guint, ClockSource *> periodicSources;
+
+// Folds one call's lateness into a periodic timer's measurements
+static void recordPeriodicCall(ClockSource *pClockSource, uint64_t latenessUS, uint64_t missed)
+{
+	std::lock_guard<std::mutex> lock(periodicSourcesMutex);
+
+	PeriodicTimerStats &stats = pClockSource->stats;
+	stats.calls += 1;
+	stats.missedDeadlines += missed;
+
+	if (1 == stats.calls)
+	{
+		pClockSource->firstLatenessUS = static_cast<int64_t>(latenessUS);
+		stats.minLatenessUS = latenessUS;
+	}
+
+	if (latenessUS < stats.minLatenessUS) { stats.minLatenessUS = latenessUS; }
+	if (latenessUS > stats.maxLatenessUS) { stats.maxLatenessUS = latenessUS; }
+
+	// Welford's running mean and variance
+	double delta = static_cast<double>(latenessUS) - pClockSource->latenessMeanUS;
+	pClockSource->latenessMeanUS += delta / static_cast<double>(stats.calls);
+	pClockSource->latenessSquaresUS += delta * (static_cast<double>(latenessUS) - pClockSource->latenessMeanUS);
+
+	stats.meanLatenessUS = static_cast<uint64_t>(pClockSource->latenessMeanUS);
+	stats.jitterUS = static_cast<uint64_t>(sqrt(pClockSource->latenessSquaresUS / static_cast<double>(stats.calls)));
+	stats.driftUS = static_cast<int64_t>(latenessUS) - pClockSource->firstLatenessUS;
+}
+
+// Stops using a timer's timerfd; from then on the timer polls its clock
+static void stopUsingTimerFd(ClockSource *pClockSource)
+{
+	g_source_remove_poll(&pClockSource->source, &pClockSource->pollFd);
+	close(pClockSource->pollFd.fd);
+	pClockSource->pollFd.fd = -1;
+}
+
+static gboolean clockSourceCheck(GSource *pSource)
+{
+	ClockSource *pClockSource = reinterpret_cast<ClockSource *>(pSource);
+	if (pClockSource->pollFd.fd >= 0)
+	{
+		return 0 != (pClockSource->pollFd.revents & G_IO_IN);
+	}
+
+	return pClockSource->pClock->getMonotonicUS() >= pClockSource->deadlineUS;
+}
+
+static gboolean clockSourcePrepare(GSource *pSource, gint *pTimeout)
+{
+	ClockSource *pClockSource = reinterpret_cast<ClockSource *>(pSource);
+
+	// The timerfd wakes us itself
+	*pTimeout = -1;
+	if (pClockSource->pollFd.fd >= 0)
+	{
+		return FALSE;
+	}
+
+	// With a virtual clock this only bounds the wait, since advancing the clock wakes the main context anyway
+	uint64_t nowUS = pClockSource->pClock->getMonotonicUS();
+	if (nowUS >= pClockSource->deadlineUS)
+	{
+		*pTimeout = 0;
+		return TRUE;
+	}
+
+	*pTimeout = static_cast<gint>((pClockSource->deadlineUS - nowUS + 999) / 1000);
+	return FALSE;
+}
+
+static gboolean clockSourceDispatch(GSource *pSource, GSourceFunc /*callback*/, gpointer /*pUserData*/)
+{
+	ClockSource *pClockSource = reinterpret_cast<ClockSource *>(pSource);
+	uint64_t nowUS = pClockSource->pClock->getMonotonicUS();
+
+	// Count the deadlines that have passed since the last call
+	uint64_t periods = 0;
+	if (pClockSource->pollFd.fd >= 0)
+	{
+		if (read(pClockSource->pollFd.fd, &periods, sizeof(periods)) != sizeof(periods))
+		{
+			// EAGAIN is a spurious wake-up. Anything else would wake us again straight away, so give up on the timerfd and poll the
+			// clock instead (its deadlines are the same, so the timer stays on its grid).
+			if (errno == EAGAIN)
+			{
+				return TRUE;
+			}
+
+			Logger::warn(SSTR << "Failed to read a periodic timer (" << strerror(errno) << "); it will poll the clock instead");
+			stopUsingTimerFd(pClockSource);
+			periods = 0;
+		}
+	}
+
+	if (pClockSource->pollFd.fd < 0 && nowUS >= pClockSource->deadlineUS)
+	{
+		periods = (nowUS - pClockSource->deadlineUS) / pClockSource->intervalUS + 1;
+	}
+
+	if (0 == periods)
+	{
+		return TRUE;
+	}
+
+	// A timeout serves the oldest deadline; if it is still behind, we are ready again straight away
+	if (nullptr != pClockSource->timeoutFunc)
+	{
+		pClockSource->deadlineUS += pClockSource->intervalUS;
+		return pClockSource->timeoutFunc(pClockSource->pUserData);
+	}
+
+	// A periodic timer serves the most recent deadline and moves on to the one after it
+	uint64_t missed = periods - 1;
+	uint64_t servedUS = pClockSource->deadlineUS + missed * pClockSource->intervalUS;
+	pClockSource->deadlineUS = servedUS + pClockSource->intervalUS;
+
+	recordPeriodicCall(pClockSource, nowUS > servedUS ? nowUS - servedUS : 0, missed);
+	return pClockSource->periodicFunc(servedUS, missed, pClockSource->pUserData);
+}
+
+static void clockSourceFinalize(GSource *pSource)
+{
+	ClockSource *pClockSource = reinterpret_cast<ClockSource *>(pSource);
+
+	{
+		std::lock_guard<std::mutex> lock(periodicSourcesMutex);
+		periodicSources.erase(pClockSource->id);
+	}
+
+	if (pClockSource->pollFd.fd >= 0)
+	{
+		close(pClockSource->pollFd.fd);
+	}
+
+	pClockSource->pClock.~shared_ptr();
+}
+
+static GSourceFuncs clockSourceFuncs =
+{
+	clockSourcePrepare,
+	clockSourceCheck,
+	clockSourceDispatch,
+	clockSourceFinalize,
+	nullptr,
+	nullptr
+};
+
+// Attaches a timer to the default main context whose first deadline is `firstDeadlineUS`
+//
+// Pass either `periodicFunc` (for a periodic timer) or `timeoutFunc` (for a timeout). `fd` is an armed timerfd (which the source
+// takes ownership of), or -1 to poll `clock`.
+static guint addClockSource(const Clock &clock, int fd, uint64_t firstDeadlineUS, uint64_t intervalUS, Clock::PeriodicFunc periodicFunc, GSourceFunc timeoutFunc, gpointer pUserData)
+{
+	if (0 == intervalUS || (nullptr == periodicFunc) == (nullptr == timeoutFunc))
+	{
+		if (fd >= 0) { close(fd); }
+		return 0;
+	}
+
+	GSource *pSource = g_source_new(&clockSourceFuncs, sizeof(ClockSource));
+	ClockSource *pClockSource = reinterpret_cast<ClockSource *>(pSource);
+	new (&pClockSource->pClock) std::shared_ptr<const Clock>(clock.shared_from_this()); // g_source_new() doesn't construct it
+	pClockSource->pollFd.fd = fd;
+	pClockSource->pollFd.events = G_IO_IN;
+	pClockSource->pollFd.revents = 0;
+	pClockSource->intervalUS = intervalUS;
+	pClockSource->deadlineUS = firstDeadlineUS;
+	pClockSource->periodicFunc = periodicFunc;
+	pClockSource->timeoutFunc = timeoutFunc;
+	pClockSource->pUserData = pUserData;
+	pClockSource->stats = PeriodicTimerStats();
+	pClockSource->stats.intervalUS = intervalUS;
+	pClockSource->latenessMeanUS = 0;
+	pClockSource->latenessSquaresUS = 0;
+	pClockSource->firstLatenessUS = 0;
+
+	if (fd >= 0)
+	{
+		g_source_add_poll(pSource, &pClockSource->pollFd);
+	}
+
+	// Hold the lock while attaching, so nobody can dispatch or finalize the source before its entry is in place
+	std::lock_guard<std::mutex> lock(periodicSourcesMutex);
+	pClockSource->id = g_source_attach(pSource, nullptr);
+	if (nullptr != periodicFunc)
+	{
+		periodicSources[pClockSource->id] = pClockSource;
+	}
+	g_source_unref(pSource);
+	return pClockSource->id;
+}
+
+// ---------------------------------------------------------------------------------------------------------------------------------
+// Clock
+// ---------------------------------------------------------------------------------------------------------------------------------
+
+// Waits up to `timeoutMS` for `fd` to become readable
+//
+// Returns a positive value if the descriptor is readable, 0 on timeout or a negative value on error (as `select()` does)
+int Clock::waitReadable(int fd, int timeoutMS)
+{
+	fd_set rfds;
+	FD_ZERO(&rfds);
+	FD_SET(fd, &rfds);
+
+	struct timeval tv;
+	tv.tv_sec = timeoutMS / 1000;
+	tv.tv_usec = (timeoutMS % 1000) * 1000;
+
+	return select(fd + 1, &rfds, NULL, NULL, &tv);
+}
+
+// Adds a timer to the default main context that calls `func` on a fixed grid of deadlines, `intervalUS` apart, starting
+// `intervalUS` from now
+//
+// This version polls `getMonotonicUS()` from the main loop. Returns the source ID (for `g_source_remove()`), or 0 on failure.
+guint Clock::addPeriodicTimer(uint64_t intervalUS, PeriodicFunc func, gpointer pUserData)
+{
+	return addClockSource(*this, -1, getMonotonicUS() + intervalUS, intervalUS, func, nullptr, pUserData);
+}
+
+// Copies the timing measurements of the periodic timer with source ID `sourceId` into `stats`
+//
+// Returns false if there is no such periodic timer. This is safe to call from any thread.
+bool Clock::getPeriodicTimerStats(guint sourceId, PeriodicTimerStats &stats)
+{
+	std::lock_guard<std::mutex> lock(periodicSourcesMutex);
+
+	auto it = periodicSources.find(sourceId);
+	if (it == periodicSources.end())
+	{
+		return false;
+	}
+
+	stats = it->second->stats;
+	return true;
+}
+
+// Returns the clock used by the server
+Clock &Clock::getInstance()
+{
+	return *std::atomic_load(&pClockInstance);
+}
+
+// Replaces the clock used by the server. Passing nullptr restores the system clock.
+//
+// The clock can only be replaced while the server is stopped (or not yet started), since the server's threads hold on to the
+// clock they are using. Returns false (and leaves the clock as it is) if the server is running.
+bool Clock::setInstance(std::shared_ptr<Clock> pClock)
+{
+	if (ggkGetServerRunState() != EUninitialized && ggkGetServerRunState() != EStopped)
+	{
+		Logger::error("The clock cannot be changed while the server is running");
+		return false;
+	}
+
+	std::atomic_store(&pClockInstance, nullptr != pClock ? pClock : std::shared_ptr<Clock>(std::make_shared<SystemClock>()));
+	return true;
+}
+
+// ---------------------------------------------------------------------------------------------------------------------------------
+// SystemClock
+// ---------------------------------------------------------------------------------------------------------------------------------
+
+uint64_t SystemClock::getMonotonicUS() const
+{
+	return static_cast<uint64_t>(g_get_monotonic_time());
+}
+
+time_t SystemClock::getWallTime() const
+{
+	return time(nullptr);
+}
+
+void SystemClock::sleepMS(int milliseconds)
+{
+	std::this_thread::sleep_for(std::chrono::milliseconds(milliseconds));
+}
+
+guint SystemClock::addTimeout(unsigned int intervalMS, GSourceFunc func, gpointer pUserData)
+{
+	return g_timeout_add(intervalMS, func, pUserData);
+}
+
+guint SystemClock::addTimeoutSeconds(unsigned int intervalSeconds, GSourceFunc func, gpointer pUserData)
+{
+	return g_timeout_add_seconds(intervalSeconds, func, pUserData);
+}
+
+// Same as `Clock::addPeriodicTimer()`, but driven by a `timerfd` with absolute CLOCK_MONOTONIC deadlines
+//
+// Falls back to polling the clock if a timerfd can't be created
+guint SystemClock::addPeriodicTimer(uint64_t intervalUS, PeriodicFunc func, gpointer pUserData)
+{
+	if (0 == intervalUS)
+	{
+		return 0;
+	}
+
+	int fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+	if (fd < 0)
+	{
+		Logger::warn(SSTR << "Failed to create a timerfd (" << strerror(errno) << "); the periodic timer will poll the clock instead");
+		return Clock::addPeriodicTimer(intervalUS, func, pUserData);
+	}
+
+	uint64_t firstDeadlineUS = getMonotonicUS() + intervalUS;
+
+	struct itimerspec spec;
+	spec.it_value.tv_sec = static_cast<time_t>(firstDeadlineUS / 1000000);
+	spec.it_value.tv_nsec = static_cast<long>((firstDeadlineUS % 1000000) * 1000);
+	spec.it_interval.tv_sec = static_cast<time_t>(intervalUS / 1000000);
+	spec.it_interval.tv_nsec = static_cast<long>((intervalUS % 1000000) * 1000);
+
+	if (timerfd_settime(fd, TFD_TIMER_ABSTIME, &spec, nullptr) < 0)
+	{
+		Logger::warn(SSTR << "Failed to arm a timerfd (" << strerror(errno) << "); the periodic timer will poll the clock instead");
+		close(fd);
+		return Clock::addPeriodicTimer(intervalUS, func, pUserData);
+	}
+
+	return addClockSource(*this, fd, firstDeadlineUS, intervalUS, func, nullptr, pUserData);
+}
+
+// ---------------------------------------------------------------------------------------------------------------------------------
+// VirtualClock
+// ---------------------------------------------------------------------------------------------------------------------------------
+
+// Starts the clock at the given wall clock time, with a monotonic time of zero
+VirtualClock::VirtualClock(time_t startWallTime)
+: nowUS(0), startWallTime(startWallTime)
+{
+}
+
+uint64_t VirtualClock::getMonotonicUS() const
+{
+	std::lock_guard<std::mutex> lock(timeMutex);
+	return nowUS;
+}
+
+time_t VirtualClock::getWallTime() const
+{
+	std::lock_guard<std::mutex> lock(timeMutex);
+	return startWallTime + static_cast<time_t>(nowUS / 1000000);
+}
+
+// Returns once the virtual time has passed `milliseconds` from now, or after `milliseconds` of real time, whichever comes first
+void VirtualClock::sleepMS(int milliseconds)
+{
+	std::unique_lock<std::mutex> lock(timeMutex);
+	uint64_t deadlineUS = nowUS + static_cast<uint64_t>(milliseconds) * 1000;
+	timeAdvanced.wait_for(lock, std::chrono::milliseconds(milliseconds), [this, deadlineUS]() { return nowUS >= deadlineUS; });
+}
+
+guint VirtualClock::addTimeout(unsigned int intervalMS, GSourceFunc func, gpointer pUserData)
+{
+	uint64_t intervalUS = static_cast<uint64_t>(intervalMS) * 1000;
+	return addClockSource(*this, -1, getMonotonicUS() + intervalUS, intervalUS, nullptr, func, pUserData);
+}
+
+guint VirtualClock::addTimeoutSeconds(unsigned int intervalSeconds, GSourceFunc func, gpointer pUserData)
+{
+	uint64_t intervalUS = static_cast<uint64_t>(intervalSeconds) * 1000000;
+	return addClockSource(*this, -1, getMonotonicUS() + intervalUS, intervalUS, nullptr, func, pUserData);
+}
+
+// Moves time forward by `milliseconds`
+//
+// Timers that come due fire on the main loop once for each of their periods that has elapsed.
+void VirtualClock::advanceMS(uint64_t milliseconds)
+{
+	{
+		std::lock_guard<std::mutex> lock(timeMutex);
+		nowUS += milliseconds * 1000;
+	}
+
+	timeAdvanced.notify_all();
+	g_main_context_wakeup(nullptr);
+}
+
+}; // namespace ggk
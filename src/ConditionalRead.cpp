@@ -0,0 +1,254 @@
+// Copyright 2017-2019 Paul Nettle
+//
+// This file is part of Gobbledegook.
+//
+// Use of this source code is governed by a BSD-style license that can be found
+// in the LICENSE file in the root of the source tree.
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//
+// >>
+// >>>  INSIDE THIS FILE
+// >>
+//
+// Versioned reads that skip sending a value the client already has
+//
+// >>
+// >>>  DISCUSSION
+// >>
+//
+// Clients that poll a characteristic, or that read everything again on every reconnection, spend most of their reads fetching
+// values they already have. For a large value that means several ATT round trips (a long read) per poll for nothing.
+//
+// Every characteristic keeps a version of its value (see `GattCharacteristic::getValueVersion()`) which goes up whenever the value
+// may have changed. A characteristic that enables conditional reads (see `GattCharacteristic::conditionalReads()`) answers the
+// clients that opt in (below) with a status byte and that version ahead of the value, and a client that shows it already has the
+// current version gets a one-byte reply instead:
+//
+//     status   (1 byte)   - EReplyUnchanged: the client's copy is current and nothing else follows
+//
+//     status   (1 byte)   - EReplyValue: the version and the value follow
+//     version  (4 bytes)  - little-endian
+//     value    (the rest)
+//
+// Every other client reads the plain value, exactly as it would without conditional reads, so generic GATT clients are unaffected.
+//
+// A client opts in by writing a 4-byte little-endian version to the characteristic's version descriptor (kVersionDescriptorUuid):
+// the version of the copy it holds, or any version that isn't current (such as 0xFFFFFFFF) if it has none. This is how a client
+// that reconnects with a cached copy avoids reading it again. From then on, every full reply it receives is remembered as its
+// version. Writing a version of 0 opts the client out, after which every read returns the plain value again.
+//
+// Reading the version descriptor returns the current version, so a client can also check for changes without reading the value.
+//
+// The value comes from the characteristic's own `onReadValue` (or `onComputeValue`) method. The version is read before the value,
+// so a change that races with a read can only make the served version older than the value, which costs the client one extra read
+// rather than a missed change.
+//
+// Replies are built at offset 0 and served MTU - 1 bytes at a time, so every piece of a long read comes from the same reply.
+// Clients are told apart using the "device" option that BlueZ passes with every call; we remember up to `kMaxClients` of them per
+// characteristic.
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+#include <stdint.h>
+#include <map>
+#include <vector>
+
+#include "ConditionalRead.h"
+#include "../include/DBusBackend.h"
+#include "../include/GattCharacteristic.h"
+#include "../include/GattDescriptor.h"
+#include "../include/Utils.h"
+#include "../include/Logger.h"
+
+namespace ggk {
+
+const char *ConditionalRead::kVersionDescriptorUuid = "0000C101-1E3D-FAD4-74E2-97A033F1BFEE";
+
+// What we know about one client of one characteristic
+struct ConditionalReadClient
+{
+	uint32_t knownVersion;
+	bool bOptedIn;
+	std::vector<guint8> reply;
+	uint64_t lastUsed;
+};
+
+// Our clients, keyed by characteristic path, then by device path (main loop only)
+static std::map<std::string, std::map<std::string, ConditionalReadClient> > clients;
+static uint64_t useCounter = 0;
+
+// ---------------------------------------------------------------------------------------------------------------------------------
+// Helpers
+// ---------------------------------------------------------------------------------------------------------------------------------
+
+// Returns the options dictionary (at `index` within the method parameters), or nullptr if there isn't one
+static GVariant *getOptions(GVariant *pParameters, gsize index)
+{
+	if (nullptr == pParameters || g_variant_n_children(pParameters) <= index)
+	{
+		return nullptr;
+	}
+
+	return g_variant_get_child_value(pParameters, index);
+}
+
+// Returns the state for the client making this call, making room for it if necessary
+static ConditionalReadClient &getClient(const GattCharacteristic &characteristic, GVariant *pOptions)
+{
+	const char *pDevice = nullptr;
+	if (nullptr != pOptions)
+	{
+		g_variant_lookup(pOptions, "device", "&o", &pDevice);
+	}
+
+	std::string device = nullptr == pDevice ? "" : pDevice;
+	std::map<std::string, ConditionalReadClient> &characteristicClients = clients[characteristic.getPath().toString()];
+
+	auto it = characteristicClients.find(device);
+	if (it == characteristicClients.end())
+	{
+		if (characteristicClients.size() >= ConditionalRead::kMaxClients)
+		{
+			// Forget the client we heard from least recently
+			auto oldest = characteristicClients.begin();
+			for (auto candidate = characteristicClients.begin(); candidate != characteristicClients.end(); ++candidate)
+			{
+				if (candidate->second.lastUsed < oldest->second.lastUsed) { oldest = candidate; }
+			}
+			characteristicClients.erase(oldest);
+		}
+
+		ConditionalReadClient &client = characteristicClients[device];
+		client.knownVersion = 0;
+		client.bOptedIn = false;
+		client.lastUsed = ++useCounter;
+		return client;
+	}
+
+	it->second.lastUsed = ++useCounter;
+	return it->second;
+}
+
+// Appends `version` to `bytes` in little-endian order
+static void appendVersion(std::vector<guint8> &bytes, uint32_t version)
+{
+	for (size_t i = 0; i < ConditionalRead::kVersionSize; ++i)
+	{
+		bytes.push_back(static_cast<guint8>((version >> (i * 8)) & 0xff));
+	}
+}
+
+// ---------------------------------------------------------------------------------------------------------------------------------
+// Handlers
+// ---------------------------------------------------------------------------------------------------------------------------------
+
+// Answers a `ReadValue` call for a characteristic with conditional reads enabled
+void ConditionalRead::onReadValue(const GattCharacteristic &self, GDBusConnection *pConnection, GVariant *pParameters, GDBusMethodInvocation *pInvocation)
+{
+	GVariant *pOptions = getOptions(pParameters, 0);
+	guint16 offset = 0;
+	guint16 mtu = 0;
+	if (nullptr != pOptions)
+	{
+		g_variant_lookup(pOptions, "offset", "q", &offset);
+		g_variant_lookup(pOptions, "mtu", "q", &mtu);
+	}
+
+	ConditionalReadClient &client = getClient(self, pOptions);
+	if (nullptr != pOptions) { g_variant_unref(pOptions); }
+
+	if (0 == offset)
+	{
+		// Read the version first (see the discussion at the top of this file)
+		uint32_t version = self.getValueVersion();
+
+		if (client.bOptedIn && client.knownVersion == version)
+		{
+			client.reply.assign(1, static_cast<guint8>(EReplyUnchanged));
+			self.methodReturnVariant(pInvocation, Utils::gvariantFromByteArray(client.reply), true);
+			return;
+		}
+
+		bool readable = false;
+		GVariant *pValue = self.readValueLocally(pConnection, &readable);
+		if (nullptr == pValue)
+		{
+			client.reply.clear();
+			DBusBackend::getInstance().methodReturnError(pInvocation, readable ? "org.bluez.Error.Failed" : "org.bluez.Error.NotPermitted", readable ? "No value available" : "Characteristic is not readable");
+			return;
+		}
+
+		gsize length = 0;
+		const guint8 *pBytes = static_cast<const guint8 *>(g_variant_get_fixed_array(pValue, &length, 1));
+
+		// Only clients that opted in understand the status and version prefix
+		client.reply.clear();
+		if (client.bOptedIn)
+		{
+			client.reply.push_back(static_cast<guint8>(EReplyValue));
+			appendVersion(client.reply, version);
+			client.knownVersion = version;
+		}
+
+		client.reply.insert(client.reply.end(), pBytes, pBytes + length);
+		g_variant_unref(pValue);
+	}
+
+	if (offset > client.reply.size())
+	{
+		DBusBackend::getInstance().methodReturnError(pInvocation, "org.bluez.Error.InvalidOffset", "Offset is beyond the end of the value");
+		return;
+	}
+
+	// An ATT read response carries at most MTU - 1 bytes
+	size_t count = client.reply.size() - offset;
+	if (mtu > 1 && count > static_cast<size_t>(mtu - 1))
+	{
+		count = mtu - 1;
+	}
+
+	self.methodReturnVariant(pInvocation, Utils::gvariantFromByteArray(client.reply.data() + offset, static_cast<int>(count)), true);
+}
+
+// The version descriptor's `ReadValue` handler: returns the characteristic's current version
+void ConditionalRead::onVersionRead(const GattDescriptor &self, GDBusConnection * /*pConnection*/, const std::string & /*methodName*/, GVariant * /*pParameters*/, GDBusMethodInvocation *pInvocation, void * /*pUserData*/)
+{
+	std::vector<guint8> bytes;
+	appendVersion(bytes, self.getCharacteristic().getValueVersion());
+	self.methodReturnVariant(pInvocation, Utils::gvariantFromByteArray(bytes), true);
+}
+
+// The version descriptor's `WriteValue` handler: records the version the client already has
+void ConditionalRead::onVersionWrite(const GattDescriptor &self, GDBusConnection * /*pConnection*/, const std::string & /*methodName*/, GVariant *pParameters, GDBusMethodInvocation *pInvocation, void * /*pUserData*/)
+{
+	GVariant *pValue = g_variant_get_child_value(pParameters, 0);
+	gsize size = 0;
+	const guint8 *pBytes = static_cast<const guint8 *>(g_variant_get_fixed_array(pValue, &size, 1));
+
+	if (size != kVersionSize)
+	{
+		g_variant_unref(pValue);
+		DBusBackend::getInstance().methodReturnError(pInvocation, "org.bluez.Error.InvalidValueLength", "A version is 4 bytes");
+		return;
+	}
+
+	uint32_t version = 0;
+	for (size_t i = 0; i < kVersionSize; ++i)
+	{
+		version |= static_cast<uint32_t>(pBytes[i]) << (i * 8);
+	}
+	g_variant_unref(pValue);
+
+	GVariant *pOptions = getOptions(pParameters, 1);
+	ConditionalReadClient &client = getClient(self.getCharacteristic(), pOptions);
+	if (nullptr != pOptions) { g_variant_unref(pOptions); }
+
+	// A version of 0 opts the client out
+	client.knownVersion = version;
+	client.bOptedIn = 0 != version;
+
+	Logger::debug(SSTR << "Client " << (client.bOptedIn ? "has" : "opted out of") << " version " << version << " of '" << self.getCharacteristic().getPath() << "'");
+	self.methodReturnVariant(pInvocation, NULL);
+}
+
+}; // namespace ggk
@@ -0,0 +1,63 @@
+// Copyright 2017-2019 Paul Nettle
+//
+// This file is part of Gobbledegook.
+//
+// Use of this source code is governed by a BSD-style license that can be found
+// in the LICENSE file in the root of the source tree.
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//
+// >>
+// >>>  INSIDE THIS FILE
+// >>
+//
+// Versioned reads that skip sending a value the client already has
+//
+// >>
+// >>>  DISCUSSION
+// >>
+//
+// See the discussion at the top of ConditionalRead.cpp
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+#pragma once
+
+#include <gio/gio.h>
+#include <stddef.h>
+#include <string>
+
+namespace ggk {
+
+struct GattCharacteristic;
+struct GattDescriptor;
+
+class ConditionalRead
+{
+public:
+	// The UUID of the descriptor that `GattCharacteristic::conditionalReads()` adds
+	static const char *kVersionDescriptorUuid;
+
+	// The number of clients whose versions we remember at once (per characteristic)
+	static const size_t kMaxClients = 16;
+
+	// The size of a version on the wire
+	static const size_t kVersionSize = 4;
+
+	// The first byte of every reply to a client that opted in
+	enum ReplyStatus
+	{
+		EReplyValue = 0x00,
+		EReplyUnchanged = 0x01
+	};
+
+	// Answers a `ReadValue` call for a characteristic with conditional reads enabled
+	static void onReadValue(const GattCharacteristic &self, GDBusConnection *pConnection, GVariant *pParameters, GDBusMethodInvocation *pInvocation);
+
+	// The version descriptor's `ReadValue` handler: returns the characteristic's current version
+	static void onVersionRead(const GattDescriptor &self, GDBusConnection *pConnection, const std::string &methodName, GVariant *pParameters, GDBusMethodInvocation *pInvocation, void *pUserData);
+
+	// The version descriptor's `WriteValue` handler: records the version the client already has
+	static void onVersionWrite(const GattDescriptor &self, GDBusConnection *pConnection, const std::string &methodName, GVariant *pParameters, GDBusMethodInvocation *pInvocation, void *pUserData);
+};
+
+}; // namespace ggk
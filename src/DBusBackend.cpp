@@ -0,0 +1,175 @@
+// Copyright 2017-2019 Paul Nettle
+//
+// This file is part of Gobbledegook.
+//
+// Use of this source code is governed by a BSD-style license that can be found
+// in the LICENSE file in the root of the source tree.
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//
+// >>
+// >>>  INSIDE THIS FILE
+// >>
+//
+// This is the selection point for the D-Bus transport used by the server
+//
+// >>
+// >>>  DISCUSSION
+// >>
+//
+// Everything the server does on D-Bus goes through a `DBusBackend`: connecting to the bus, owning our name, registering our
+// object hierarchy, dispatching incoming method calls and property access, replying to methods, emitting signals and calling
+// methods on BlueZ.
+//
+// Two backends are available:
+//
+//     GDBus  (GDBusBackend.cpp)  - GIO's D-Bus implementation. This is the default.
+//
+//     sd-bus (SdBusBackend.cpp)  - systemd's D-Bus library. It runs on our own main loop (no worker thread) and avoids GIO's
+//                                  GObject machinery for each message, which makes a real difference on small boards.
+//
+// The backend is chosen at configure time:
+//
+//     ./configure --with-dbus-backend=sdbus
+//
+// GVariant is still used for all values regardless of the backend, so the server description is unchanged. The
+// `GDBusConnection *` and `GDBusMethodInvocation *` handles passed to the callbacks are only real GIO objects with the GDBus
+// backend. Services should always reply through `methodReturnValue()`/`methodReturnVariant()` and emit signals through the
+// `sendChangeNotification*()` methods, never by calling GIO directly.
+//
+// That rule is also what makes local invocations possible. The batch read characteristic (BatchRead.cpp) serves several
+// characteristics' values at once by calling their ordinary `ReadValue` handlers with a handle from `beginLocalInvocation()`. The
+// handle isn't a real invocation at all: each backend hands every reply to `completeLocalInvocation()` first, which keeps the
+// replies to local invocations rather than letting them reach the bus.
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+#include <set>
+
+#include "../include/DBusBackend.h"
+#include "GDBusBackend.h"
+#include "SdBusBackend.h"
+
+namespace ggk {
+
+// Returns the backend selected at configure time (see `--with-dbus-backend`)
+DBusBackend &DBusBackend::getInstance()
+{
+#if defined(GGK_DBUS_BACKEND_SDBUS)
+	static SdBusBackend instance;
+#else
+	static GDBusBackend instance;
+#endif
+	return instance;
+}
+
+// ---------------------------------------------------------------------------------------------------------------------------------
+// Local invocations
+// ---------------------------------------------------------------------------------------------------------------------------------
+
+// The state behind a local invocation handle
+struct LocalInvocation
+{
+	GVariant *pReply;
+	bool bReplied;
+	bool bAbandoned;
+};
+
+// Every handle that may still receive a reply (main loop only)
+static std::set<LocalInvocation *> localInvocations;
+
+// Creates an invocation handle whose reply is captured rather than sent
+GDBusMethodInvocation *DBusBackend::beginLocalInvocation()
+{
+	LocalInvocation *pLocal = new LocalInvocation;
+	pLocal->pReply = nullptr;
+	pLocal->bReplied = false;
+	pLocal->bAbandoned = false;
+
+	localInvocations.insert(pLocal);
+	return reinterpret_cast<GDBusMethodInvocation *>(pLocal);
+}
+
+// Finishes a local invocation and returns its reply (with a reference owned by the caller), or nullptr if the handler replied with
+// an error, with no value or not at all
+GVariant *DBusBackend::endLocalInvocation(GDBusMethodInvocation *pInvocation)
+{
+	LocalInvocation *pLocal = reinterpret_cast<LocalInvocation *>(pInvocation);
+	if (localInvocations.find(pLocal) == localInvocations.end())
+	{
+		return nullptr;
+	}
+
+	// Keep the handle around so that a late reply has somewhere to go
+	if (!pLocal->bReplied)
+	{
+		pLocal->bAbandoned = true;
+		return nullptr;
+	}
+
+	GVariant *pReply = pLocal->pReply;
+	localInvocations.erase(pLocal);
+	delete pLocal;
+	return pReply;
+}
+
+// The most recent reply sent from this thread (see `lastReplyWasError()`)
+static thread_local GDBusMethodInvocation *pLastReply = nullptr;
+static thread_local bool bLastReplyWasError = false;
+
+// Returns true if the most recent reply sent from this thread was an error reply to `pInvocation`
+bool DBusBackend::lastReplyWasError(GDBusMethodInvocation *pInvocation)
+{
+	return pInvocation == pLastReply && bLastReplyWasError;
+}
+
+// If `pInvocation` is a local invocation, records its reply (consuming a floating reference to `pParameters`) and returns true
+bool DBusBackend::completeLocalInvocation(GDBusMethodInvocation *pInvocation, GVariant *pParameters, const char *pErrorName)
+{
+	pLastReply = pInvocation;
+	bLastReplyWasError = nullptr != pErrorName;
+
+	if (localInvocations.empty())
+	{
+		return false;
+	}
+
+	LocalInvocation *pLocal = reinterpret_cast<LocalInvocation *>(pInvocation);
+	if (localInvocations.find(pLocal) == localInvocations.end())
+	{
+		return false;
+	}
+
+	if (nullptr != pParameters)
+	{
+		g_variant_ref_sink(pParameters);
+	}
+
+	// Nobody is waiting for this reply any more
+	if (pLocal->bAbandoned)
+	{
+		if (nullptr != pParameters) { g_variant_unref(pParameters); }
+		localInvocations.erase(pLocal);
+		delete pLocal;
+		return true;
+	}
+
+	if (pLocal->bReplied)
+	{
+		if (nullptr != pParameters) { g_variant_unref(pParameters); }
+		return true;
+	}
+
+	pLocal->bReplied = true;
+	if (nullptr == pErrorName)
+	{
+		pLocal->pReply = pParameters;
+	}
+	else if (nullptr != pParameters)
+	{
+		g_variant_unref(pParameters);
+	}
+
+	return true;
+}
+
+}; // namespace ggk
@@ -47,6 +47,8 @@
 #include "../include/GattProperty.h"
 #include "../include/DBusObject.h"
 #include "../include/Logger.h"
+#include "InternTable.h"
+#include "OverloadController.h"
 
 namespace ggk {
 
@@ -55,7 +57,7 @@ namespace ggk {
 //
 
 DBusInterface::DBusInterface(DBusObject &owner, const std::string &name)
-: owner(owner), name(name)
+: owner(owner), name(InternTable::intern(name))
 {
 }
 
@@ -70,13 +72,13 @@ DBusInterface::~DBusInterface()
 // Returns the name of this interface (ex: "org.freedesktop.DBus.Properties")
 const std::string &DBusInterface::getName() const
 {
-	return name;
+	return *name;
 }
 
 // Sets the name of the interface (ex: "org.freedesktop.DBus.Properties")
 DBusInterface &DBusInterface::setName(const std::string &name)
 {
-	this->name = name;
+	this->name = InternTable::intern(name);
 	return *this;
 }
 
@@ -115,6 +117,12 @@ DBusInterface &DBusInterface::addMethod(const std::string &name, const char *pIn
 	return *this;
 }
 
+// Returns the methods added with `addMethod()`
+const std::list<DBusMethod> &DBusInterface::getMethods() const
+{
+	return methods;
+}
+
 // Calls a named method on this interface
 //
 // This method returns false if the method could not be found, otherwise it returns true. Note that the return value is not related
@@ -157,11 +165,11 @@ DBusInterface &DBusInterface::onEvent(int tickFrequency, void *pUserData, TickEv
 //
 // NOTE: Subclasses are encouraged to override this method in order to support different callback types that are specific to
 // their subclass type.
-void DBusInterface::tickEvents(GDBusConnection *pConnection, void *pUserData) const
+void DBusInterface::tickEvents(GDBusConnection *pConnection, void *pUserData, int ticks) const
 {
 	for (const TickEvent &event : events)
 	{
-		event.tick<DBusInterface>(getPath(), pConnection, pUserData);
+		event.tick<DBusInterface>(getPath(), pConnection, pUserData, OverloadController::getTickMultiplier(), ticks);
 	}
 }
 
@@ -42,6 +42,8 @@
 #include "../include/DBusInterface.h"
 #include "../include/GattService.h"
 #include "../include/DBusObject.h"
+#include "../include/DBusBackend.h"
+#include "BatchController.h"
 #include "../include/Utils.h"
 #include "../include/GattUuid.h"
 #include "../include/Logger.h"
@@ -196,16 +198,16 @@ bool DBusObject::callMethod(const DBusObjectPath &path, const std::string &inter
 }
 
 // Periodic timer tick propagation
-void DBusObject::tickEvents(GDBusConnection *pConnection, void *pUserData) const
+void DBusObject::tickEvents(GDBusConnection *pConnection, void *pUserData, int ticks) const
 {
 	for (std::shared_ptr<const DBusInterface> interface : interfaces)
 	{
-		interface->tickEvents(pConnection, pUserData);
+		interface->tickEvents(pConnection, pUserData, ticks);
 	}
 
 	for (const DBusObject &child : getChildren())
 	{
-		child.tickEvents(pConnection, pUserData);
+		child.tickEvents(pConnection, pUserData, ticks);
 	}
 }
 
@@ -258,22 +260,10 @@ std::string DBusObject::generateIntrospectionXML(int depth) const
 // Emits a signal on the bus from the given path, interface name and signal name, containing a GVariant set of parameters
 void DBusObject::emitSignal(GDBusConnection *pBusConnection, const std::string &interfaceName, const std::string &signalName, GVariant *pParameters)
 {
-	GError *pError = nullptr;
-	gboolean result = g_dbus_connection_emit_signal
-	(
-		pBusConnection,          // GDBusConnection *connection
-		NULL,                    // const gchar *destination_bus_name
-		getPath().c_str(),       // const gchar *object_path
-		interfaceName.c_str(),   // const gchar *interface_name
-		signalName.c_str(),      // const gchar *signal_name
-		pParameters,             // GVariant *parameters
-		&pError                  // GError **error
-	);
-
-	if (0 == result)
-	{
-		Logger::error(SSTR << "Failed to emit signal named '" << signalName << "': " << (nullptr == pError ? "Unknown" : pError->message));
-	}
+	// The cost of each signal helps decide how to batch notifications (see BatchController.cpp)
+	uint64_t startUS = BatchController::nowUS();
+	DBusBackend::getInstance().emitSignal(pBusConnection, getPath(), interfaceName, signalName, pParameters);
+	BatchController::recordEmit(BatchController::nowUS() - startUS);
 }
 
 
@@ -0,0 +1,179 @@
+// Copyright 2017-2019 Paul Nettle
+//
+// This file is part of Gobbledegook.
+//
+// Use of this source code is governed by a BSD-style license that can be found
+// in the LICENSE file in the root of the source tree.
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//
+// >>
+// >>>  INSIDE THIS FILE
+// >>
+//
+// Fetches several values from the application's data getter at once, for the duration of a handler
+//
+// >>
+// >>>  DISCUSSION
+// >>
+//
+// `GGKServerDataGetter` returns one value per call. A characteristic that builds its value from ten keys makes ten calls, and the
+// application matches each name against its own list every time. An application can register a `GGKServerDataBatchGetter` to
+// answer for many names in one call instead.
+//
+// A characteristic lists the keys its handlers use with `dataKeys()`. Before any of its handlers runs (a D-Bus method, its
+// `onUpdatedValue` or its `onComputeValue`) a `DataPrefetch` fetches those keys together, and `getDataValue()` and
+// `getDataPointer()` answer from it until the handler returns. A batch read (see BatchRead.cpp) prefetches the keys of every
+// characteristic it reads, so a frame built from many characteristics costs one call to the application.
+//
+// Prefetches are per thread and nest. An inner prefetch only fetches keys that the enclosing ones don't already hold, and lookups
+// search from the innermost out. Names that no prefetch holds go to `GGKServerDataGetter` as before.
+//
+// A prefetched value is only as fresh as the start of the handler. When a handler sends a new value to the application (with
+// `setDataValue()` or `setDataPointer()`), that key is forgotten so that the next read asks the application again.
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+#include <algorithm>
+
+#include "DataPrefetch.h"
+#include "../include/Server.h"
+
+namespace ggk {
+
+// The innermost prefetch on this thread
+static thread_local DataPrefetch *pCurrentPrefetch = nullptr;
+
+// Fetches the values for `names` (skipping any an enclosing prefetch on this thread already holds) and makes them available to
+// `get()` on this thread until this object is destroyed
+DataPrefetch::DataPrefetch(const std::vector<std::string> &names)
+: pOuter(pCurrentPrefetch)
+{
+	for (const std::string &name : names)
+	{
+		const void *pValue = nullptr;
+		if (!find(name.c_str(), pValue) && std::find(this->names.begin(), this->names.end(), name) == this->names.end())
+		{
+			this->names.push_back(name);
+		}
+	}
+
+	if (!this->names.empty())
+	{
+		std::vector<const char *> missing;
+		for (const std::string &name : this->names)
+		{
+			missing.push_back(name.c_str());
+		}
+
+		values.assign(missing.size(), nullptr);
+		getMany(missing.data(), values.data(), static_cast<int>(missing.size()));
+	}
+
+	pCurrentPrefetch = this;
+}
+
+DataPrefetch::~DataPrefetch()
+{
+	pCurrentPrefetch = pOuter;
+}
+
+// Looks for `pName` in the prefetches on this thread, innermost first
+bool DataPrefetch::find(const char *pName, const void *&pValue)
+{
+	for (DataPrefetch *pPrefetch = pCurrentPrefetch; nullptr != pPrefetch; pPrefetch = pPrefetch->pOuter)
+	{
+		for (size_t i = 0; i < pPrefetch->names.size(); ++i)
+		{
+			if (pPrefetch->names[i] == pName)
+			{
+				pValue = pPrefetch->values[i];
+				return true;
+			}
+		}
+	}
+
+	return false;
+}
+
+// Returns the value for `pName`, from the innermost prefetch on this thread that holds it or from the application's data getter if
+// none do
+const void *DataPrefetch::get(const char *pName)
+{
+	const void *pValue = nullptr;
+	if (find(pName, pValue))
+	{
+		return pValue;
+	}
+
+	// We may be on a worker thread (see `GattCharacteristic::onComputeValue()`), so we can't read `TheServer` directly
+	return std::atomic_load(&TheServer)->getDataGetter()(pName);
+}
+
+// Fetches `count` values into `ppValues` in one call to the application's batch data getter (if it registered one), using values
+// already prefetched on this thread where possible
+//
+// Returns the number of values found
+int DataPrefetch::getMany(const char *const *ppNames, const void **ppValues, int count)
+{
+	// Take what we already have, and gather the rest
+	std::vector<const char *> missingNames;
+	std::vector<int> missingIndices;
+	for (int i = 0; i < count; ++i)
+	{
+		ppValues[i] = nullptr;
+		if (!find(ppNames[i], ppValues[i]))
+		{
+			missingNames.push_back(ppNames[i]);
+			missingIndices.push_back(i);
+		}
+	}
+
+	if (!missingNames.empty())
+	{
+		int missingCount = static_cast<int>(missingNames.size());
+		std::vector<const void *> missingValues(missingNames.size(), nullptr);
+
+		GGKServerDataBatchGetter batchGetter = Server::getDataBatchGetter();
+		if (nullptr == batchGetter || 0 == batchGetter(missingNames.data(), missingValues.data(), missingCount))
+		{
+			for (int i = 0; i < missingCount; ++i)
+			{
+				missingValues[i] = std::atomic_load(&TheServer)->getDataGetter()(missingNames[i]);
+			}
+		}
+
+		for (int i = 0; i < missingCount; ++i)
+		{
+			ppValues[missingIndices[i]] = missingValues[i];
+		}
+	}
+
+	int found = 0;
+	for (int i = 0; i < count; ++i)
+	{
+		if (nullptr != ppValues[i]) { found += 1; }
+	}
+
+	return found;
+}
+
+// Forgets any value prefetched for `pName` on this thread, so the next `get()` asks the application again
+//
+// Call this after sending the application a new value for `pName`.
+void DataPrefetch::forget(const char *pName)
+{
+	for (DataPrefetch *pPrefetch = pCurrentPrefetch; nullptr != pPrefetch; pPrefetch = pPrefetch->pOuter)
+	{
+		for (size_t i = 0; i < pPrefetch->names.size(); ++i)
+		{
+			if (pPrefetch->names[i] == pName)
+			{
+				pPrefetch->names.erase(pPrefetch->names.begin() + i);
+				pPrefetch->values.erase(pPrefetch->values.begin() + i);
+				break;
+			}
+		}
+	}
+}
+
+}; // namespace ggk
@@ -0,0 +1,65 @@
+// Copyright 2017-2019 Paul Nettle
+//
+// This file is part of Gobbledegook.
+//
+// Use of this source code is governed by a BSD-style license that can be found
+// in the LICENSE file in the root of the source tree.
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//
+// >>
+// >>>  INSIDE THIS FILE
+// >>
+//
+// Fetches several values from the application's data getter at once, for the duration of a handler
+//
+// >>
+// >>>  DISCUSSION
+// >>
+//
+// See the discussion at the top of DataPrefetch.cpp
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+namespace ggk {
+
+class DataPrefetch
+{
+public:
+	// Fetches the values for `names` (skipping any an enclosing prefetch on this thread already holds) and makes them available to
+	// `get()` on this thread until this object is destroyed
+	DataPrefetch(const std::vector<std::string> &names);
+	~DataPrefetch();
+
+	// Returns the value for `pName`, from the innermost prefetch on this thread that holds it or from the application's data
+	// getter if none do
+	static const void *get(const char *pName);
+
+	// Fetches `count` values into `ppValues` in one call to the application's batch data getter (if it registered one), using
+	// values already prefetched on this thread where possible
+	//
+	// Returns the number of values found
+	static int getMany(const char *const *ppNames, const void **ppValues, int count);
+
+	// Forgets any value prefetched for `pName` on this thread, so the next `get()` asks the application again
+	//
+	// Call this after sending the application a new value for `pName`.
+	static void forget(const char *pName);
+
+private:
+	DataPrefetch(const DataPrefetch &) = delete;
+	DataPrefetch &operator =(const DataPrefetch &) = delete;
+
+	// Looks for `pName` in the prefetches on this thread, innermost first
+	static bool find(const char *pName, const void *&pValue);
+
+	std::vector<std::string> names;
+	std::vector<const void *> values;
+	DataPrefetch *pOuter;
+};
+
+}; // namespace ggk
@@ -0,0 +1,431 @@
+// Copyright 2017-2019 Paul Nettle
+//
+// This file is part of Gobbledegook.
+//
+// Use of this source code is governed by a BSD-style license that can be found
+// in the LICENSE file in the root of the source tree.
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//
+// >>
+// >>>  INSIDE THIS FILE
+// >>
+//
+// The GDBus (GIO) implementation of our D-Bus backend
+//
+// >>
+// >>>  DISCUSSION
+// >>
+//
+// This is the code that used to live directly in Init.cpp. Our objects are registered by generating their XML introspection,
+// parsing it into a GDBusNodeInfo tree and registering each interface of each node with GIO.
+//
+// See the discussion at the top of DBusBackend.cpp for more information.
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+#include "GDBusBackend.h"
+#include "../include/DBusObject.h"
+#include "../include/Logger.h"
+
+namespace ggk {
+
+// Our registered dispatch table
+//
+// GDBus calls our vtable with a user data pointer; we use that to carry the dispatch table
+static DBusBackend::Dispatch gdbusDispatch = { nullptr, nullptr, nullptr };
+
+// Context for an outstanding outgoing method call
+struct GDBusPendingCall
+{
+	GDBusBackend *pBackend;
+	DBusBackend::CallReplyCallback callback;
+	void *pUserData;
+};
+
+// Context for a signal subscription
+struct GDBusSubscription
+{
+	DBusBackend::SignalCallback callback;
+	void *pUserData;
+};
+
+GDBusBackend::GDBusBackend()
+: pConnection(nullptr), busAcquiredCallback(nullptr), ownedNameId(0), nameAcquiredCallback(nullptr), nameLostCallback(nullptr)
+{
+	interfaceVtable.method_call = [](GDBusConnection *pConnection, const gchar *pSender, const gchar *pObjectPath, const gchar *pInterfaceName, const gchar *pMethodName, GVariant *pParameters, GDBusMethodInvocation *pInvocation, gpointer pUserData)
+	{
+		GDBusBackend *pBackend = static_cast<GDBusBackend *>(pUserData);
+		pBackend->stats.methodCallsIn += 1;
+		gdbusDispatch.methodCall(pConnection, pSender, pObjectPath, pInterfaceName, pMethodName, pParameters, pInvocation, nullptr);
+	};
+
+	interfaceVtable.get_property = [](GDBusConnection *pConnection, const gchar *pSender, const gchar *pObjectPath, const gchar *pInterfaceName, const gchar *pPropertyName, GError **ppError, gpointer pUserData) -> GVariant *
+	{
+		GDBusBackend *pBackend = static_cast<GDBusBackend *>(pUserData);
+		pBackend->stats.methodCallsIn += 1;
+		return gdbusDispatch.getProperty(pConnection, pSender, pObjectPath, pInterfaceName, pPropertyName, ppError, nullptr);
+	};
+
+	interfaceVtable.set_property = [](GDBusConnection *pConnection, const gchar *pSender, const gchar *pObjectPath, const gchar *pInterfaceName, const gchar *pPropertyName, GVariant *pValue, GError **ppError, gpointer pUserData) -> gboolean
+	{
+		GDBusBackend *pBackend = static_cast<GDBusBackend *>(pUserData);
+		pBackend->stats.methodCallsIn += 1;
+		return gdbusDispatch.setProperty(pConnection, pSender, pObjectPath, pInterfaceName, pPropertyName, pValue, ppError, nullptr);
+	};
+}
+
+GDBusBackend::~GDBusBackend()
+{
+}
+
+// ---------------------------------------------------------------------------------------------------------------------------------
+// Bus connection
+// ---------------------------------------------------------------------------------------------------------------------------------
+
+// Asynchronously connect to the SYSTEM bus. The callback is always called from the main loop.
+void GDBusBackend::acquireBus(BusAcquiredCallback callback)
+{
+	busAcquiredCallback = callback;
+
+	g_bus_get
+	(
+		G_BUS_TYPE_SYSTEM,      // GBusType bus_type
+		nullptr,                // GCancellable *cancellable
+
+		// GAsyncReadyCallback callback
+		[] (GObject * /*pSourceObject*/, GAsyncResult *pAsyncResult, gpointer pUserData)
+		{
+			GDBusBackend *pBackend = static_cast<GDBusBackend *>(pUserData);
+
+			GError *pError = nullptr;
+			pBackend->pConnection = g_bus_get_finish(pAsyncResult, &pError);
+
+			if (nullptr == pBackend->pConnection)
+			{
+				pBackend->busAcquiredCallback(nullptr, nullptr == pError ? "Unknown" : pError->message);
+				return;
+			}
+
+			pBackend->busAcquiredCallback(pBackend->pConnection, nullptr);
+		},
+
+		this                    // gpointer user_data
+	);
+}
+
+// Release the bus connection
+void GDBusBackend::releaseBus()
+{
+	if (nullptr != pConnection)
+	{
+		g_object_unref(pConnection);
+		pConnection = nullptr;
+	}
+}
+
+// ---------------------------------------------------------------------------------------------------------------------------------
+// Name ownership
+// ---------------------------------------------------------------------------------------------------------------------------------
+
+// Request an owned name on the bus
+bool GDBusBackend::ownName(const std::string &name, NameCallback acquiredCallback, NameCallback lostCallback)
+{
+	nameAcquiredCallback = acquiredCallback;
+	nameLostCallback = lostCallback;
+
+	ownedNameId = g_bus_own_name_on_connection
+	(
+		pConnection,                      // GDBusConnection *connection
+		name.c_str(),                     // const gchar *name
+		G_BUS_NAME_OWNER_FLAGS_NONE,      // GBusNameOwnerFlags flags
+
+		// GBusNameAcquiredCallback name_acquired_handler
+		[](GDBusConnection *, const gchar *pName, gpointer pUserData)
+		{
+			static_cast<GDBusBackend *>(pUserData)->nameAcquiredCallback(pName);
+		},
+
+		// GBusNameLostCallback name_lost_handler
+		[](GDBusConnection *, const gchar *pName, gpointer pUserData)
+		{
+			static_cast<GDBusBackend *>(pUserData)->nameLostCallback(pName);
+		},
+
+		this,                             // gpointer user_data
+		nullptr                           // GDestroyNotify user_data_free_func
+	);
+
+	return ownedNameId > 0;
+}
+
+// Release our owned name, if we have one
+void GDBusBackend::unownName()
+{
+	if (ownedNameId > 0)
+	{
+		g_bus_unown_name(ownedNameId);
+		ownedNameId = 0;
+	}
+}
+
+// ---------------------------------------------------------------------------------------------------------------------------------
+// Object registration
+// ---------------------------------------------------------------------------------------------------------------------------------
+
+// Register each interface of a node (and its children) with GIO
+bool GDBusBackend::registerNodeHierarchy(GDBusNodeInfo *pNode, const DBusObjectPath &basePath, int depth)
+{
+	std::string prefix;
+	prefix.insert(0, depth * 2, ' ');
+
+	GDBusInterfaceInfo **ppInterface = pNode->interfaces;
+
+	Logger::debug(SSTR << prefix << "+ " << pNode->path);
+
+	while(nullptr != *ppInterface)
+	{
+		GError *pError = nullptr;
+		Logger::debug(SSTR << prefix << "    (iface: " << (*ppInterface)->name << ")");
+		guint registeredObjectId = g_dbus_connection_register_object
+		(
+			pConnection,                // GDBusConnection *connection
+			basePath.c_str(),           // const gchar *object_path
+			*ppInterface,               // GDBusInterfaceInfo *interface_info
+			&interfaceVtable,           // const GDBusInterfaceVTable *vtable
+			this,                       // gpointer user_data
+			nullptr,                    // GDestroyNotify user_data_free_func
+			&pError                     // GError **error
+		);
+
+		if (0 == registeredObjectId)
+		{
+			Logger::error(SSTR << "Failed to register object: " << (nullptr == pError ? "Unknown" : pError->message));
+			return false;
+		}
+
+		// Save the registered object Id so we can clean it up later
+		registeredObjectIds.push_back(registeredObjectId);
+
+		++ppInterface;
+	}
+
+	GDBusNodeInfo **ppChild = pNode->nodes;
+	while(nullptr != *ppChild)
+	{
+		if (!registerNodeHierarchy(*ppChild, basePath + (*ppChild)->path, depth + 1))
+		{
+			return false;
+		}
+
+		++ppChild;
+	}
+
+	return true;
+}
+
+// Register an object (and its children) with the bus, dispatching all method calls and property access through `dispatch`
+bool GDBusBackend::registerObject(const DBusObject &object, const Dispatch &dispatch)
+{
+	gdbusDispatch = dispatch;
+
+	GError *pError = nullptr;
+	std::string xmlString = object.generateIntrospectionXML();
+	GDBusNodeInfo *pNode = g_dbus_node_info_new_for_xml(xmlString.c_str(), &pError);
+	if (nullptr == pNode)
+	{
+		Logger::error(SSTR << "Failed to introspect XML: " << (nullptr == pError ? "Unknown" : pError->message));
+		return false;
+	}
+
+	Logger::debug(SSTR << "Registering object hierarchy with D-Bus hierarchy");
+
+	// Register the node hierarchy
+	bool result = registerNodeHierarchy(pNode, DBusObjectPath(pNode->path), 1);
+
+	// Cleanup the node
+	g_dbus_node_info_unref(pNode);
+
+	// If anything failed, pretend like we were never here
+	if (!result)
+	{
+		unregisterObjects();
+	}
+
+	return result;
+}
+
+// Unregister all objects registered through `registerObject()`
+void GDBusBackend::unregisterObjects()
+{
+	for (guint id : registeredObjectIds)
+	{
+		g_dbus_connection_unregister_object(pConnection, id);
+	}
+
+	registeredObjectIds.clear();
+}
+
+// ---------------------------------------------------------------------------------------------------------------------------------
+// Method replies
+// ---------------------------------------------------------------------------------------------------------------------------------
+
+// Reply to a method invocation with a value
+void GDBusBackend::methodReturnValue(GDBusMethodInvocation *pInvocation, GVariant *pParameters)
+{
+	if (completeLocalInvocation(pInvocation, pParameters, nullptr))
+	{
+		return;
+	}
+
+	stats.methodReplies += 1;
+	g_dbus_method_invocation_return_value(pInvocation, pParameters);
+}
+
+// Reply to a method invocation with a D-Bus error
+void GDBusBackend::methodReturnError(GDBusMethodInvocation *pInvocation, const std::string &errorName, const std::string &errorMessage)
+{
+	if (completeLocalInvocation(pInvocation, nullptr, errorName.c_str()))
+	{
+		return;
+	}
+
+	stats.methodReplies += 1;
+	stats.errors += 1;
+	g_dbus_method_invocation_return_dbus_error(pInvocation, errorName.c_str(), errorMessage.c_str());
+}
+
+// ---------------------------------------------------------------------------------------------------------------------------------
+// Signals
+// ---------------------------------------------------------------------------------------------------------------------------------
+
+// Emit a signal from `path`
+bool GDBusBackend::emitSignal(GDBusConnection *pConnection, const DBusObjectPath &path, const std::string &interfaceName, const std::string &signalName, GVariant *pParameters)
+{
+	GError *pError = nullptr;
+	gboolean result = g_dbus_connection_emit_signal
+	(
+		pConnection,             // GDBusConnection *connection
+		NULL,                    // const gchar *destination_bus_name
+		path.c_str(),            // const gchar *object_path
+		interfaceName.c_str(),   // const gchar *interface_name
+		signalName.c_str(),      // const gchar *signal_name
+		pParameters,             // GVariant *parameters
+		&pError                  // GError **error
+	);
+
+	if (0 == result)
+	{
+		stats.errors += 1;
+		Logger::error(SSTR << "Failed to emit signal named '" << signalName << "': " << (nullptr == pError ? "Unknown" : pError->message));
+		return false;
+	}
+
+	stats.signalsOut += 1;
+	return true;
+}
+
+// ---------------------------------------------------------------------------------------------------------------------------------
+// Outgoing method calls
+// ---------------------------------------------------------------------------------------------------------------------------------
+
+// Asynchronously call a method on a remote object
+void GDBusBackend::callMethod(const std::string &busName, const DBusObjectPath &path, const std::string &interfaceName, const std::string &methodName, GVariant *pParameters, CallReplyCallback callback, void *pUserData)
+{
+	stats.methodCallsOut += 1;
+
+	GDBusPendingCall *pPending = new GDBusPendingCall;
+	pPending->pBackend = this;
+	pPending->callback = callback;
+	pPending->pUserData = pUserData;
+
+	g_dbus_connection_call
+	(
+		pConnection,                // GDBusConnection *connection
+		busName.c_str(),            // const gchar *bus_name
+		path.c_str(),               // const gchar *object_path
+		interfaceName.c_str(),      // const gchar *interface_name
+		methodName.c_str(),         // const gchar *method_name
+		pParameters,                // GVariant *parameters
+		nullptr,                    // const GVariantType *reply_type
+		G_DBUS_CALL_FLAGS_NONE,     // GDBusCallFlags flags
+		-1,                         // gint timeout_msec
+		nullptr,                    // GCancellable *cancellable
+
+		// GAsyncReadyCallback callback
+		[] (GObject * /*pSourceObject*/, GAsyncResult *pAsyncResult, gpointer pUserData)
+		{
+			GDBusPendingCall *pPending = static_cast<GDBusPendingCall *>(pUserData);
+
+			GError *pError = nullptr;
+			GVariant *pReply = g_dbus_connection_call_finish(pPending->pBackend->pConnection, pAsyncResult, &pError);
+			if (nullptr == pReply)
+			{
+				pPending->pBackend->stats.errors += 1;
+				pPending->callback(nullptr, nullptr == pError ? "Unknown" : pError->message, pPending->pUserData);
+			}
+			else
+			{
+				pPending->callback(pReply, nullptr, pPending->pUserData);
+				g_variant_unref(pReply);
+			}
+
+			if (nullptr != pError)
+			{
+				g_error_free(pError);
+			}
+
+			delete pPending;
+		},
+
+		pPending                    // gpointer user_data
+	);
+}
+
+// ---------------------------------------------------------------------------------------------------------------------------------
+// Signal subscriptions
+// ---------------------------------------------------------------------------------------------------------------------------------
+
+// Subscribe to a signal sent by `busName`, filtered on its first argument being the object path `arg0Path`
+unsigned int GDBusBackend::subscribeSignal(const std::string &busName, const std::string &interfaceName, const std::string &signalName, const DBusObjectPath &arg0Path, SignalCallback callback, void *pUserData)
+{
+	GDBusSubscription *pSubscription = new GDBusSubscription;
+	pSubscription->callback = callback;
+	pSubscription->pUserData = pUserData;
+
+	return g_dbus_connection_signal_subscribe
+	(
+		pConnection,                          // GDBusConnection *connection
+		busName.c_str(),                      // const gchar *sender
+		interfaceName.c_str(),                // const gchar *interface_name
+		signalName.c_str(),                   // const gchar *member
+		nullptr,                              // const gchar *object_path
+		arg0Path.c_str(),                     // const gchar *arg0
+		G_DBUS_SIGNAL_FLAGS_MATCH_ARG0_PATH,  // GDBusSignalFlags flags
+
+		// GDBusSignalCallback callback
+		[] (GDBusConnection * /*pConnection*/, const gchar * /*pSenderName*/, const gchar *pObjectPath, const gchar * /*pInterfaceName*/, const gchar * /*pSignalName*/, GVariant *pParameters, gpointer pUserData)
+		{
+			GDBusSubscription *pSubscription = static_cast<GDBusSubscription *>(pUserData);
+			pSubscription->callback(pObjectPath, pParameters, pSubscription->pUserData);
+		},
+
+		pSubscription,                        // gpointer user_data
+
+		// GDestroyNotify user_data_free_func
+		[] (gpointer pUserData)
+		{
+			delete static_cast<GDBusSubscription *>(pUserData);
+		}
+	);
+}
+
+// Cancel a subscription made with `subscribeSignal()`
+void GDBusBackend::unsubscribeSignal(unsigned int subscriptionId)
+{
+	if (nullptr != pConnection && 0 != subscriptionId)
+	{
+		g_dbus_connection_signal_unsubscribe(pConnection, subscriptionId);
+	}
+}
+
+}; // namespace ggk
@@ -0,0 +1,74 @@
+// Copyright 2017-2019 Paul Nettle
+//
+// This file is part of Gobbledegook.
+//
+// Use of this source code is governed by a BSD-style license that can be found
+// in the LICENSE file in the root of the source tree.
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//
+// >>
+// >>>  INSIDE THIS FILE
+// >>
+//
+// The GDBus (GIO) implementation of our D-Bus backend
+//
+// >>
+// >>>  DISCUSSION
+// >>
+//
+// See the discussion at the top of DBusBackend.cpp
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+#pragma once
+
+#include <gio/gio.h>
+#include <string>
+#include <vector>
+
+#include "../include/DBusBackend.h"
+
+namespace ggk {
+
+class GDBusBackend : public DBusBackend
+{
+public:
+	GDBusBackend();
+	virtual ~GDBusBackend();
+
+	virtual const char *getName() const { return "gdbus"; }
+
+	virtual void acquireBus(BusAcquiredCallback callback);
+	virtual void releaseBus();
+	virtual GDBusConnection *getConnection() const { return pConnection; }
+
+	virtual bool ownName(const std::string &name, NameCallback acquiredCallback, NameCallback lostCallback);
+	virtual void unownName();
+
+	virtual bool registerObject(const DBusObject &object, const Dispatch &dispatch);
+	virtual void unregisterObjects();
+	virtual bool hasRegisteredObjects() const { return !registeredObjectIds.empty(); }
+
+	virtual void methodReturnValue(GDBusMethodInvocation *pInvocation, GVariant *pParameters);
+	virtual void methodReturnError(GDBusMethodInvocation *pInvocation, const std::string &errorName, const std::string &errorMessage);
+
+	virtual bool emitSignal(GDBusConnection *pConnection, const DBusObjectPath &path, const std::string &interfaceName, const std::string &signalName, GVariant *pParameters);
+
+	virtual void callMethod(const std::string &busName, const DBusObjectPath &path, const std::string &interfaceName, const std::string &methodName, GVariant *pParameters, CallReplyCallback callback, void *pUserData);
+
+	virtual unsigned int subscribeSignal(const std::string &busName, const std::string &interfaceName, const std::string &signalName, const DBusObjectPath &arg0Path, SignalCallback callback, void *pUserData);
+	virtual void unsubscribeSignal(unsigned int subscriptionId);
+
+private:
+	bool registerNodeHierarchy(GDBusNodeInfo *pNode, const DBusObjectPath &basePath, int depth);
+
+	GDBusConnection *pConnection;
+	BusAcquiredCallback busAcquiredCallback;
+	guint ownedNameId;
+	NameCallback nameAcquiredCallback;
+	NameCallback nameLostCallback;
+	GDBusInterfaceVTable interfaceVtable;
+	std::vector<guint> registeredObjectIds;
+};
+
+}; // namespace ggk
@@ -29,7 +29,13 @@
 #include "../include/DBusObject.h"
 #include "../include/GattService.h"
 #include "../include/Utils.h"
+#include "../include/DBusBackend.h"
+#include "../include/HandlerProfiler.h"
 #include "../include/Logger.h"
+#include "HciAdapter.h"
+#include "OverloadController.h"
+#include "DataPrefetch.h"
+#include "ConditionalRead.h"
 
 namespace ggk {
 
@@ -42,7 +48,7 @@ namespace ggk {
 // Genreally speaking, these objects should not be constructed directly. Rather, use the `gattCharacteristicBegin()` method
 // in `GattService`.
 GattCharacteristic::GattCharacteristic(DBusObject &owner, GattService &service, const std::string &name)
-: GattInterface(owner, name), service(service), pOnUpdatedValueFunc(nullptr)
+: GattInterface(owner, name), service(service), pOnUpdatedValueFunc(nullptr), pOnComputeValueFunc(nullptr), hasLinkQualityPolicy(false), priority(ENotifyPriorityNormal), bAggregated(false), aggregateId(0), bConditionalReads(false), valueVersion(1)
 {
 }
 
@@ -55,8 +61,38 @@ GattService &GattCharacteristic::gattCharacteristicEnd()
 }
 
 // Locates a D-Bus method within this D-Bus interface and invokes the method
+//
+// Reads of a characteristic with conditional reads enabled are answered by ConditionalRead, which calls `callHandler()` for the
+// value.
 bool GattCharacteristic::callMethod(const std::string &methodName, GDBusConnection *pConnection, GVariant *pParameters, GDBusMethodInvocation *pInvocation, gpointer pUserData) const
 {
+	if (bConditionalReads && methodName == "ReadValue")
+	{
+		ConditionalRead::onReadValue(*this, pConnection, pParameters, pInvocation);
+		return true;
+	}
+
+	if (!callHandler(methodName, pConnection, pParameters, pInvocation, pUserData))
+	{
+		return false;
+	}
+
+	// A successful client write means our value has (probably) changed
+	if (methodName == "WriteValue" && !DBusBackend::lastReplyWasError(pInvocation))
+	{
+		markValueChanged();
+	}
+
+	return true;
+}
+
+// Invokes the handler registered for a D-Bus method directly, with this characteristic's data keys prefetched
+//
+// Returns false if there is no handler for `methodName`
+bool GattCharacteristic::callHandler(const std::string &methodName, GDBusConnection *pConnection, GVariant *pParameters, GDBusMethodInvocation *pInvocation, gpointer pUserData) const
+{
+	DataPrefetch prefetch(dataKeyNames);
+
 	for (const DBusMethod &method : methods)
 	{
 		if (methodName == method.getName())
@@ -79,14 +115,131 @@ GattCharacteristic &GattCharacteristic::onEvent(int tickFrequency, void *pUserDa
 	return *this;
 }
 
+// Declares a link quality policy for this characteristic and returns a reference to 'this' to enable method chaining in the
+// server description
+//
+// See `LinkQualityPolicy` for details.
+GattCharacteristic &GattCharacteristic::linkQualityPolicy(const LinkQualityPolicy &policy)
+{
+	hasLinkQualityPolicy = true;
+	linkPolicy = policy;
+	return *this;
+}
+
+// Returns the current link quality as judged by this characteristic's policy
+//
+// Characteristics without a policy always report `ELinkQualityGood`
+GattCharacteristic::LinkQuality GattCharacteristic::getLinkQuality() const
+{
+	int8_t rssi = 0;
+	if (!hasLinkQualityPolicy || !HciAdapter::getInstance().getWorstRssi(rssi))
+	{
+		return ELinkQualityGood;
+	}
+
+	if (rssi <= linkPolicy.poorRssi) { return ELinkQualityPoor; }
+	if (rssi <= linkPolicy.degradedRssi) { return ELinkQualityDegraded; }
+	return ELinkQualityGood;
+}
+
+// Returns the maximum notification payload size for the current link quality, or 0 if there is no limit
+//
+// Handlers should use this to send a smaller representation of their value, since larger values are not sent (see
+// `LinkQualityPolicy`.)
+size_t GattCharacteristic::getNotifyPayloadLimit() const
+{
+	switch(getLinkQuality())
+	{
+		case ELinkQualityPoor: return linkPolicy.poorMaxPayload;
+		case ELinkQualityDegraded: return linkPolicy.degradedMaxPayload;
+		default: return 0;
+	}
+}
+
+// Sets the priority of this characteristic's notifications and returns a reference to 'this' to enable method chaining in the
+// server description
+//
+// See `NotifyPriority` for details.
+GattCharacteristic &GattCharacteristic::notifyPriority(NotifyPriority priority)
+{
+	this->priority = priority;
+	return *this;
+}
+
+// Sends this characteristic's queued updates through its service's aggregation channel and returns a reference to 'this' to enable
+// method chaining in the server description
+//
+// `recordId` identifies this characteristic's records within the channel's notifications. See
+// `GattService::gattAggregationCharacteristicBegin()`.
+GattCharacteristic &GattCharacteristic::aggregate(uint8_t recordId)
+{
+	bAggregated = true;
+	aggregateId = recordId;
+	return *this;
+}
+
+// Declares the server data keys this characteristic's handlers read and returns a reference to 'this' to enable method chaining in
+// the server description
+//
+// The keys are fetched together (through the application's `GGKServerDataBatchGetter`, if it registered one) before each of this
+// characteristic's handlers runs, so `getDataValue()` and `getDataPointer()` don't call the data getter once per key. See
+// DataPrefetch.cpp.
+GattCharacteristic &GattCharacteristic::dataKeys(const std::vector<std::string> &keys)
+{
+	dataKeyNames = keys;
+	return *this;
+}
+
+// Lets clients skip re-reading a value they already have, and returns a reference to 'this' to enable method chaining in the server
+// description
+//
+// A descriptor is added through which a client opts in by telling us the version it last saw. Reads from that client are answered
+// with the value's version ahead of the value, or a one-byte "unchanged" reply if it is up to date. Other clients read the plain
+// value. See ConditionalRead.cpp for the protocol.
+GattCharacteristic &GattCharacteristic::conditionalReads()
+{
+	bConditionalReads = true;
+
+	gattDescriptorBegin("version", ConditionalRead::kVersionDescriptorUuid, {"read", "write"})
+		.onReadValue(ConditionalRead::onVersionRead)
+		.onWriteValue(ConditionalRead::onVersionWrite)
+	.gattDescriptorEnd();
+
+	return *this;
+}
+
+// Records that this characteristic's value has changed without a notification (see `getValueVersion()`)
+void GattCharacteristic::markValueChanged() const
+{
+	// Zero means "no version" to clients, so skip it if we ever wrap
+	if (0 == valueVersion.fetch_add(1) + 1)
+	{
+		valueVersion.fetch_add(1);
+	}
+}
+
 // Ticks events within this characteristic
 //
 // Note: we specifically override this method in order to translate the generic TickEvent::Callback into our own EventCallback
-void GattCharacteristic::tickEvents(GDBusConnection *pConnection, void *pUserData) const
+void GattCharacteristic::tickEvents(GDBusConnection *pConnection, void *pUserData, int ticks) const
 {
+	// Stretch our tick events on a poor link
+	int frequencyMultiplier = 1;
+	switch(getLinkQuality())
+	{
+		case ELinkQualityPoor: frequencyMultiplier = linkPolicy.poorTickMultiplier; break;
+		case ELinkQualityDegraded: frequencyMultiplier = linkPolicy.degradedTickMultiplier; break;
+		default: break;
+	}
+
+	if (frequencyMultiplier < 1) { frequencyMultiplier = 1; }
+
+	// Stretch them further if the server is overloaded
+	frequencyMultiplier *= OverloadController::getTickMultiplier();
+
 	for (const TickEvent &event : events)
 	{
-		event.tick<GattCharacteristic>(getPath(), pConnection, pUserData);
+		event.tick<GattCharacteristic>(getPath(), pConnection, pUserData, frequencyMultiplier, ticks);
 	}
 }
 
@@ -138,6 +291,89 @@ GattCharacteristic &GattCharacteristic::onUpdatedValue(UpdatedValueCallback call
 	return *this;
 }
 
+// Custom support for computing a characteristic's updated value off the main loop
+//
+// Defined as: (NOT defined by Bluetooth or BlueZ - this method is internal only)
+//
+// When set, this replaces `onUpdatedValue` for updates coming through the update queue (`ggkNofifyUpdatedCharacteristic()`.) The
+// callback is called on a worker thread, in parallel with the callbacks of other updated characteristics. It should fetch its data,
+// encode it and return the new value (for example, from `Utils::gvariantFromByteArray()`), or return nullptr to skip the
+// notification. The server then sends all of the computed values as change notifications from the main loop.
+//
+// Because it runs on a worker thread, the callback must not send notifications or make D-Bus calls itself, and the data getter it
+// uses must be thread-safe.
+GattCharacteristic &GattCharacteristic::onComputeValue(ComputeValueCallback callback)
+{
+	pOnComputeValueFunc = callback;
+	return *this;
+}
+
+// Calls the onComputeValue method, if one was set
+//
+// Returns the computed value with a reference owned by the caller, or nullptr if there was no method or no value
+GVariant *GattCharacteristic::callOnComputeValue(void *pUserData) const
+{
+	if (nullptr == pOnComputeValueFunc)
+	{
+		return nullptr;
+	}
+
+	DataPrefetch prefetch(dataKeyNames);
+	GVariant *pValue = pOnComputeValueFunc(*this, pUserData);
+	return nullptr == pValue ? nullptr : g_variant_ref_sink(pValue);
+}
+
+// Reads this characteristic's current value through its own `onReadValue` method (or its `onComputeValue` method, if it has no
+// `onReadValue`) without going through D-Bus
+//
+// The `onReadValue` method is called with a local invocation (see DBusBackend.cpp), so its reply is captured here rather than sent
+// to a client.
+//
+// Returns the byte array value with a reference owned by the caller, or nullptr if no value was returned. If `pReadable` is not
+// null, it is set to false if the characteristic has neither method.
+GVariant *GattCharacteristic::readValueLocally(GDBusConnection *pConnection, bool *pReadable) const
+{
+	GVariant *pOptions = g_variant_new_array(G_VARIANT_TYPE("{sv}"), nullptr, 0);
+	GVariant *pParameters = g_variant_ref_sink(g_variant_new_tuple(&pOptions, 1));
+
+	GDBusMethodInvocation *pInvocation = DBusBackend::beginLocalInvocation();
+	bool called = callHandler("ReadValue", pConnection, pParameters, pInvocation, nullptr);
+	if (!called)
+	{
+		// Nobody will ever reply to this one, so we do it ourselves to release the handle
+		DBusBackend::getInstance().methodReturnError(pInvocation, "org.bluez.Error.NotSupported", "No ReadValue method");
+	}
+
+	GVariant *pValue = DBusBackend::endLocalInvocation(pInvocation);
+	g_variant_unref(pParameters);
+
+	if (!called)
+	{
+		pValue = callOnComputeValue(nullptr);
+	}
+
+	if (nullptr != pReadable)
+	{
+		*pReadable = called || hasComputeValue();
+	}
+
+	// Unwrap a value that was returned in a tuple
+	if (nullptr != pValue && g_variant_is_of_type(pValue, G_VARIANT_TYPE_TUPLE) && 1 == g_variant_n_children(pValue))
+	{
+		GVariant *pChild = g_variant_get_child_value(pValue, 0);
+		g_variant_unref(pValue);
+		pValue = pChild;
+	}
+
+	if (nullptr != pValue && !g_variant_is_of_type(pValue, G_VARIANT_TYPE_BYTESTRING))
+	{
+		g_variant_unref(pValue);
+		pValue = nullptr;
+	}
+
+	return pValue;
+}
+
 // Calls the onUpdatedValue method, if one was set.
 //
 // Returns false if there was no method set, otherwise, returns the boolean result of the method call.
@@ -162,7 +398,11 @@ bool GattCharacteristic::callOnUpdatedValue(GDBusConnection *pConnection, void *
 		return false;
 	}
 
-	Logger::debug(SSTR << "Calling OnUpdatedValue function for interface at path '" << getPath() << "'");
+	// The profiler keeps the path's pointer until the handler returns, so the path must outlive it
+	const DBusObjectPath path = getPath();
+	Logger::debug(SSTR << "Calling OnUpdatedValue function for interface at path '" << path << "'");
+	HandlerProfiler::Scope profile(HandlerProfiler::EUpdatedValue, path.c_str(), nullptr);
+	DataPrefetch prefetch(dataKeyNames);
 	return pOnUpdatedValueFunc(*this, pConnection, pUserData);
 }
 
@@ -204,6 +444,38 @@ GattDescriptor &GattCharacteristic::gattDescriptorBegin(const std::string &pathE
 // active connections before sending a change notification.
 void GattCharacteristic::sendChangeNotificationVariant(GDBusConnection *pBusConnection, GVariant *pNewValue) const
 {
+	markValueChanged();
+
+	// Shed low priority notifications when the server is overloaded
+	if (OverloadController::shouldDropNotification(priority == ENotifyPriorityLow))
+	{
+		g_variant_unref(g_variant_ref_sink(pNewValue));
+		return;
+	}
+
+	// Apply our link quality policy's payload limit to byte array values
+	//
+	// Unless the policy says a prefix of the value is still meaningful, a value that's too large is skipped rather than cut short
+	size_t payloadLimit = getNotifyPayloadLimit();
+	if (payloadLimit > 0 && g_variant_is_of_type(pNewValue, G_VARIANT_TYPE_BYTESTRING))
+	{
+		gsize size = 0;
+		const guint8 *pBytes = static_cast<const guint8 *>(g_variant_get_fixed_array(pNewValue, &size, 1));
+		if (size > payloadLimit && !linkPolicy.truncateOversize)
+		{
+			Logger::debug(SSTR << "Skipping a " << size << "-byte notification from '" << getPath() << "' (the link allows " << payloadLimit << " bytes)");
+			g_variant_unref(g_variant_ref_sink(pNewValue));
+			return;
+		}
+
+		if (size > payloadLimit)
+		{
+			GVariant *pTruncated = g_variant_new_fixed_array(G_VARIANT_TYPE_BYTE, pBytes, payloadLimit, 1);
+			g_variant_unref(g_variant_ref_sink(pNewValue));
+			pNewValue = pTruncated;
+		}
+	}
+
 	g_auto(GVariantBuilder) builder;
 	g_variant_builder_init(&builder, G_VARIANT_TYPE_ARRAY);
 	g_variant_builder_add(&builder, "{sv}", "Value", pNewValue);
@@ -26,6 +26,8 @@
 #include "../include/GattProperty.h"
 #include "../include/DBusObject.h"
 #include "../include/Utils.h"
+#include "../include/HandlerProfiler.h"
+#include "OverloadController.h"
 #include "../include/Logger.h"
 
 namespace ggk {
@@ -83,11 +85,11 @@ GattDescriptor &GattDescriptor::onEvent(int tickFrequency, void *pUserData, Even
 // Ticks events within this descriptor
 //
 // Note: we specifically override this method in order to translate the generic TickEvent::Callback into our own EventCallback
-void GattDescriptor::tickEvents(GDBusConnection *pConnection, void *pUserData) const
+void GattDescriptor::tickEvents(GDBusConnection *pConnection, void *pUserData, int ticks) const
 {
 	for (const TickEvent &event : events)
 	{
-		event.tick<GattDescriptor>(getPath(), pConnection, pUserData);
+		event.tick<GattDescriptor>(getPath(), pConnection, pUserData, OverloadController::getTickMultiplier(), ticks);
 	}
 }
 
@@ -163,7 +165,10 @@ bool GattDescriptor::callOnUpdatedValue(GDBusConnection *pConnection, void *pUse
 		return false;
 	}
 
-	Logger::debug(SSTR << "Calling OnUpdatedValue function for interface at path '" << getPath() << "'");
+	// The profiler keeps the path's pointer until the handler returns, so the path must outlive it
+	const DBusObjectPath path = getPath();
+	Logger::debug(SSTR << "Calling OnUpdatedValue function for interface at path '" << path << "'");
+	HandlerProfiler::Scope profile(HandlerProfiler::EUpdatedValue, path.c_str(), nullptr);
 	return pOnUpdatedValueFunc(*this, pConnection, pUserData);
 }
 
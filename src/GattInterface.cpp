@@ -24,6 +24,9 @@
 #include "../include/GattInterface.h"
 #include "../include/GattProperty.h"
 #include "../include/DBusObject.h"
+#include "../include/DBusBackend.h"
+#include "PropertyChanges.h"
+#include "DataPrefetch.h"
 #include "../include/Logger.h"
 
 namespace ggk {
@@ -50,6 +53,36 @@ const std::list<GattProperty> &GattInterface::getProperties() const
 	return properties;
 }
 
+// Return a raw data pointer from the server's registered data getter (GGKServerDataGetter), or from the values prefetched for the
+// current handler (see `GattCharacteristic::dataKeys()`)
+//
+// In general, use `getDataValue()` or `getDataPointer()` instead.
+const void *GattInterface::getData(const char *pName) const
+{
+	return DataPrefetch::get(pName);
+}
+
+// Fetches several data pointers at once, through the application's batch data getter (GGKServerDataBatchGetter) if it registered
+// one
+//
+// `ppValues[i]` receives the value for `ppNames[i]`, or nullptr if there is none. Returns the number of values found.
+int GattInterface::getDataPointers(const char *const *ppNames, const void **ppValues, int count) const
+{
+	return DataPrefetch::getMany(ppNames, ppValues, count);
+}
+
+// Sends a raw data pointer to the server's registered data setter (GGKServerDataSetter), forgetting any value prefetched for
+// `pName` so that later reads see the change
+//
+// In general, use `setDataValue()` or `setDataPointer()` instead.
+bool GattInterface::setData(const char *pName, const void *pData) const
+{
+	// We may be on a worker thread (see `onComputeValue()`), so we can't read `TheServer` directly
+	bool result = std::atomic_load(&TheServer)->getDataSetter()(pName, pData) != 0;
+	DataPrefetch::forget(pName);
+	return result;
+}
+
 // When responding to a method, we need to return a GVariant value wrapped in a tuple. This method will simplify this slightly by
 // wrapping a GVariant of the type "ay" and wrapping it in a tuple before sending it off as the method response.
 //
@@ -61,7 +94,7 @@ void GattInterface::methodReturnVariant(GDBusMethodInvocation *pInvocation, GVar
 	{
 		pVariant = g_variant_new_tuple(&pVariant, 1);
 	}
-	g_dbus_method_invocation_return_value(pInvocation, pVariant);
+	DBusBackend::getInstance().methodReturnValue(pInvocation, pVariant);
 }
 
 // Locates a `GattProperty` within the interface
@@ -80,6 +113,34 @@ const GattProperty *GattInterface::findProperty(const std::string &name) const
 	return nullptr;
 }
 
+GattProperty *GattInterface::findProperty(const std::string &name)
+{
+	return const_cast<GattProperty *>(static_cast<const GattInterface *>(this)->findProperty(name));
+}
+
+// Changes the value of one of this interface's properties while the server is running
+//
+// The change is applied on the main loop at the start of the next idle pass, along with any other changes made since the last one,
+// and announced to BlueZ with a single `PropertiesChanged` signal for this interface. Until then, the property keeps its previous
+// value. This method may be called from any thread.
+//
+// A floating `pValue` is sunk; otherwise the property takes its own reference to it. Returns false (and releases a floating
+// `pValue`) if this interface has no property called `name`.
+//
+// This is the generalized form that accepts a GVariant *. There are helper methods (`updateProperty()`) for common types.
+bool GattInterface::updatePropertyVariant(const std::string &name, GVariant *pValue) const
+{
+	if (nullptr == findProperty(name))
+	{
+		Logger::warn(SSTR << "Unable to update unknown property '" << name << "' on '" << getName() << "' at path '" << getPath() << "'");
+		g_variant_unref(g_variant_ref_sink(pValue));
+		return false;
+	}
+
+	PropertyChanges::queue(getPath(), getName(), name, pValue);
+	return true;
+}
+
 // Internal method used to generate introspection XML used to describe our services on D-Bus
 std::string GattInterface::generateIntrospectionXML(int depth) const
 {
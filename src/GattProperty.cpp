@@ -26,6 +26,7 @@
 
 #include "../include/Utils.h"
 #include "../include/GattProperty.h"
+#include "InternTable.h"
 
 namespace ggk {
 
@@ -33,9 +34,38 @@ namespace ggk {
 //
 // In general, properties should not be constructed directly as properties are typically instanticated by adding them to to an
 // interface using one of the the interface's `addProperty` methods.
+//
+// A floating `pValue` is sunk; otherwise the property takes its own reference to it.
 GattProperty::GattProperty(const std::string &name, GVariant *pValue, GDBusInterfaceGetPropertyFunc getter, GDBusInterfaceSetPropertyFunc setter)
-: name(name), pValue(pValue), getterFunc(getter), setterFunc(setter)
+: name(InternTable::intern(name)), pValue(nullptr == pValue ? nullptr : g_variant_ref_sink(InternTable::intern(pValue))), getterFunc(getter), setterFunc(setter)
+{
+}
+
+// Copies share a reference to the same value
+GattProperty::GattProperty(const GattProperty &other)
+: name(other.name), pValue(nullptr == other.pValue ? nullptr : g_variant_ref(other.pValue)), getterFunc(other.getterFunc), setterFunc(other.setterFunc)
+{
+}
+
+GattProperty &GattProperty::operator =(const GattProperty &other)
+{
+	if (this != &other)
+	{
+		name = other.name;
+		setValue(other.pValue);
+		getterFunc = other.getterFunc;
+		setterFunc = other.setterFunc;
+	}
+
+	return *this;
+}
+
+GattProperty::~GattProperty()
 {
+	if (nullptr != pValue)
+	{
+		g_variant_unref(pValue);
+	}
 }
 
 //
@@ -45,7 +75,7 @@ GattProperty::GattProperty(const std::string &name, GVariant *pValue, GDBusInter
 // Returns the name of the property
 const std::string &GattProperty::getName() const
 {
-	return name;
+	return *name;
 }
 
 // Sets the name of the property
@@ -54,7 +84,7 @@ const std::string &GattProperty::getName() const
 // interface's `addProperty` methods.
 GattProperty &GattProperty::setName(const std::string &name)
 {
-	this->name = name;
+	this->name = InternTable::intern(name);
 	return *this;
 }
 
@@ -68,12 +98,26 @@ const GVariant *GattProperty::getValue() const
 	return pValue;
 }
 
-// Sets the property's value
+// Sets the property's value and releases the previous one
+//
+// A floating `pValue` is sunk; otherwise the property takes its own reference to it.
 //
 // In general, this method should not be called directly as properties are typically added to an interface using one of the the
-// interface's `addProperty` methods.
+// interface's `addProperty` methods. To change a property's value while the server is running, use
+// `GattInterface::updatePropertyVariant()`, which also tells D-Bus about the change.
 GattProperty &GattProperty::setValue(GVariant *pValue)
 {
+	// Take the new reference before dropping the old one, in case they are the same value
+	if (nullptr != pValue)
+	{
+		g_variant_ref_sink(pValue);
+	}
+
+	if (nullptr != this->pValue)
+	{
+		g_variant_unref(this->pValue);
+	}
+
 	this->pValue = pValue;
 	return *this;
 }
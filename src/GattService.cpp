@@ -31,6 +31,8 @@
 #include "../include/GattInterface.h"
 #include "../include/DBusObject.h"
 #include "../include/GattCharacteristic.h"
+#include "AggregationChannel.h"
+#include "BatchRead.h"
 
 namespace ggk {
 
@@ -84,4 +86,34 @@ GattCharacteristic &GattService::gattCharacteristicBegin(const std::string &path
 	return characteristic;
 }
 
-}; // namespace ggk
\ No newline at end of file
+// Convenience function to add a batch read characteristic to the hierarchy
+//
+// A client writes a list of characteristic UUIDs to this characteristic, then reads back the current values of all of them in a
+// single frame. The values come from each characteristic's own `onReadValue` method. See the discussion at the top of
+// BatchRead.cpp for the request and frame formats.
+//
+// To end the characteristic, call `gattCharacteristicEnd()`
+GattCharacteristic &GattService::gattBatchReadCharacteristicBegin(const std::string &pathElement, const GattUuid &uuid)
+{
+	return gattCharacteristicBegin(pathElement, uuid, {"read", "write"})
+		.onReadValue(BatchRead::onReadValue)
+		.onWriteValue(BatchRead::onWriteValue);
+}
+
+// Convenience function to add an aggregation channel characteristic to the hierarchy
+//
+// Characteristics in this service that call `aggregate()` have their queued updates packed together into this characteristic's
+// notifications rather than sending their own. `maxFrameSize` is the largest notification the channel sends and should be the
+// clients' ATT MTU minus 3. See the discussion at the top of AggregationChannel.cpp for the frame format.
+//
+// To end the characteristic, call `gattCharacteristicEnd()`
+GattCharacteristic &GattService::gattAggregationCharacteristicBegin(const std::string &pathElement, const GattUuid &uuid, size_t maxFrameSize)
+{
+	GattCharacteristic &characteristic = gattCharacteristicBegin(pathElement, uuid, {"read", "notify"})
+		.onReadValue(AggregationChannel::onReadValue);
+
+	AggregationChannel::registerChannel(getPath(), characteristic.getPath(), maxFrameSize);
+	return characteristic;
+}
+
+}; // namespace ggk
@@ -30,6 +30,7 @@
 //
 //     Log registration - used to register methods that accept all Gobbledegook logs
 //     Update queue management - used for notifying the server that data has been updated
+//     Snapshot groups - used for publishing related values that must be read together
 //     Server state - used to track the server's current running state and health
 //     Server control - running and stopping the server
 // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
@@ -37,13 +38,22 @@
 #include <string.h>
 #include <string>
 #include <thread>
+#include <chrono>
 #include <memory>
 #include <deque>
+#include <unordered_set>
 #include <mutex>
+#include <algorithm>
 
 #include "Init.h"
+#include "HciAdapter.h"
 #include "../include/Logger.h"
 #include "../include/Server.h"
+#include "../include/SnapshotGroup.h"
+#include "../include/HandlerProfiler.h"
+#include "OverloadController.h"
+#include "BatchController.h"
+#include "../include/Clock.h"
 
 namespace ggk
 {
@@ -69,6 +79,9 @@ namespace ggk
 	std::deque<QueueEntry> updateQueue;
 	std::mutex updateQueueMutex;
 
+	// The entries in the update queue, as "path|interface" (so we can find a queued entry without searching the queue)
+	std::unordered_multiset<std::string> queuedUpdates;
+
 	// Internal method to set the run state of the server
 	void setServerRunState(GGKServerRunState newState)
 	{
@@ -140,9 +153,20 @@ int ggkNofifyUpdatedDescriptor(const char *pObjectPath)
 int ggkPushUpdateQueue(const char *pObjectPath, const char *pInterfaceName)
 {
 	QueueEntry t(pObjectPath, pInterfaceName);
+	std::string key = std::get<0>(t) + "|" + std::get<1>(t);
 
 	std::lock_guard<std::mutex> guard(updateQueueMutex);
+
+	// When the server is overloaded, an update that is already waiting in the queue covers this one
+	if (OverloadController::shouldCoalesceUpdates() && queuedUpdates.find(key) != queuedUpdates.end())
+	{
+		OverloadController::countCoalescedUpdate();
+		return 1;
+	}
+
 	updateQueue.push_front(t);
+	queuedUpdates.insert(key);
+	BatchController::countArrival();
 	return 1;
 }
 
@@ -181,6 +205,7 @@ int ggkPopUpdateQueue(char *pElementBuffer, int elementLen, int keep)
 		if (keep == 0)
 		{
 			updateQueue.pop_back();
+			queuedUpdates.erase(queuedUpdates.find(result));
 		}
 	}
 
@@ -209,6 +234,194 @@ void ggkUpdateQueueClear()
 {
 	std::lock_guard<std::mutex> guard(updateQueueMutex);
 	updateQueue.clear();
+	queuedUpdates.clear();
+}
+
+// ---------------------------------------------------------------------------------------------------------------------------------
+//  ____                        _           _         _       _
+// / ___| _ __   __ _ _ __  ___| |__   ___ | |_     __| | __ _| |_ __ _
+// \___ \| '_ \ / _` | '_ \/ __| '_ \ / _ \| __|   / _` |/ _` | __/ _` |
+//  ___) | | | | (_| | |_) \__ \ | | | (_) | |_   | (_| | (_| | || (_| |
+// |____/|_| |_|\__,_| .__/|___/_| |_|\___/ \__|   \__,_|\__,_|\__\__,_|
+//                   |_|
+//
+// Publish/read related values as a single consistent block. Readers never block on producers. See SnapshotGroup.cpp.
+// ---------------------------------------------------------------------------------------------------------------------------------
+
+// Creates a snapshot group of `size` bytes. All bytes are initially zero.
+//
+// Creating a group that already exists with the same size succeeds and has no effect.
+//
+// Returns non-zero value on success or 0 on failure.
+int ggkSnapshotGroupCreate(const char *pGroupName, int size)
+{
+	if (nullptr == pGroupName || size <= 0) { return 0; }
+	return nullptr != SnapshotGroup::create(pGroupName, static_cast<size_t>(size)) ? 1 : 0;
+}
+
+// Publishes all members of a snapshot group at once. `size` must match the size the group was created with.
+//
+// Returns non-zero value on success or 0 on failure.
+int ggkSnapshotGroupPublish(const char *pGroupName, const void *pData, int size)
+{
+	if (nullptr == pGroupName || size <= 0) { return 0; }
+
+	SnapshotGroup *pGroup = SnapshotGroup::find(pGroupName);
+	return nullptr != pGroup && pGroup->publish(pData, static_cast<size_t>(size)) ? 1 : 0;
+}
+
+// Copies a consistent snapshot of a group into `pData`. `size` must match the size the group was created with.
+//
+// If `pVersion` is not null, it receives the number of times the group has been published as of the copied snapshot (0 if it has
+// never been published.)
+//
+// Returns non-zero value on success or 0 on failure.
+int ggkSnapshotGroupRead(const char *pGroupName, void *pData, int size, unsigned long long *pVersion)
+{
+	if (nullptr == pGroupName || size <= 0) { return 0; }
+
+	SnapshotGroup *pGroup = SnapshotGroup::find(pGroupName);
+	uint64_t version = 0;
+	if (nullptr == pGroup || !pGroup->read(pData, static_cast<size_t>(size), &version)) { return 0; }
+
+	if (nullptr != pVersion) { *pVersion = version; }
+	return 1;
+}
+
+// Registers a callback to receive connection events. Registering a new callback replaces the previous one and registering
+// `nullptr` removes it. This may be called at any time.
+//
+// See the connection events section in Init.cpp for delivery details.
+void ggkRegisterConnectionCallback(GGKConnectionCallback callback, void *pUserData)
+{
+	setConnectionCallback(callback, pUserData);
+}
+
+// Copies the connected devices into `pInfo`, up to `maxCount` of them. This may be called from any thread.
+//
+// Returns the number of connected devices, which may be more than `maxCount`. Pass a `maxCount` of 0 to just count them.
+int ggkGetConnectionInfo(struct GGKConnectionInfo *pInfo, int maxCount)
+{
+	std::vector<HciAdapter::ConnectedDevice> devices = HciAdapter::getInstance().getConnectedDevices();
+
+	int count = nullptr == pInfo ? 0 : std::min(maxCount, static_cast<int>(devices.size()));
+	for (int i = 0; i < count; ++i)
+	{
+		const HciAdapter::ConnectedDevice &device = devices[i];
+		snprintf(pInfo[i].address, sizeof(pInfo[i].address), "%s", device.getAddressString().c_str());
+		pInfo[i].addressType = device.addressType;
+		pInfo[i].rssi = device.rssi;
+		pInfo[i].txPower = device.txPower;
+		pInfo[i].maxTxPower = device.maxTxPower;
+	}
+
+	return static_cast<int>(devices.size());
+}
+
+// Registers a batch data getter. Registering `nullptr` removes it, so each value is fetched with its own `GGKServerDataGetter`
+// call. This may be called at any time.
+void ggkRegisterDataBatchGetter(GGKServerDataBatchGetter getter)
+{
+	Server::setDataBatchGetter(getter);
+}
+
+// ---------------------------------------------------------------------------------------------------------------------------------
+//  ____             __ _ _ _
+// |  _ \ _ __ ___  / _(_) (_)_ __   __ _
+// | |_) | '__/ _ \| |_| | | | '_ \ / _` |
+// |  __/| | | (_) |  _| | | | | | | (_| |
+// |_|   |_|  \___/|_| |_|_|_|_| |_|\__, |
+//                                  |___/
+//
+// Measure the cost of the application's handlers. See HandlerProfiler.cpp.
+// ---------------------------------------------------------------------------------------------------------------------------------
+
+// Enables (non-zero) or disables (0) handler profiling
+//
+// Profiling is disabled by default. Disabling it keeps the samples collected so far.
+void ggkProfilingEnable(int enable)
+{
+	HandlerProfiler::setEnabled(enable != 0);
+}
+
+// Discards all profiling samples collected so far
+void ggkProfilingReset()
+{
+	HandlerProfiler::reset();
+}
+
+// Logs (at the status level) the `topN` most expensive handlers, ranked by total wall time and by 99th percentile wall time
+void ggkProfilingDump(int topN)
+{
+	std::string report = HandlerProfiler::report(topN > 0 ? topN : 10);
+
+	size_t start = 0;
+	while (start < report.length())
+	{
+		size_t end = report.find('\n', start);
+		if (end == std::string::npos) { end = report.length(); }
+
+		Logger::status(report.substr(start, end - start));
+		start = end + 1;
+	}
+}
+
+// ---------------------------------------------------------------------------------------------------------------------------------
+// __     ___      _               _   _   _
+// \ \   / (_)_ __| |_ _   _  __ _| | | |_(_)_ __ ___   ___
+//  \ \ / /| | '__| __| | | |/ _` | | | __| | '_ ` _ \ / _ )
+//   \ V / | | |  | |_| |_| | (_| | | | |_| | | | | | |  __/
+//    \_/  |_|_|   \__|\__,_|\__,_|_|  \__|_|_| |_| |_|\___|
+//
+// Run the server's timers on a virtual clock for simulations and soak tests. See Clock.cpp.
+// ---------------------------------------------------------------------------------------------------------------------------------
+
+// The virtual clock, if we're using one
+static std::shared_ptr<VirtualClock> pVirtualClock;
+
+// Switches the server to a virtual clock. The virtual wall clock starts at `startWallTime` (seconds since the epoch, as from
+// `time()`), or at the current time if `startWallTime` is 0.
+//
+// Returns non-zero value on success or 0 if the server is running.
+int ggkUseVirtualClock(long long startWallTime)
+{
+	std::shared_ptr<VirtualClock> pClock = std::make_shared<VirtualClock>(0 != startWallTime ? static_cast<time_t>(startWallTime) : time(nullptr));
+	if (!Clock::setInstance(pClock))
+	{
+		return 0;
+	}
+
+	pVirtualClock = pClock;
+	return 1;
+}
+
+// Switches the server back to real time
+//
+// Returns non-zero value on success or 0 if the server is running.
+int ggkUseSystemClock()
+{
+	if (!Clock::setInstance(nullptr))
+	{
+		return 0;
+	}
+
+	pVirtualClock = nullptr;
+	return 1;
+}
+
+// Moves the virtual clock forward by `milliseconds`. Timers that come due fire on the server's thread, once for each of their
+// periods that has elapsed.
+//
+// Returns non-zero value on success or 0 if the server is not using a virtual clock.
+int ggkAdvanceVirtualClock(unsigned long long milliseconds)
+{
+	if (nullptr == pVirtualClock)
+	{
+		return 0;
+	}
+
+	pVirtualClock->advanceMS(milliseconds);
+	return 1;
 }
 
 // ---------------------------------------------------------------------------------------------------------------------------------
@@ -279,6 +492,84 @@ const char *ggkGetServerHealthString(GGKServerHealth state)
 	}
 }
 
+// ---------------------------------------------------------------------------------------------------------------------------------
+//  ____                             _                 _
+// / ___|  ___ _ ____   _____ _ __  | | ___   __ _  __| |
+// \___ \ / _ \ '__\ \ / / _ \ '__| | |/ _ \ / _` |/ _` |
+//  ___) |  __/ |   \ V /  __/ |    | | (_) | (_| | (_| |
+// |____/ \___|_|    \_/ \___|_|    |_|\___/ \__,_|\__,_|
+//
+// Methods for reporting how much work the server is shedding under load and how it batches notifications. See
+// OverloadController.cpp and BatchController.cpp.
+// ---------------------------------------------------------------------------------------------------------------------------------
+
+// Retrieve the current load shedding level
+GGKOverloadLevel ggkGetOverloadLevel()
+{
+	return OverloadController::getLevel();
+}
+
+// Convert a `GGKOverloadLevel` into a human-readable string
+const char *ggkGetOverloadLevelString(GGKOverloadLevel level)
+{
+	switch(level)
+	{
+		case EOverloadNormal: return "Normal";
+		case EOverloadStretchTicks: return "Stretching ticks";
+		case EOverloadCoalesce: return "Coalescing updates";
+		case EOverloadDropLowPriority: return "Dropping low priority notifications";
+		case EOverloadRejectReads: return "Rejecting reads";
+		default: return "Unknown";
+	}
+}
+
+// Copies the current load shedding statistics into `pStats`
+void ggkGetOverloadStats(GGKOverloadStats *pStats)
+{
+	if (nullptr == pStats) { return; }
+	OverloadController::getStats(*pStats);
+}
+
+// Sets the bounds within which the flush delay and batch size are tuned
+//
+// The defaults are a flush delay of 0ms (send immediately) and a batch size of up to 64 updates. This may be called at any time.
+//
+// Returns non-zero value on success or 0 if the bounds are invalid (negative delays, a minimum above the maximum or a batch size
+// below 1.)
+int ggkSetBatchingBounds(int minFlushDelayMS, int maxFlushDelayMS, int maxBatchSize)
+{
+	return BatchController::setBounds(minFlushDelayMS, maxFlushDelayMS, maxBatchSize) ? 1 : 0;
+}
+
+// Copies the current notification batching decisions and statistics into `pStats`
+void ggkGetBatchingStats(GGKBatchingStats *pStats)
+{
+	if (nullptr == pStats) { return; }
+	BatchController::getStats(*pStats);
+}
+
+// Copies the periodic timer's measurements into `pStats`
+//
+// Returns a non-zero value on success or 0 if the timer isn't running (before the server has started or after it has stopped)
+int ggkGetTimerStats(GGKTimerStats *pStats)
+{
+	PeriodicTimerStats stats;
+	if (nullptr == pStats || !getPeriodicTimerStats(stats))
+	{
+		return 0;
+	}
+
+	pStats->intervalUS = stats.intervalUS;
+	pStats->calls = stats.calls;
+	pStats->missedDeadlines = stats.missedDeadlines;
+	pStats->minLatenessUS = stats.minLatenessUS;
+	pStats->maxLatenessUS = stats.maxLatenessUS;
+	pStats->meanLatenessUS = stats.meanLatenessUS;
+	pStats->jitterUS = stats.jitterUS;
+	pStats->driftUS = stats.driftUS;
+	return 1;
+}
+
 // ---------------------------------------------------------------------------------------------------------------------------------
 //  ____  _                 _   _
 // / ___|| |_ ___  _ __    | |_| |__   ___    ___  ___ _ ____   _____ _ __
@@ -326,6 +617,75 @@ int ggkShutdownAndWait()
 //
 // ---------------------------------------------------------------------------------------------------------------------------------
 
+// Performs a warm restart of a running server, rebuilding the server description with `configurator`
+//
+// Unlike stopping and starting the server, the D-Bus connection, the owned name and the adapter configuration are all kept. Only the
+// GATT object tree is rebuilt, swapped in and re-registered with BlueZ, which typically takes milliseconds rather than seconds.
+// Connected clients will see the services change.
+//
+// If `configurator` is null, the configurator from `ggkStart()` (or the previous restart) is used again. The service name,
+// advertising names and data getter/setter are unchanged.
+//
+// This method blocks for up to maxAsyncRestartTimeoutMS milliseconds until the restart completes. It must not be called from the
+// server's thread (such as from within a lambda in the server description.)
+//
+// Returns non-zero value on success or 0 on failure (including a timeout, in which case the restart may still complete later.)
+int ggkRestart(GGKServerConfigurator configurator, int maxAsyncRestartTimeoutMS)
+{
+	if (!ggkIsServerRunning())
+	{
+		Logger::warn("Ignoring call to ggkRestart() (the server is not running)");
+		return 0;
+	}
+
+	if (std::this_thread::get_id() == serverThread.get_id())
+	{
+		Logger::error("ggkRestart() cannot be called from the server thread");
+		return 0;
+	}
+
+	try
+	{
+		// Build the new server description here, off the server thread
+		std::shared_ptr<Server> pCurrent = std::atomic_load(&TheServer);
+		if (nullptr == configurator)
+		{
+			configurator = pCurrent->getConfigurator();
+		}
+
+		std::shared_ptr<Server> pNewServer = std::make_shared<Server>(pCurrent->getServiceName(), pCurrent->getAdvertisingName(),
+			pCurrent->getAdvertisingShortName(), configurator, pCurrent->getDataGetter(), pCurrent->getDataSetter());
+
+		if (!requestRestart(pNewServer))
+		{
+			return 0;
+		}
+
+		// Wait for the server to swap and re-register
+		//
+		// This waits in real time even under a virtual clock: the application's thread is blocked here, so it can't advance the
+		// virtual clock that the server's retries wait on.
+		auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(maxAsyncRestartTimeoutMS);
+		while (std::chrono::steady_clock::now() < deadline && isRestartPending())
+		{
+			std::this_thread::sleep_for(std::chrono::milliseconds(kMaxAsyncInitCheckIntervalMS));
+		}
+
+		if (isRestartPending())
+		{
+			Logger::warn("GGK server warm restart timed out");
+			return 0;
+		}
+
+		return ggkIsServerRunning();
+	}
+	catch(...)
+	{
+		Logger::error(SSTR << "Unknown exception during ggkRestart()");
+		return 0;
+	}
+}
+
 // Blocks for up to maxAsyncInitTimeoutMS milliseconds until the server shuts down.
 //
 // If shutdown is successful, this method will return a non-zero value. Otherwise, it will return 0.
@@ -484,7 +844,7 @@ int ggkStart(const char *pServiceName, const char *pAdvertisingName, const char
 		Logger::info(SSTR << "Starting GGK server '" << pAdvertisingName << "'");
 
 		// Allocate our server
-		TheServer = std::make_shared<Server>(pServiceName, pAdvertisingName, pAdvertisingShortName, configurator, getter, setter);
+		std::atomic_store(&TheServer, std::make_shared<Server>(pServiceName, pAdvertisingName, pAdvertisingShortName, configurator, getter, setter));
 
 		// Start our server thread
 		try
@@ -500,15 +860,16 @@ int ggkStart(const char *pServiceName, const char *pAdvertisingName, const char
 		}
 
 		// Waits for the server to pass the EInitializing state
-		int retryTimeMS = 0;
-		while (retryTimeMS < maxAsyncInitTimeoutMS && ggkGetServerRunState() <= EInitializing)
+		//
+		// This waits in real time even under a virtual clock (see `ggkRestart()`)
+		auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(maxAsyncInitTimeoutMS);
+		while (std::chrono::steady_clock::now() < deadline && ggkGetServerRunState() <= EInitializing)
 		{
 			std::this_thread::sleep_for(std::chrono::milliseconds(kMaxAsyncInitCheckIntervalMS));
-			retryTimeMS += kMaxAsyncInitCheckIntervalMS;
 		}
 
 		// If something went wrong, shut down
-		if (retryTimeMS >= maxAsyncInitTimeoutMS)
+		if (ggkGetServerRunState() <= EInitializing)
 		{
 			Logger::error("GGK server initialization timed out");
 
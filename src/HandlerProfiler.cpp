@@ -0,0 +1,332 @@
+// Copyright 2017-2019 Paul Nettle
+//
+// This file is part of Gobbledegook.
+//
+// Use of this source code is governed by a BSD-style license that can be found
+// in the LICENSE file in the root of the source tree.
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//
+// >>
+// >>>  INSIDE THIS FILE
+// >>
+//
+// An opt-in profiler that measures the cost of each handler called from the server's main loop
+//
+// >>
+// >>>  DISCUSSION
+// >>
+//
+// When the main loop is busy, it's not obvious which of the application's lambdas is responsible. With profiling enabled, each
+// call to a D-Bus method, tick event, `onUpdatedValue` callback and property getter/setter is measured for both wall time and the
+// calling thread's CPU time (`CLOCK_THREAD_CPUTIME_ID`.) A handler with high wall time but low CPU time is waiting on something;
+// one with high CPU time is doing too much work.
+//
+// Samples are aggregated per handler, where a handler is identified by its kind, object path and name (method or property name.)
+// The aggregates live in a fixed-size open-addressed table so that profiling never allocates after a handler's first call. Each
+// handler keeps a total, a maximum and a log-scale histogram of each measurement, from which the 99th percentile is estimated.
+// The estimate is the upper bound of the histogram bucket holding the 99th percentile, which is within 50% of the true value.
+//
+// Profiling is disabled by default. Enable it with `ggkProfilingEnable()` and dump a report with `ggkProfilingDump()`.
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+#include <string.h>
+#include <time.h>
+#include <algorithm>
+#include <iomanip>
+#include <mutex>
+#include <sstream>
+#include <vector>
+
+#include "../include/HandlerProfiler.h"
+#include "../include/Logger.h"
+
+namespace ggk {
+
+// ---------------------------------------------------------------------------------------------------------------------------------
+// Sample storage
+// ---------------------------------------------------------------------------------------------------------------------------------
+
+// A measurement's aggregate (wall or CPU time)
+struct ProfileMeasurement
+{
+	uint64_t totalNS;
+	uint64_t maxNS;
+	uint32_t histogram[HandlerProfiler::kHistogramBuckets];
+};
+
+// The aggregates for a single handler
+struct ProfileEntry
+{
+	bool used;
+	HandlerProfiler::EHandlerKind kind;
+	std::string path;
+	std::string name;
+	uint64_t calls;
+	ProfileMeasurement wall;
+	ProfileMeasurement cpu;
+};
+
+std::atomic<bool> HandlerProfiler::enabled(false);
+
+static ProfileEntry entries[HandlerProfiler::kMaxHandlers];
+static int entryCount = 0;
+static uint64_t droppedSamples = 0;
+static std::mutex entriesMutex;
+
+static const char *kindNames[HandlerProfiler::EHandlerKindCount] =
+{
+	"method",
+	"tick",
+	"updated",
+	"get",
+	"set"
+};
+
+// Returns the current time from the given clock, in nanoseconds
+static uint64_t nowNS(clockid_t clock)
+{
+	struct timespec ts;
+	if (clock_gettime(clock, &ts) != 0)
+	{
+		return 0;
+	}
+
+	return static_cast<uint64_t>(ts.tv_sec) * 1000000000ULL + static_cast<uint64_t>(ts.tv_nsec);
+}
+
+// Returns the histogram bucket for a duration
+//
+// Buckets are log-scale with two buckets per power of two: durations in [2^e, 2^e + 2^(e-1)) and [2^e + 2^(e-1), 2^(e+1)) are
+// counted separately. Anything over about four seconds lands in the last bucket.
+static int bucketFor(uint64_t ns)
+{
+	if (ns < 2)
+	{
+		return static_cast<int>(ns);
+	}
+
+	int exponent = 63 - __builtin_clzll(ns);
+	int half = static_cast<int>((ns >> (exponent - 1)) & 1);
+	return std::min(exponent * 2 + half, HandlerProfiler::kHistogramBuckets - 1);
+}
+
+// Returns the largest duration counted in a histogram bucket
+static uint64_t bucketUpperBound(int bucket)
+{
+	if (bucket < 2)
+	{
+		return static_cast<uint64_t>(bucket);
+	}
+
+	int exponent = bucket / 2;
+	int half = bucket % 2;
+	return (1ULL << exponent) + (static_cast<uint64_t>(half + 1) << (exponent - 1)) - 1;
+}
+
+static void addSample(ProfileMeasurement &measurement, uint64_t ns)
+{
+	measurement.totalNS += ns;
+	measurement.maxNS = std::max(measurement.maxNS, ns);
+	measurement.histogram[bucketFor(ns)] += 1;
+}
+
+// Estimates the 99th percentile of a measurement from its histogram
+static uint64_t percentile99(const ProfileMeasurement &measurement, uint64_t calls)
+{
+	uint64_t target = calls - calls / 100;
+	uint64_t seen = 0;
+	for (int bucket = 0; bucket < HandlerProfiler::kHistogramBuckets; ++bucket)
+	{
+		seen += measurement.histogram[bucket];
+		if (seen >= target)
+		{
+			return std::min(bucketUpperBound(bucket), measurement.maxNS);
+		}
+	}
+
+	return measurement.maxNS;
+}
+
+// Finds (or claims) the table entry for a handler
+//
+// Must be called with `entriesMutex` held. Returns nullptr if the table is full.
+static ProfileEntry *findEntry(HandlerProfiler::EHandlerKind kind, const char *pPath, const char *pName)
+{
+	// FNV-1a over the kind, path and name
+	uint32_t hash = 2166136261u ^ static_cast<uint32_t>(kind);
+	hash *= 16777619u;
+	for (const char *p = pPath; *p; ++p) { hash = (hash ^ static_cast<uint8_t>(*p)) * 16777619u; }
+	hash = (hash ^ '/') * 16777619u;
+	for (const char *p = pName; *p; ++p) { hash = (hash ^ static_cast<uint8_t>(*p)) * 16777619u; }
+
+	for (int probe = 0; probe < HandlerProfiler::kMaxHandlers; ++probe)
+	{
+		ProfileEntry &entry = entries[(hash + probe) % HandlerProfiler::kMaxHandlers];
+		if (!entry.used)
+		{
+			entry.used = true;
+			entry.kind = kind;
+			entry.path = pPath;
+			entry.name = pName;
+			entryCount += 1;
+			return &entry;
+		}
+
+		if (entry.kind == kind && entry.path == pPath && entry.name == pName)
+		{
+			return &entry;
+		}
+	}
+
+	return nullptr;
+}
+
+// ---------------------------------------------------------------------------------------------------------------------------------
+// Measurement
+// ---------------------------------------------------------------------------------------------------------------------------------
+
+HandlerProfiler::Scope::Scope(EHandlerKind kind, const char *pPath, const char *pName)
+: active(HandlerProfiler::isEnabled()), kind(kind), pPath(pPath), pName(pName), startWallNS(0), startCpuNS(0)
+{
+	if (active)
+	{
+		startWallNS = nowNS(CLOCK_MONOTONIC);
+		startCpuNS = nowNS(CLOCK_THREAD_CPUTIME_ID);
+	}
+}
+
+HandlerProfiler::Scope::~Scope()
+{
+	if (active)
+	{
+		uint64_t cpuNS = nowNS(CLOCK_THREAD_CPUTIME_ID) - startCpuNS;
+		uint64_t wallNS = nowNS(CLOCK_MONOTONIC) - startWallNS;
+		HandlerProfiler::record(kind, pPath, pName, wallNS, cpuNS);
+	}
+}
+
+void HandlerProfiler::record(EHandlerKind kind, const char *pPath, const char *pName, uint64_t wallNS, uint64_t cpuNS)
+{
+	std::lock_guard<std::mutex> guard(entriesMutex);
+
+	ProfileEntry *pEntry = findEntry(kind, nullptr != pPath ? pPath : "", nullptr != pName ? pName : "");
+	if (nullptr == pEntry)
+	{
+		droppedSamples += 1;
+		return;
+	}
+
+	pEntry->calls += 1;
+	addSample(pEntry->wall, wallNS);
+	addSample(pEntry->cpu, cpuNS);
+}
+
+// ---------------------------------------------------------------------------------------------------------------------------------
+// Control and reporting
+// ---------------------------------------------------------------------------------------------------------------------------------
+
+// Enables or disables profiling. Disabling profiling keeps the samples collected so far.
+void HandlerProfiler::setEnabled(bool enable)
+{
+	enabled.store(enable, std::memory_order_relaxed);
+	Logger::info(SSTR << "Handler profiling " << (enable ? "enabled" : "disabled"));
+}
+
+// Discards all samples
+void HandlerProfiler::reset()
+{
+	std::lock_guard<std::mutex> guard(entriesMutex);
+
+	for (ProfileEntry &entry : entries)
+	{
+		entry.used = false;
+		entry.path.clear();
+		entry.name.clear();
+		entry.calls = 0;
+		memset(&entry.wall, 0, sizeof(entry.wall));
+		memset(&entry.cpu, 0, sizeof(entry.cpu));
+	}
+
+	entryCount = 0;
+	droppedSamples = 0;
+}
+
+// Formats a duration in microseconds
+static std::string formatNS(uint64_t ns)
+{
+	std::ostringstream out;
+	out << std::fixed << std::setprecision(1) << static_cast<double>(ns) / 1000.0 << "us";
+	return out.str();
+}
+
+// A snapshot of one handler's figures, for sorting
+struct ProfileRow
+{
+	const ProfileEntry *pEntry;
+	uint64_t wallP99NS;
+	uint64_t cpuP99NS;
+};
+
+static void appendRows(std::ostringstream &out, const char *pTitle, const std::vector<ProfileRow> &rows, int topN)
+{
+	out << pTitle << "\n";
+
+	int count = std::min(topN, static_cast<int>(rows.size()));
+	for (int i = 0; i < count; ++i)
+	{
+		const ProfileRow &row = rows[i];
+		const ProfileEntry &entry = *row.pEntry;
+		out << "  " << std::setw(2) << (i + 1) << ". [" << kindNames[entry.kind] << "] " << entry.path;
+		if (!entry.name.empty())
+		{
+			out << " " << entry.name;
+		}
+		out << ": calls=" << entry.calls
+			<< ", wall total=" << formatNS(entry.wall.totalNS) << " p99<=" << formatNS(row.wallP99NS) << " max=" << formatNS(entry.wall.maxNS)
+			<< ", cpu total=" << formatNS(entry.cpu.totalNS) << " p99<=" << formatNS(row.cpuP99NS) << " max=" << formatNS(entry.cpu.maxNS)
+			<< "\n";
+	}
+}
+
+// Returns a report of the `topN` most expensive handlers, ranked by total wall time and by 99th percentile wall time
+std::string HandlerProfiler::report(int topN)
+{
+	std::lock_guard<std::mutex> guard(entriesMutex);
+
+	std::vector<ProfileRow> rows;
+	rows.reserve(entryCount);
+	uint64_t totalCalls = 0;
+	for (const ProfileEntry &entry : entries)
+	{
+		if (!entry.used || entry.calls == 0) { continue; }
+
+		ProfileRow row = { &entry, percentile99(entry.wall, entry.calls), percentile99(entry.cpu, entry.calls) };
+		rows.push_back(row);
+		totalCalls += entry.calls;
+	}
+
+	std::ostringstream out;
+	out << "Handler profile: " << totalCalls << " call(s) across " << rows.size() << " handler(s)";
+	if (droppedSamples > 0)
+	{
+		out << " (" << droppedSamples << " sample(s) dropped; more than " << kMaxHandlers << " handlers)";
+	}
+	out << "\n";
+
+	std::sort(rows.begin(), rows.end(), [](const ProfileRow &a, const ProfileRow &b)
+	{
+		return a.pEntry->wall.totalNS > b.pEntry->wall.totalNS;
+	});
+	appendRows(out, "Top handlers by total wall time:", rows, topN);
+
+	std::sort(rows.begin(), rows.end(), [](const ProfileRow &a, const ProfileRow &b)
+	{
+		return a.wallP99NS > b.wallP99NS;
+	});
+	appendRows(out, "Top handlers by p99 wall time:", rows, topN);
+
+	return out.str();
+}
+
+}; // namespace ggk
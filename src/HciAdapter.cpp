@@ -26,6 +26,32 @@
 //
 //     https://git.kernel.org/pub/scm/bluetooth/bluez.git/tree/doc/mgmt-api.txt
 //
+// EVENT DISPATCH:
+//
+// Events are dispatched through a table of handlers indexed by event code. Command Complete events are dispatched a second time
+// through a table indexed by command code. Each table has a built-in handler (installed in the constructor) and an optional
+// application handler (see `registerEventHandler()` and `registerCommandCompleteHandler()`.) Events with no handler are only
+// counted (see `getUnhandledEventCount()`), so a flood of events we don't care about costs very little.
+//
+// Connections and disconnections are also pushed onto a lock-free queue for delivery to the application on the main loop (see
+// `queueConnectionEvent()` and the connection events section of Init.cpp.)
+//
+// ADAPTER STATE:
+//
+// The adapter's settings, controller information, version, name and connection count are written by the event thread but read
+// from anywhere. Rather than sharing those fields, the event thread publishes them together as an `AdapterState`. Each change is
+// made to a copy of the current state, which is written to the next of `kAdapterStateSlots` slots and then published by storing
+// its version in `adapterStateVersion`. A published state is never modified until `kAdapterStateSlots - 1` newer states have
+// been published after it.
+//
+// Readers (see `getAdapterState()`) copy the newest state without taking a lock, then check that the event thread didn't get
+// around to reusing its slot while they were copying. If it did (which takes a burst of publications during one copy) they simply
+// copy the newest state again.
+//
+// The kernel sends a New Settings event whenever the adapter's settings change, whoever changed them, so the published settings
+// stay current without further reads. Code that needs to react to changes can register an `AdapterStateListener` rather than
+// polling.
+//
 // KNOWN LIMITATIONS:
 //
 // This is far from a complete implementation. I'm not even sure how reliable of an implementation this is. However, I can say with
@@ -43,6 +69,7 @@
 // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
 
 #include <string.h>
+#include <algorithm>
 #include <chrono>
 #include <future>
 
@@ -206,6 +233,314 @@ void runEventThread()
 	HciAdapter::getInstance().runEventThread();
 }
 
+// Private constructor for our Singleton
+//
+// This is where the built-in event handlers are installed into our handler tables
+HciAdapter::HciAdapter()
+: adapterStates(), adapterStateVersion(0), adapterStateListenerPassesStarted(0), adapterStateListenerPassesFinished(0), commandResponseLock(commandResponseMutex), connectionEventNotifier(nullptr), droppedConnectionEvents(0)
+{
+	for (size_t i = 0; i < kMaxAdapterStateListeners; ++i)
+	{
+		adapterStateListeners[i].store(nullptr, std::memory_order_relaxed);
+	}
+
+	for (int i = 0; i <= kMaxEventType; ++i)
+	{
+		builtInEventHandlers[i] = nullptr;
+		eventHandlers[i].store(nullptr, std::memory_order_relaxed);
+		unhandledEventCounts[i].store(0, std::memory_order_relaxed);
+	}
+
+	for (int i = 0; i <= kMaxCommandCode; ++i)
+	{
+		builtInCommandCompleteHandlers[i] = nullptr;
+		commandCompleteHandlers[i].store(nullptr, std::memory_order_relaxed);
+	}
+
+	builtInEventHandlers[Mgmt::ECommandCompleteEvent] = onCommandCompleteEvent;
+	builtInEventHandlers[Mgmt::ECommandStatusEvent] = onCommandStatusEvent;
+	builtInEventHandlers[Mgmt::EDeviceConnectedEvent] = onDeviceConnectedEvent;
+	builtInEventHandlers[Mgmt::EDeviceDisconnectedEvent] = onDeviceDisconnectedEvent;
+	builtInEventHandlers[Mgmt::ENewSettingsEvent] = onNewSettingsEvent;
+
+	builtInCommandCompleteHandlers[Mgmt::EReadVersionInformationCommand] = onReadVersionInformation;
+	builtInCommandCompleteHandlers[Mgmt::EReadControllerInformationCommand] = onReadControllerInformation;
+	builtInCommandCompleteHandlers[Mgmt::ESetLocalNameCommand] = onSetLocalName;
+	builtInCommandCompleteHandlers[Mgmt::ESetPoweredCommand] = onAdapterSettings;
+	builtInCommandCompleteHandlers[Mgmt::ESetBREDRCommand] = onAdapterSettings;
+	builtInCommandCompleteHandlers[Mgmt::ESetSecureConnectionsCommand] = onAdapterSettings;
+	builtInCommandCompleteHandlers[Mgmt::ESetBondableCommand] = onAdapterSettings;
+	builtInCommandCompleteHandlers[Mgmt::ESetConnectableCommand] = onAdapterSettings;
+	builtInCommandCompleteHandlers[Mgmt::ESetLowEnergyCommand] = onAdapterSettings;
+	builtInCommandCompleteHandlers[Mgmt::ESetAdvertisingCommand] = onAdapterSettings;
+	builtInCommandCompleteHandlers[Mgmt::EGetConnectionInformationCommand] = onGetConnectionInformation;
+}
+
+// Registers an application handler for the mgmt event `eventCode`
+//
+// Application handlers are called after any built-in handler for the same event. There is one application handler per event
+// code; registering a new handler replaces the previous one and registering `nullptr` removes it. This is safe to call at any
+// time, including while the event thread is running.
+//
+// Returns true on success, or false if `eventCode` is out of range
+bool HciAdapter::registerEventHandler(uint16_t eventCode, EventHandler handler, void *pUserData)
+{
+	if (eventCode < kMinEventType || eventCode > kMaxEventType)
+	{
+		Logger::error(SSTR << "Unable to register a handler for event code " << Utils::hex(eventCode) << ": out of range");
+		return false;
+	}
+
+	const RegisteredEventHandler *pEntry = nullptr;
+	if (nullptr != handler)
+	{
+		std::lock_guard<std::mutex> guard(registrationMutex);
+		registeredEventHandlers.push_back({handler, pUserData});
+		pEntry = &registeredEventHandlers.back();
+	}
+
+	eventHandlers[eventCode].store(pEntry, std::memory_order_release);
+	return true;
+}
+
+// Registers an application handler for Command Complete events of the command `commandCode`
+//
+// Behaves like `registerEventHandler()`, but is dispatched from within the Command Complete event by its command code.
+//
+// Returns true on success, or false if `commandCode` is out of range
+bool HciAdapter::registerCommandCompleteHandler(uint16_t commandCode, CommandCompleteHandler handler, void *pUserData)
+{
+	if (commandCode < kMinCommandCode || commandCode > kMaxCommandCode)
+	{
+		Logger::error(SSTR << "Unable to register a Command Complete handler for command code " << Utils::hex(commandCode) << ": out of range");
+		return false;
+	}
+
+	const RegisteredCommandCompleteHandler *pEntry = nullptr;
+	if (nullptr != handler)
+	{
+		std::lock_guard<std::mutex> guard(registrationMutex);
+		registeredCommandCompleteHandlers.push_back({handler, pUserData});
+		pEntry = &registeredCommandCompleteHandlers.back();
+	}
+
+	commandCompleteHandlers[commandCode].store(pEntry, std::memory_order_release);
+	return true;
+}
+
+// Returns the number of events received that had no handler for the given event code
+//
+// Event codes outside of the known range are counted under code 0 (`Mgmt::EInvalidEvent`)
+uint64_t HciAdapter::getUnhandledEventCount(uint16_t eventCode) const
+{
+	if (eventCode > kMaxEventType) { return 0; }
+	return unhandledEventCounts[eventCode].load(std::memory_order_relaxed);
+}
+
+// Returns the total number of events received that had no handler
+uint64_t HciAdapter::getUnhandledEventCount() const
+{
+	uint64_t total = 0;
+	for (int i = 0; i <= kMaxEventType; ++i)
+	{
+		total += unhandledEventCounts[i].load(std::memory_order_relaxed);
+	}
+
+	return total;
+}
+
+// Returns a consistent copy of the most recently published adapter state
+//
+// This never blocks and is safe to call from any thread. See ADAPTER STATE at the top of this file.
+HciAdapter::AdapterState HciAdapter::getAdapterState() const
+{
+	while (true)
+	{
+		uint64_t version = adapterStateVersion.load(std::memory_order_acquire);
+		AdapterState state = adapterStates[version % kAdapterStateSlots];
+
+		// The slot is only rewritten once the event thread starts on version + kAdapterStateSlots, which it does after publishing
+		// version + kAdapterStateSlots - 1
+		std::atomic_thread_fence(std::memory_order_acquire);
+		if (adapterStateVersion.load(std::memory_order_relaxed) - version < kAdapterStateSlots - 1)
+		{
+			return state;
+		}
+	}
+}
+
+// Publishes `state` as the new adapter state and notifies the listeners (event thread only)
+//
+// `state` should be a copy of `getAdapterState()` with the changes applied; its version is set here.
+void HciAdapter::publishAdapterState(AdapterState &state)
+{
+	uint64_t version = adapterStateVersion.load(std::memory_order_relaxed);
+	uint32_t changedSettings = adapterStates[version % kAdapterStateSlots].settings.masks ^ state.settings.masks;
+
+	state.version = version + 1;
+	state.controllerInformation.currentSettings = state.settings;
+	adapterStates[state.version % kAdapterStateSlots] = state;
+	adapterStateVersion.store(state.version, std::memory_order_release);
+
+	// Removed listeners are kept alive until this pass is finished (see `reclaimAdapterStateListeners()`)
+	adapterStateListenerPassesStarted.fetch_add(1);
+	for (size_t i = 0; i < kMaxAdapterStateListeners; ++i)
+	{
+		const RegisteredAdapterStateListener *pEntry = adapterStateListeners[i].load();
+		if (nullptr != pEntry)
+		{
+			pEntry->handler(state, changedSettings, pEntry->pUserData);
+		}
+	}
+	adapterStateListenerPassesFinished.fetch_add(1);
+}
+
+// Registers a function to be called (on the event thread) each time a new adapter state is published
+//
+// This is safe to call at any time, including while the event thread is running. Returns false if `listener` is nullptr or
+// `kMaxAdapterStateListeners` listeners are already registered.
+bool HciAdapter::addAdapterStateListener(AdapterStateListener listener, void *pUserData)
+{
+	if (nullptr == listener)
+	{
+		return false;
+	}
+
+	std::lock_guard<std::mutex> guard(registrationMutex);
+	reclaimAdapterStateListeners();
+
+	for (size_t i = 0; i < kMaxAdapterStateListeners; ++i)
+	{
+		if (nullptr == adapterStateListeners[i].load(std::memory_order_relaxed))
+		{
+			registeredAdapterStateListeners.push_back({{listener, pUserData}, false, 0});
+			adapterStateListeners[i].store(&registeredAdapterStateListeners.back().listener);
+			return true;
+		}
+	}
+
+	Logger::error(SSTR << "Unable to add an adapter state listener: the limit of " << kMaxAdapterStateListeners << " has been reached");
+	return false;
+}
+
+// Unregisters a listener registered with `addAdapterStateListener()` using the same `pUserData`
+void HciAdapter::removeAdapterStateListener(AdapterStateListener listener, void *pUserData)
+{
+	std::lock_guard<std::mutex> guard(registrationMutex);
+	for (size_t i = 0; i < kMaxAdapterStateListeners; ++i)
+	{
+		const RegisteredAdapterStateListener *pEntry = adapterStateListeners[i].load(std::memory_order_relaxed);
+		if (nullptr != pEntry && pEntry->handler == listener && pEntry->pUserData == pUserData)
+		{
+			adapterStateListeners[i].store(nullptr);
+
+			// A publication that started before the slot was cleared may still call it
+			uint64_t passesStarted = adapterStateListenerPassesStarted.load();
+			for (AdapterStateListenerEntry &entry : registeredAdapterStateListeners)
+			{
+				if (&entry.listener == pEntry)
+				{
+					entry.bRemoved = true;
+					entry.removedDuringPass = passesStarted;
+				}
+			}
+		}
+	}
+
+	reclaimAdapterStateListeners();
+}
+
+// Frees the storage of removed listeners that no publication can still be calling (call with `registrationMutex` held)
+//
+// A listener removed while `adapterStateListenerPassesStarted` was N can only be seen by publications up to the Nth, since every
+// later one loads its slot after it was cleared. Once N publications have finished, nothing can be calling it.
+void HciAdapter::reclaimAdapterStateListeners()
+{
+	uint64_t passesFinished = adapterStateListenerPassesFinished.load();
+	registeredAdapterStateListeners.remove_if([passesFinished](const AdapterStateListenerEntry &entry)
+	{
+		return entry.bRemoved && passesFinished >= entry.removedDuringPass;
+	});
+}
+
+// Sets the function that is called (on the event thread) each time a connection event is queued, or nullptr for none
+//
+// The notifier should only arrange for the events to be collected with `popConnectionEvent()` on another thread.
+void HciAdapter::setConnectionEventNotifier(ConnectionEventNotifier notifier)
+{
+	connectionEventNotifier.store(notifier, std::memory_order_release);
+}
+
+// Removes the oldest queued connection event
+//
+// Only one thread may collect connection events. Returns false if there are none.
+bool HciAdapter::popConnectionEvent(ConnectionEvent &event)
+{
+	return connectionEvents.pop(event);
+}
+
+// Queues a connection event for delivery and notifies the collector
+//
+// Events are only dropped if the collector has fallen `kMaxQueuedConnectionEvents` behind. The event thread never waits. Drops are
+// only counted here; the collector reports them (see `getDroppedConnectionEventCount()`.)
+void HciAdapter::queueConnectionEvent(const ConnectionEvent &event)
+{
+	if (!connectionEvents.push(event))
+	{
+		droppedConnectionEvents.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	ConnectionEventNotifier notifier = connectionEventNotifier.load(std::memory_order_acquire);
+	if (nullptr != notifier)
+	{
+		notifier();
+	}
+}
+
+// Counts an event that had no handler
+//
+// We only log the first occurrence of each event code, so a storm of unhandled events costs no more than an increment each
+void HciAdapter::countUnhandledEvent(uint16_t eventCode)
+{
+	uint16_t index = eventCode <= kMaxEventType ? eventCode : 0;
+	if (unhandledEventCounts[index].fetch_add(1, std::memory_order_relaxed) == 0)
+	{
+		if (index == 0)
+		{
+			Logger::debug(SSTR << "Received an invalid event type: " << Utils::hex(eventCode) << " (further occurrences will only be counted)");
+		}
+		else
+		{
+			Logger::debug(SSTR << "No handler for event type: " << Utils::hex(eventCode) << " (" << kEventTypeNames[eventCode] << ") (further occurrences will only be counted)");
+		}
+	}
+}
+
+// Calls the built-in and application handlers for an event, counting the event if there are none
+void HciAdapter::dispatchEvent(uint16_t eventCode, const std::vector<uint8_t> &packet)
+{
+	bool handled = false;
+
+	EventHandler builtIn = builtInEventHandlers[eventCode];
+	if (nullptr != builtIn)
+	{
+		builtIn(*this, packet, nullptr);
+		handled = true;
+	}
+
+	const RegisteredEventHandler *pRegistered = eventHandlers[eventCode].load(std::memory_order_acquire);
+	if (nullptr != pRegistered)
+	{
+		pRegistered->handler(*this, packet, pRegistered->pUserData);
+		handled = true;
+	}
+
+	if (!handled)
+	{
+		countUnhandledEvent(eventCode);
+	}
+}
+
 // Event processor, responsible for receiving events from the HCI socket
 //
 // This mehtod should not be called directly. Rather, it runs continuously on a thread until the server shuts down
@@ -225,7 +560,7 @@ void HciAdapter::runEventThread()
 		}
 
 		// Do we have enough to check the event code?
-		if (responsePacket.size() < 2)
+		if (responsePacket.size() < sizeof(HciHeader))
 		{
 			Logger::error(SSTR << "Invalid command response: too short");
 			continue;
@@ -237,142 +572,326 @@ void HciAdapter::runEventThread()
 		// Ensure our event code is valid
 		if (eventCode < HciAdapter::kMinEventType || eventCode > HciAdapter::kMaxEventType)
 		{
-			Logger::error(SSTR << "Invalid command response: event code (" << eventCode << ") out of range");
+			countUnhandledEvent(eventCode);
 			continue;
 		}
 
-		switch(eventCode)
+		dispatchEvent(eventCode, responsePacket);
+	}
+
+	// Make sure we're disconnected before we leave
+	hciSocket.disconnect();
+
+	Logger::trace("Leaving the HciAdapter event thread");
+}
+
+// ---------------------------------------------------------------------------------------------------------------------------------
+// Built-in event handlers
+// ---------------------------------------------------------------------------------------------------------------------------------
+
+// Command complete event
+//
+// Dispatches to the Command Complete handlers for the command, then notifies anybody waiting on the command
+void HciAdapter::onCommandCompleteEvent(HciAdapter &adapter, const std::vector<uint8_t> &packet, void * /*pUserData*/)
+{
+	if (packet.size() < sizeof(CommandCompleteEvent))
+	{
+		Logger::error("Invalid command complete event: too short");
+		return;
+	}
+
+	// Extract our event
+	CommandCompleteEvent event(packet);
+
+	// Point to the data following the event
+	const uint8_t *pData = packet.data() + sizeof(CommandCompleteEvent);
+	size_t dataLength = packet.size() - sizeof(CommandCompleteEvent);
+
+	if (event.commandCode <= kMaxCommandCode)
+	{
+		CommandCompleteHandler builtIn = adapter.builtInCommandCompleteHandlers[event.commandCode];
+		if (nullptr != builtIn)
+		{
+			builtIn(adapter, event, pData, dataLength, nullptr);
+		}
+
+		const RegisteredCommandCompleteHandler *pRegistered = adapter.commandCompleteHandlers[event.commandCode].load(std::memory_order_acquire);
+		if (nullptr != pRegistered)
 		{
-			// Command complete event
-			case Mgmt::ECommandCompleteEvent:
-			{
-				// Extract our event
-				CommandCompleteEvent event(responsePacket);
+			pRegistered->handler(adapter, event, pData, dataLength, pRegistered->pUserData);
+		}
+	}
 
-				// Point to the data following the event
-				uint8_t *data = responsePacket.data() + sizeof(CommandCompleteEvent);
-				size_t dataLen = responsePacket.size() - sizeof(CommandCompleteEvent);
+	// Notify anybody waiting that we received a response to their command code
+	adapter.setCommandResponse(event.commandCode);
+}
 
-				switch(event.commandCode)
-				{
-					// We just log the version/revision info
-					case Mgmt::EReadVersionInformationCommand:
-					{
-						// Verify the size is what we expect
-						if (dataLen != sizeof(VersionInformation))
-						{
-							Logger::error("Invalid data length");
-							return;
-						}
-
-						versionInformation = *reinterpret_cast<VersionInformation *>(data);
-						versionInformation.toHost();
-						Logger::debug(versionInformation.debugText());
-						break;
-					}
-					case Mgmt::EReadControllerInformationCommand:
-					{
-						if (dataLen != sizeof(ControllerInformation))
-						{
-							Logger::error("Invalid data length");
-							return;
-						}
-
-						controllerInformation = *reinterpret_cast<ControllerInformation *>(data);
-						controllerInformation.toHost();
-						Logger::debug(controllerInformation.debugText());
-						break;
-					}
-					case Mgmt::ESetLocalNameCommand:
-					{
-						if (dataLen != sizeof(LocalName))
-						{
-							Logger::error("Invalid data length");
-							return;
-						}
-
-						localName = *reinterpret_cast<LocalName *>(data);
-						Logger::info(localName.debugText());
-						break;
-					}
-					case Mgmt::ESetPoweredCommand:
-					case Mgmt::ESetBREDRCommand:
-					case Mgmt::ESetSecureConnectionsCommand:
-					case Mgmt::ESetBondableCommand:
-					case Mgmt::ESetConnectableCommand:
-					case Mgmt::ESetLowEnergyCommand:
-					case Mgmt::ESetAdvertisingCommand:
-					{
-						if (dataLen != sizeof(AdapterSettings))
-						{
-							Logger::error("Invalid data length");
-							return;
-						}
-
-						adapterSettings = *reinterpret_cast<AdapterSettings *>(data);
-						adapterSettings.toHost();
-
-						Logger::debug(adapterSettings.debugText());
-						break;
-					}
-				}
+// Command status event
+void HciAdapter::onCommandStatusEvent(HciAdapter &adapter, const std::vector<uint8_t> &packet, void * /*pUserData*/)
+{
+	if (packet.size() < sizeof(CommandStatusEvent))
+	{
+		Logger::error("Invalid command status event: too short");
+		return;
+	}
 
-				// Notify anybody waiting that we received a response to their command code
-				setCommandResponse(event.commandCode);
+	CommandStatusEvent event(packet);
 
-				break;
-			}
-			// Command status event
-			case Mgmt::ECommandStatusEvent:
-			{
-				CommandStatusEvent event(responsePacket);
+	// Notify anybody waiting that we received a response to their command code
+	adapter.setCommandResponse(event.commandCode);
+}
 
-				// Notify anybody waiting that we received a response to their command code
-				setCommandResponse(event.commandCode);
-				break;
-			}
-			// Command status event
-			case Mgmt::EDeviceConnectedEvent:
-			{
-				DeviceConnectedEvent event(responsePacket);
-				activeConnections += 1;
-				Logger::debug(SSTR << "  > Connection count incremented to " << activeConnections);
-				break;
-			}
-			// Command status event
-			case Mgmt::EDeviceDisconnectedEvent:
-			{
-				DeviceDisconnectedEvent event(responsePacket);
-				if (activeConnections > 0)
-				{
-					activeConnections -= 1;
-					Logger::debug(SSTR << "  > Connection count decremented to " << activeConnections);
-				}
-				else
-				{
-					Logger::debug(SSTR << "  > Connection count already at zero, ignoring non-connected disconnect event");
-				}
-				break;
-			}
-			// Unsupported
-			default:
-			{
-				if (eventCode >= kMinEventType && eventCode <= kMaxEventType)
-				{
-					Logger::error("Unsupported response event type: " + Utils::hex(eventCode) + " (" + kEventTypeNames[eventCode] + ")");
-				}
-				else
-				{
-					Logger::error("Invalid event type response: " + Utils::hex(eventCode));					
-				}
-			}
+// Device connected event
+void HciAdapter::onDeviceConnectedEvent(HciAdapter &adapter, const std::vector<uint8_t> &packet, void * /*pUserData*/)
+{
+	if (packet.size() < sizeof(DeviceConnectedEvent))
+	{
+		Logger::error("Invalid device connected event: too short");
+		return;
+	}
+
+	DeviceConnectedEvent event(packet);
+
+	AdapterState state = adapter.getAdapterState();
+	state.activeConnections += 1;
+	adapter.publishAdapterState(state);
+	Logger::debug(SSTR << "  > Connection count incremented to " << state.activeConnections);
+
+	ConnectionEvent connectionEvent;
+	connectionEvent.connected = true;
+	connectionEvent.controllerId = event.header.controllerId;
+	memcpy(connectionEvent.address, event.address, sizeof(connectionEvent.address));
+	connectionEvent.addressType = event.addressType;
+	connectionEvent.reason = 0;
+	adapter.queueConnectionEvent(connectionEvent);
+
+	std::lock_guard<std::mutex> guard(adapter.connectedDevicesMutex);
+	for (const ConnectedDevice &device : adapter.connectedDevices)
+	{
+		if (memcmp(device.address, event.address, sizeof(device.address)) == 0) { return; }
+	}
+
+	ConnectedDevice device;
+	device.controllerId = event.header.controllerId;
+	memcpy(device.address, event.address, sizeof(device.address));
+	device.addressType = event.addressType;
+	device.rssi = kLinkInfoUnavailable;
+	device.txPower = kLinkInfoUnavailable;
+	device.maxTxPower = kLinkInfoUnavailable;
+	adapter.connectedDevices.push_back(device);
+}
+
+// Device disconnected event
+void HciAdapter::onDeviceDisconnectedEvent(HciAdapter &adapter, const std::vector<uint8_t> &packet, void * /*pUserData*/)
+{
+	if (packet.size() < sizeof(DeviceDisconnectedEvent))
+	{
+		Logger::error("Invalid device disconnected event: too short");
+		return;
+	}
+
+	DeviceDisconnectedEvent event(packet);
+
+	AdapterState state = adapter.getAdapterState();
+	if (state.activeConnections > 0)
+	{
+		state.activeConnections -= 1;
+		adapter.publishAdapterState(state);
+		Logger::debug(SSTR << "  > Connection count decremented to " << state.activeConnections);
+	}
+	else
+	{
+		Logger::debug(SSTR << "  > Connection count already at zero, ignoring non-connected disconnect event");
+	}
+
+	ConnectionEvent connectionEvent;
+	connectionEvent.connected = false;
+	connectionEvent.controllerId = event.header.controllerId;
+	memcpy(connectionEvent.address, event.address, sizeof(connectionEvent.address));
+	connectionEvent.addressType = event.addressType;
+	connectionEvent.reason = event.reason;
+	adapter.queueConnectionEvent(connectionEvent);
+
+	std::lock_guard<std::mutex> guard(adapter.connectedDevicesMutex);
+	for (auto it = adapter.connectedDevices.begin(); it != adapter.connectedDevices.end(); ++it)
+	{
+		if (memcmp(it->address, event.address, sizeof(it->address)) == 0)
+		{
+			adapter.connectedDevices.erase(it);
+			break;
 		}
 	}
+}
 
-	// Make sure we're disconnected before we leave
-	hciSocket.disconnect();
+// New Settings event: the adapter's settings changed, whether by us or by somebody else
+void HciAdapter::onNewSettingsEvent(HciAdapter &adapter, const std::vector<uint8_t> &packet, void * /*pUserData*/)
+{
+	if (packet.size() < sizeof(HciHeader) + sizeof(AdapterSettings))
+	{
+		Logger::error("Invalid new settings event: too short");
+		return;
+	}
 
-	Logger::trace("Leaving the HciAdapter event thread");
+	AdapterState state = adapter.getAdapterState();
+	state.settings = *reinterpret_cast<const AdapterSettings *>(packet.data() + sizeof(HciHeader));
+	state.settings.toHost();
+	adapter.publishAdapterState(state);
+
+	Logger::debug(state.settings.debugText());
+}
+
+// ---------------------------------------------------------------------------------------------------------------------------------
+// Built-in Command Complete handlers
+// ---------------------------------------------------------------------------------------------------------------------------------
+
+// We just log the version/revision info
+void HciAdapter::onReadVersionInformation(HciAdapter &adapter, const CommandCompleteEvent & /*event*/, const uint8_t *pData, size_t dataLength, void * /*pUserData*/)
+{
+	// Verify the size is what we expect
+	if (dataLength != sizeof(VersionInformation))
+	{
+		Logger::error("Invalid data length");
+		return;
+	}
+
+	AdapterState state = adapter.getAdapterState();
+	state.versionInformation = *reinterpret_cast<const VersionInformation *>(pData);
+	state.versionInformation.toHost();
+	adapter.publishAdapterState(state);
+	Logger::debug(state.versionInformation.debugText());
+}
+
+void HciAdapter::onReadControllerInformation(HciAdapter &adapter, const CommandCompleteEvent & /*event*/, const uint8_t *pData, size_t dataLength, void * /*pUserData*/)
+{
+	if (dataLength != sizeof(ControllerInformation))
+	{
+		Logger::error("Invalid data length");
+		return;
+	}
+
+	AdapterState state = adapter.getAdapterState();
+	state.controllerInformation = *reinterpret_cast<const ControllerInformation *>(pData);
+	state.controllerInformation.toHost();
+	state.settings = state.controllerInformation.currentSettings;
+	state.bHaveControllerInformation = true;
+	adapter.publishAdapterState(state);
+	Logger::debug(state.controllerInformation.debugText());
+}
+
+void HciAdapter::onSetLocalName(HciAdapter &adapter, const CommandCompleteEvent & /*event*/, const uint8_t *pData, size_t dataLength, void * /*pUserData*/)
+{
+	if (dataLength != sizeof(LocalName))
+	{
+		Logger::error("Invalid data length");
+		return;
+	}
+
+	AdapterState state = adapter.getAdapterState();
+	state.localName = *reinterpret_cast<const LocalName *>(pData);
+	memcpy(state.controllerInformation.name, state.localName.name, sizeof(state.controllerInformation.name));
+	memcpy(state.controllerInformation.shortName, state.localName.shortName, sizeof(state.controllerInformation.shortName));
+	adapter.publishAdapterState(state);
+	Logger::info(state.localName.debugText());
+}
+
+// All of the settings commands respond with the adapter's current settings
+void HciAdapter::onAdapterSettings(HciAdapter &adapter, const CommandCompleteEvent & /*event*/, const uint8_t *pData, size_t dataLength, void * /*pUserData*/)
+{
+	if (dataLength != sizeof(AdapterSettings))
+	{
+		Logger::error("Invalid data length");
+		return;
+	}
+
+	AdapterState state = adapter.getAdapterState();
+	state.settings = *reinterpret_cast<const AdapterSettings *>(pData);
+	state.settings.toHost();
+	adapter.publishAdapterState(state);
+
+	Logger::debug(state.settings.debugText());
+}
+
+// Connection information arrives for one device at a time, in response to `requestConnectionInformation()`
+//
+// The return parameters are present even on failure (such as when the device has disconnected since the request was sent.)
+void HciAdapter::onGetConnectionInformation(HciAdapter &adapter, const CommandCompleteEvent &event, const uint8_t *pData, size_t dataLength, void * /*pUserData*/)
+{
+	if (dataLength != sizeof(ConnectionInformation))
+	{
+		Logger::error("Invalid data length");
+		return;
+	}
+
+	ConnectionInformation info = *reinterpret_cast<const ConnectionInformation *>(pData);
+	Logger::debug(info.debugText());
+
+	std::lock_guard<std::mutex> guard(adapter.connectedDevicesMutex);
+	for (ConnectedDevice &device : adapter.connectedDevices)
+	{
+		if (memcmp(device.address, info.address, sizeof(device.address)) == 0)
+		{
+			bool success = event.status == 0;
+			device.rssi = success ? info.rssi : kLinkInfoUnavailable;
+			device.txPower = success ? info.txPower : kLinkInfoUnavailable;
+			device.maxTxPower = success ? info.maxTxPower : kLinkInfoUnavailable;
+			break;
+		}
+	}
+}
+
+// Returns a copy of the list of connected devices and their most recent link quality
+std::vector<HciAdapter::ConnectedDevice> HciAdapter::getConnectedDevices()
+{
+	std::lock_guard<std::mutex> guard(connectedDevicesMutex);
+	return connectedDevices;
+}
+
+// Finds the lowest RSSI among the connected devices
+//
+// Returns false if no connected device has reported an RSSI yet
+bool HciAdapter::getWorstRssi(int8_t &rssi)
+{
+	bool found = false;
+
+	std::lock_guard<std::mutex> guard(connectedDevicesMutex);
+	for (const ConnectedDevice &device : connectedDevices)
+	{
+		if (device.rssi != kLinkInfoUnavailable && (!found || device.rssi < rssi))
+		{
+			rssi = device.rssi;
+			found = true;
+		}
+	}
+
+	return found;
+}
+
+// Requests connection information (RSSI and TX power) for every connected device
+//
+// All requests are sent back-to-back without waiting. The results arrive on the event thread and can be read with
+// `getConnectedDevices()` or `getWorstRssi()`.
+void HciAdapter::requestConnectionInformation()
+{
+	struct SRequest : HciHeader
+	{
+		uint8_t address[6];
+		uint8_t addressType;
+	} __attribute__((packed));
+
+	for (const ConnectedDevice &device : getConnectedDevices())
+	{
+		SRequest request;
+		request.code = Mgmt::EGetConnectionInformationCommand;
+		request.controllerId = device.controllerId;
+		request.dataSize = sizeof(SRequest) - sizeof(HciHeader);
+		memcpy(request.address, device.address, sizeof(request.address));
+		request.addressType = device.addressType;
+
+		if (!sendCommandNoWait(request))
+		{
+			Logger::warn(SSTR << "  + Failed to request connection information for " << device.getAddressString());
+		}
+	}
 }
 
 // Reads current values from the controller
@@ -523,6 +1042,29 @@ bool HciAdapter::sendCommand(HciHeader &request)
 	return fut.get();
 }
 
+// Sends a command over the HCI socket without waiting for a response
+//
+// The response is delivered through the event handler tables (see `registerCommandCompleteHandler()`). This is safe to call from
+// the main loop.
+//
+// Returns true if the command was written, otherwise false
+bool HciAdapter::sendCommandNoWait(HciHeader &request)
+{
+	// We only send these while the event thread is running, otherwise nobody would receive the response
+	if (!eventThread.joinable() || !hciSocket.isConnected())
+	{
+		return false;
+	}
+
+	uint16_t dataSize = request.dataSize;
+
+	// Prepare the request to be sent (endianness correction)
+	request.toNetwork();
+	const uint8_t *pRequest = reinterpret_cast<const uint8_t *>(&request);
+
+	return hciSocket.write(pRequest, sizeof(request) + dataSize);
+}
+
 // Uses a std::condition_variable to wait for a response event for the given `commandCode` or `timeoutMS` milliseconds.
 //
 // Returns true if the response event was received for `commandCode` or false if the timeout expired.
@@ -25,12 +25,16 @@
 #pragma once
 
 #include <stdint.h>
+#include <string.h>
 #include <vector>
+#include <list>
+#include <atomic>
 #include <thread>
 #include <mutex>
 #include <condition_variable>
 
 #include "HciSocket.h"
+#include "SpscQueue.h"
 #include "../include/Utils.h"
 #include "../include/Logger.h"
 
@@ -60,6 +64,9 @@ public:
 	static const int kMaxEventType = 0x0025;
 	static const char * const kEventTypeNames[kMaxEventType + 1];
 
+	// The value reported for RSSI and TX power when they are not available for a connection
+	static const int8_t kLinkInfoUnavailable = 127;
+
 	static const int kMinStatusCode = 0x00;
 	static const int kMaxStatusCode = 0x14;
 	static const char * const kStatusCodes[kMaxStatusCode + 1];
@@ -416,6 +423,111 @@ public:
 		}
 	} __attribute__((packed));
 
+	// Return parameters from the Get Connection Information command
+	struct ConnectionInformation
+	{
+		uint8_t address[6];
+		uint8_t addressType;
+		int8_t rssi;
+		int8_t txPower;
+		int8_t maxTxPower;
+
+		std::string debugText()
+		{
+			std::string text = "";
+			text += "> Connection information\n";
+			text += "  + Address            : " + Utils::bluetoothAddressString(address) + "\n";
+			text += "  + Address type       : " + Utils::hex(addressType) + "\n";
+			text += "  + RSSI               : " + std::to_string(static_cast<int>(rssi)) + "\n";
+			text += "  + TX power           : " + std::to_string(static_cast<int>(txPower)) + "\n";
+			text += "  + Max TX power       : " + std::to_string(static_cast<int>(maxTxPower));
+			return text;
+		}
+	} __attribute__((packed));
+
+	// A connected device, along with the most recent link quality we've polled for it (see `requestConnectionInformation()`)
+	//
+	// Until the first poll completes, `rssi`, `txPower` and `maxTxPower` are set to `kLinkInfoUnavailable`
+	struct ConnectedDevice
+	{
+		uint16_t controllerId;
+		uint8_t address[6];
+		uint8_t addressType;
+		int8_t rssi;
+		int8_t txPower;
+		int8_t maxTxPower;
+
+		std::string getAddressString() const
+		{
+			uint8_t addressCopy[6];
+			memcpy(addressCopy, address, sizeof(addressCopy));
+			return Utils::bluetoothAddressString(addressCopy);
+		}
+	};
+
+	// A connection or disconnection, queued by the event thread for delivery on the main loop (see `popConnectionEvent()`)
+	//
+	// `reason` is the mgmt API disconnection reason (0 for connections)
+	struct ConnectionEvent
+	{
+		bool connected;
+		uint16_t controllerId;
+		uint8_t address[6];
+		uint8_t addressType;
+		uint8_t reason;
+
+		std::string getAddressString() const
+		{
+			uint8_t addressCopy[6];
+			memcpy(addressCopy, address, sizeof(addressCopy));
+			return Utils::bluetoothAddressString(addressCopy);
+		}
+	};
+
+	// Everything we know about the adapter, published as a whole by the event thread (see `getAdapterState()`)
+	//
+	// `version` goes up by one with each publication. Until the controller information has been read, `bHaveControllerInformation`
+	// is false and the information is zeroed. `settings` and `controllerInformation.currentSettings` always agree.
+	struct AdapterState
+	{
+		uint64_t version;
+		bool bHaveControllerInformation;
+		AdapterSettings settings;
+		ControllerInformation controllerInformation;
+		VersionInformation versionInformation;
+		LocalName localName;
+		int activeConnections;
+	};
+
+	// The number of adapter states we keep at once; a reader only has to retry if this many are published while it copies one
+	static const size_t kAdapterStateSlots = 8;
+
+	// The most adapter state listeners that can be registered at once
+	static const size_t kMaxAdapterStateListeners = 8;
+
+	// Called on the event thread each time a new adapter state is published
+	//
+	// `changedSettings` holds the settings bits (see `HciControllerSettings`) that differ from the previous state. Listeners must
+	// not block; like the connection event notifier, they should only arrange for any real work to be done on another thread.
+	typedef void (*AdapterStateListener)(const AdapterState &state, uint32_t changedSettings, void *pUserData);
+
+	// The number of connection events that can wait for delivery before new ones are dropped
+	static const size_t kMaxQueuedConnectionEvents = 64;
+
+	// Called on the event thread each time a connection event is queued
+	typedef void (*ConnectionEventNotifier)();
+
+	// Handler for a mgmt event
+	//
+	// `packet` is the complete event packet, starting with its `HciHeader`. Handlers are called on the event thread.
+	typedef void (*EventHandler)(HciAdapter &adapter, const std::vector<uint8_t> &packet, void *pUserData);
+
+	// Handler for a Command Complete event of a specific command
+	//
+	// `pData` points to the command's return parameters (the data following the `CommandCompleteEvent`) and `dataLength` is their
+	// size in bytes. Handlers are called on the event thread.
+	typedef void (*CommandCompleteHandler)(HciAdapter &adapter, const CommandCompleteEvent &event, const uint8_t *pData, size_t dataLength, void *pUserData);
+
 	//
 	// Accessors
 	//
@@ -427,11 +539,57 @@ public:
 		return instance;
 	}
 
-	AdapterSettings getAdapterSettings() { return adapterSettings; }
-	ControllerInformation getControllerInformation() { return controllerInformation; }
-	VersionInformation getVersionInformation() { return versionInformation; }
-	LocalName getLocalName() { return localName; }
-	int getActiveConnectionCount() { return activeConnections; }
+	// Returns a consistent copy of the most recently published adapter state
+	//
+	// This never blocks and is safe to call from any thread.
+	AdapterState getAdapterState() const;
+
+	// Returns the version of the most recently published adapter state
+	uint64_t getAdapterStateVersion() const { return adapterStateVersion.load(std::memory_order_acquire); }
+
+	AdapterSettings getAdapterSettings() const { return getAdapterState().settings; }
+	ControllerInformation getControllerInformation() const { return getAdapterState().controllerInformation; }
+	VersionInformation getVersionInformation() const { return getAdapterState().versionInformation; }
+	LocalName getLocalName() const { return getAdapterState().localName; }
+	int getActiveConnectionCount() const { return getAdapterState().activeConnections; }
+
+	// Registers a function to be called (on the event thread) each time a new adapter state is published
+	//
+	// This is safe to call at any time, including while the event thread is running. Returns false if `listener` is nullptr or
+	// `kMaxAdapterStateListeners` listeners are already registered.
+	bool addAdapterStateListener(AdapterStateListener listener, void *pUserData);
+
+	// Unregisters a listener registered with `addAdapterStateListener()` using the same `pUserData`
+	void removeAdapterStateListener(AdapterStateListener listener, void *pUserData);
+
+	// Returns a copy of the list of connected devices and their most recent link quality
+	std::vector<ConnectedDevice> getConnectedDevices();
+
+	// Finds the lowest RSSI among the connected devices
+	//
+	// Returns false if no connected device has reported an RSSI yet
+	bool getWorstRssi(int8_t &rssi);
+
+	// Returns the number of events received that had no handler for the given event code
+	//
+	// Event codes outside of the known range are counted under code 0 (`Mgmt::EInvalidEvent`)
+	uint64_t getUnhandledEventCount(uint16_t eventCode) const;
+
+	// Returns the total number of events received that had no handler
+	uint64_t getUnhandledEventCount() const;
+
+	// Sets the function that is called (on the event thread) each time a connection event is queued, or nullptr for none
+	//
+	// The notifier should only arrange for the events to be collected with `popConnectionEvent()` on another thread.
+	void setConnectionEventNotifier(ConnectionEventNotifier notifier);
+
+	// Removes the oldest queued connection event
+	//
+	// Only one thread may collect connection events. Returns false if there are none.
+	bool popConnectionEvent(ConnectionEvent &event);
+
+	// Returns the number of connection events dropped because too many were waiting for delivery
+	uint64_t getDroppedConnectionEventCount() const { return droppedConnectionEvents.load(std::memory_order_relaxed); }
 
 	//
 	// Disallow copies of our singleton (c++11)
@@ -468,14 +626,101 @@ public:
 	// Returns true on success, otherwise false
 	bool sendCommand(HciHeader &request);
 
+	// Sends a command over the HCI socket without waiting for a response
+	//
+	// The response is delivered through the event handler tables (see `registerCommandCompleteHandler()`). This is safe to call
+	// from the main loop.
+	//
+	// Returns true if the command was written, otherwise false
+	bool sendCommandNoWait(HciHeader &request);
+
+	// Requests connection information (RSSI and TX power) for every connected device
+	//
+	// All requests are sent back-to-back without waiting. The results arrive on the event thread and can be read with
+	// `getConnectedDevices()` or `getWorstRssi()`.
+	void requestConnectionInformation();
+
+	// Registers an application handler for the mgmt event `eventCode`
+	//
+	// Application handlers are called after any built-in handler for the same event. There is one application handler per event
+	// code; registering a new handler replaces the previous one and registering `nullptr` removes it. This is safe to call at any
+	// time, including while the event thread is running.
+	//
+	// Returns true on success, or false if `eventCode` is out of range
+	bool registerEventHandler(uint16_t eventCode, EventHandler handler, void *pUserData);
+
+	// Registers an application handler for Command Complete events of the command `commandCode`
+	//
+	// Behaves like `registerEventHandler()`, but is dispatched from within the Command Complete event by its command code.
+	//
+	// Returns true on success, or false if `commandCode` is out of range
+	bool registerCommandCompleteHandler(uint16_t commandCode, CommandCompleteHandler handler, void *pUserData);
+
 	// Event processor, responsible for receiving events from the HCI socket
 	//
 	// This mehtod should not be called directly. Rather, it runs continuously on a thread until the server shuts down
 	void runEventThread();
 
 private:
+	// An application-registered handler along with its user data
+	//
+	// These are published to the event thread through an atomic pointer, so once registered they are never modified (and, adapter
+	// state listeners aside, never freed)
+	template<typename H>
+	struct RegisteredHandler
+	{
+		H handler;
+		void *pUserData;
+	};
+
+	typedef RegisteredHandler<EventHandler> RegisteredEventHandler;
+	typedef RegisteredHandler<CommandCompleteHandler> RegisteredCommandCompleteHandler;
+	typedef RegisteredHandler<AdapterStateListener> RegisteredAdapterStateListener;
+
+	// The storage behind a registered adapter state listener
+	//
+	// Unlike other handlers, listeners come and go with each server run. A removed listener's storage is kept until every
+	// publication that may have seen it has finished calling its listeners (see `reclaimAdapterStateListeners()`).
+	struct AdapterStateListenerEntry
+	{
+		RegisteredAdapterStateListener listener;
+		bool bRemoved;
+		uint64_t removedDuringPass;
+	};
+
+	// Frees the storage of removed listeners that no publication can still be calling (call with `registrationMutex` held)
+	void reclaimAdapterStateListeners();
+
 	// Private constructor for our Singleton
-	HciAdapter() : commandResponseLock(commandResponseMutex), activeConnections(0) {}
+	HciAdapter();
+
+	// Calls the built-in and application handlers for an event, counting the event if there are none
+	void dispatchEvent(uint16_t eventCode, const std::vector<uint8_t> &packet);
+
+	// Counts an event that had no handler
+	void countUnhandledEvent(uint16_t eventCode);
+
+	// Queues a connection event for delivery and notifies the collector
+	void queueConnectionEvent(const ConnectionEvent &event);
+
+	// Publishes `state` as the new adapter state and notifies the listeners (event thread only)
+	//
+	// `state` should be a copy of `getAdapterState()` with the changes applied; its version is set here.
+	void publishAdapterState(AdapterState &state);
+
+	// Built-in event handlers
+	static void onCommandCompleteEvent(HciAdapter &adapter, const std::vector<uint8_t> &packet, void *pUserData);
+	static void onCommandStatusEvent(HciAdapter &adapter, const std::vector<uint8_t> &packet, void *pUserData);
+	static void onDeviceConnectedEvent(HciAdapter &adapter, const std::vector<uint8_t> &packet, void *pUserData);
+	static void onDeviceDisconnectedEvent(HciAdapter &adapter, const std::vector<uint8_t> &packet, void *pUserData);
+	static void onNewSettingsEvent(HciAdapter &adapter, const std::vector<uint8_t> &packet, void *pUserData);
+
+	// Built-in Command Complete handlers
+	static void onReadVersionInformation(HciAdapter &adapter, const CommandCompleteEvent &event, const uint8_t *pData, size_t dataLength, void *pUserData);
+	static void onReadControllerInformation(HciAdapter &adapter, const CommandCompleteEvent &event, const uint8_t *pData, size_t dataLength, void *pUserData);
+	static void onSetLocalName(HciAdapter &adapter, const CommandCompleteEvent &event, const uint8_t *pData, size_t dataLength, void *pUserData);
+	static void onAdapterSettings(HciAdapter &adapter, const CommandCompleteEvent &event, const uint8_t *pData, size_t dataLength, void *pUserData);
+	static void onGetConnectionInformation(HciAdapter &adapter, const CommandCompleteEvent &event, const uint8_t *pData, size_t dataLength, void *pUserData);
 
 	// Uses a std::condition_variable to wait for a response event for the given `commandCode` or `timeoutMS` milliseconds.
 	//
@@ -493,19 +738,47 @@ private:
 	// Our event thread listens for events coming from the adapter and deals with them appropriately
 	static std::thread eventThread;
 
-	// Our adapter information
-	AdapterSettings adapterSettings;
-	ControllerInformation controllerInformation;
-	VersionInformation versionInformation;
-	LocalName localName;
+	// Our adapter state, published by the event thread (see `publishAdapterState()`)
+	//
+	// Version N lives in slot N % kAdapterStateSlots and `adapterStateVersion` holds the newest version
+	AdapterState adapterStates[kAdapterStateSlots];
+	std::atomic<uint64_t> adapterStateVersion;
+
+	// Our adapter state listeners (see `RegisteredHandler`)
+	std::atomic<const RegisteredAdapterStateListener *> adapterStateListeners[kMaxAdapterStateListeners];
+
+	// The number of publications that have started and finished calling the listeners
+	std::atomic<uint64_t> adapterStateListenerPassesStarted;
+	std::atomic<uint64_t> adapterStateListenerPassesFinished;
 
 	std::condition_variable cvCommandResponse;
 	std::mutex commandResponseMutex;
 	std::unique_lock<std::mutex> commandResponseLock;
 	int conditionalValue;
 
-	// Our active connection count
-	int activeConnections;
+	// Our connected devices (written on the event thread)
+	std::mutex connectedDevicesMutex;
+	std::vector<ConnectedDevice> connectedDevices;
+
+	// Our event handler tables, indexed by event code and (for Command Complete events) by command code
+	EventHandler builtInEventHandlers[kMaxEventType + 1];
+	CommandCompleteHandler builtInCommandCompleteHandlers[kMaxCommandCode + 1];
+	std::atomic<const RegisteredEventHandler *> eventHandlers[kMaxEventType + 1];
+	std::atomic<const RegisteredCommandCompleteHandler *> commandCompleteHandlers[kMaxCommandCode + 1];
+
+	// Storage for registered handlers (see `RegisteredHandler`)
+	std::mutex registrationMutex;
+	std::list<RegisteredEventHandler> registeredEventHandlers;
+	std::list<RegisteredCommandCompleteHandler> registeredCommandCompleteHandlers;
+	std::list<AdapterStateListenerEntry> registeredAdapterStateListeners;
+
+	// Counts of events that had no handler, indexed by event code (code 0 counts out-of-range event codes)
+	std::atomic<uint64_t> unhandledEventCounts[kMaxEventType + 1];
+
+	// Connection events waiting for delivery (pushed on the event thread)
+	SpscQueue<ConnectionEvent, kMaxQueuedConnectionEvents> connectionEvents;
+	std::atomic<ConnectionEventNotifier> connectionEventNotifier;
+	std::atomic<uint64_t> droppedConnectionEvents;
 };
 
 }; // namespace ggk
\ No newline at end of file
@@ -38,6 +38,7 @@
 #include "HciSocket.h"
 #include "../include/Logger.h"
 #include "../include/Utils.h"
+#include "../include/Clock.h"
 
 namespace ggk {
 
@@ -198,15 +199,7 @@ bool HciSocket::waitForDataOrShutdown() const
 {
 	while(ggkIsServerRunning())
 	{
-		fd_set rfds;
-		FD_ZERO(&rfds);
-		FD_SET(fdSocket, &rfds);
-
-		struct timeval tv;
-		tv.tv_sec = 0;
-		tv.tv_usec = kDataWaitTimeMS * 1000;
-
-		int retval = select(fdSocket+1, &rfds, NULL, NULL, &tv);
+		int retval = Clock::getInstance().waitReadable(fdSocket, kDataWaitTimeMS);
 
 		// Do we have data?
 		if (retval > 0) { return true; }
@@ -33,20 +33,32 @@
 // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
 
 #include <gio/gio.h>
+#include <stdio.h>
+#include <string.h>
 #include <string>
 #include <vector>
 #include <atomic>
+#include <mutex>
 #include <chrono>
 #include <thread>
+#include <algorithm>
 
 #include "../include/Server.h"
 #include "../include/Globals.h"
+#include "../include/DBusBackend.h"
 #include "Mgmt.h"
 #include "HciAdapter.h"
+#include "WorkerPool.h"
+#include "OverloadController.h"
+#include "BatchController.h"
+#include "AggregationChannel.h"
+#include "PropertyChanges.h"
 #include "../include/DBusObject.h"
 #include "../include/DBusInterface.h"
 #include "../include/GattCharacteristic.h"
 #include "../include/GattProperty.h"
+#include "../include/HandlerProfiler.h"
+#include "../include/Clock.h"
 #include "../include/Logger.h"
 #include "Init.h"
 
@@ -57,8 +69,11 @@ namespace ggk {
 //
 
 static const int kPeriodicTimerFrequencySeconds = 1;
+static const uint64_t kMaxTicksPerCall = 86400; // Caps the ticks passed along after missed deadlines (a day's worth at 1 second)
 static const int kRetryDelaySeconds = 2;
+static const uint64_t kMissedDeadlineReportIntervalUS = 60 * 1000000ULL; // Warn about missed deadlines at most this often
 static const int kIdleFrequencyMS = 10;
+static const unsigned int kUpdateWorkerThreads = 0; // 0 = one per hardware thread
 
 //
 // Retries
@@ -66,26 +81,60 @@ static const int kIdleFrequencyMS = 10;
 
 static time_t retryTimeStart = 0;
 
+//
+// Missed periodic timer deadlines that haven't been reported yet (the full count is in `ggkGetTimerStats()`)
+//
+
+static uint64_t unreportedMissedDeadlines = 0;
+static uint64_t lastMissedDeadlineReportUS = 0;
+
 //
 // Adapter configuration
 //
 
 GDBusConnection *pBusConnection = nullptr;
-static guint ownedNameId = 0;
-static guint periodicTimeoutId = 0;
-static std::vector<guint> registeredObjectIds;
+static std::atomic<guint> periodicTimeoutId(0);
+static guint connectionInfoTimeoutId = 0;
+static guint overloadTimeoutId = 0;
 static std::atomic<GMainLoop *> pMainLoop(nullptr);
-static GDBusObjectManager *pBluezObjectManager = nullptr;
-static GDBusObject *pBluezAdapterObject = nullptr;
-static GDBusObject *pBluezDeviceObject = nullptr;
-static GDBusProxy *pBluezGattManagerProxy = nullptr;
-static GDBusProxy *pBluezAdapterInterfaceProxy = nullptr;
-static GDBusProxy *pBluezDeviceInterfaceProxy = nullptr;
-static GDBusProxy *pBluezAdapterPropertiesInterfaceProxy = nullptr;
 static bool bOwnedNameAcquired = false;
 static bool bAdapterConfigured = false;
 static bool bApplicationRegistered = false;
 static std::string bluezGattManagerInterfaceName = "";
+static guint adapterSubscriptionId = 0;
+
+// BlueZ's object for the first adapter (index 0), which is the one `Mgmt` configures (see `Mgmt::kDefaultControllerIndex`)
+static const char *kBluezAdapterPath = "/org/bluez/hci0";
+
+//
+// Warm restart
+//
+
+static std::atomic<bool> bRestartPending(false);
+static std::shared_ptr<Server> pRestartServer;
+static bool bRestartInProgress = false;
+
+//
+// Update processing
+//
+
+static WorkerPool updateWorkers;
+static std::atomic<bool> bUpdateBatchInFlight(false);
+
+// The computed batch waiting for the main loop to send it, and the idle source that will
+static std::mutex computedBatchMutex;
+static struct UpdateBatch *pComputedBatch = nullptr;
+static guint computedBatchSourceId = 0;
+
+//
+// Connection events
+//
+
+static std::mutex connectionCallbackMutex;
+static GGKConnectionCallback connectionCallback = nullptr;
+static void *pConnectionCallbackUserData = nullptr;
+static std::atomic<bool> bConnectionEventsScheduled(false);
+static uint64_t reportedDroppedConnectionEvents = 0; // Main loop only
 
 //
 // Externs
@@ -99,6 +148,7 @@ extern void setServerHealth(enum GGKServerHealth newHealth);
 //
 
 static void initializationStateProcessor();
+static void onAdapterStateChanged(const HciAdapter::AdapterState &state, uint32_t changedSettings, void *pUserData);
 
 // ---------------------------------------------------------------------------------------------------------------------------------
 //  ___    _ _           __      _       _                                             _
@@ -113,13 +163,113 @@ static void initializationStateProcessor();
 // for that data() sees fit.
 //
 // This is done using the `ggkPushUpdateQueue` / `ggkPopUpdateQueue` methods to manage the queue of pending update messages. Each
-// entry represents an interface that needs to be updated. The idleFunc calls the interface's `onUpdatedValue` method for each
-// update.
+// entry represents an interface that needs to be updated.
+//
+// Each idle tick starts by applying any property changes queued since the last one (see PropertyChanges.cpp.) It then drains up
+// to a batch of updates from the queue, in two stages:
 //
-// The idle processor will perform one update per idle tick, however, it will notify that there is more data so the idle ticks
-// do not lag behind.
+//     1. Characteristics with an `onComputeValue` callback are gathered into a batch. Their values are computed and encoded in
+//        parallel on our worker pool (see WorkerPool.cpp.)
+//
+//     2. Once every value in the batch is ready, the main loop sends all of the change notifications together.
+//
+// Characteristics without an `onComputeValue` callback have their `onUpdatedValue` method called directly, as they always have.
+//
+// Only one batch is in flight at a time so that notifications for a characteristic can never be sent out of order.
+//
+// The size of each batch, and how long updates may gather before a batch is taken, are tuned while we run from the measured cost
+// of sending them (see BatchController.cpp.)
+//
+// Characteristics that belong to an aggregation channel (see AggregationChannel.cpp) don't send their own notifications. Their
+// values are queued as records on the channel instead, and the channel sends them, packed together, at the end of each stage.
 // ---------------------------------------------------------------------------------------------------------------------------------
 
+// A batch of characteristic values being computed on the worker pool
+struct UpdateBatch
+{
+	// Keeps the characteristics alive if a warm restart swaps the server while the batch is in flight
+	std::shared_ptr<Server> pServer;
+
+	std::vector<std::shared_ptr<const GattCharacteristic>> characteristics;
+	std::vector<GVariant *> values;
+	std::atomic<size_t> remaining;
+	void *pUserData;
+};
+
+// Sends the change notifications for a computed batch (runs on the main loop)
+static gboolean onUpdateBatchComputed(gpointer pUserData)
+{
+	UpdateBatch *pBatch = static_cast<UpdateBatch *>(pUserData);
+	uint64_t startUS = BatchController::nowUS();
+
+	{
+		std::lock_guard<std::mutex> lock(computedBatchMutex);
+		pComputedBatch = nullptr;
+		computedBatchSourceId = 0;
+	}
+
+	for (size_t i = 0; i < pBatch->values.size(); ++i)
+	{
+		GVariant *pValue = pBatch->values[i];
+		if (nullptr == pValue)
+		{
+			continue;
+		}
+
+		if (ggkGetServerRunState() == ERunning)
+		{
+			const std::shared_ptr<const GattCharacteristic> &pCharacteristic = pBatch->characteristics[i];
+			if (!pCharacteristic->isAggregated() || !AggregationChannel::addRecord(pCharacteristic, pValue))
+			{
+				pCharacteristic->sendChangeNotificationVariant(pBusConnection, pValue);
+			}
+		}
+
+		g_variant_unref(pValue);
+	}
+
+	if (ggkGetServerRunState() == ERunning)
+	{
+		AggregationChannel::flush(pBusConnection);
+	}
+
+	BatchController::recordFlush(BatchController::nowUS() - startUS, pBatch->values.size());
+	Logger::debug(SSTR << "Sent " << pBatch->values.size() << " computed value(s)");
+
+	delete pBatch;
+	bUpdateBatchInFlight = false;
+	return FALSE;
+}
+
+// Hands a batch of characteristics to the worker pool to compute their values
+static void dispatchUpdateBatch(std::vector<std::shared_ptr<const GattCharacteristic>> &characteristics, void *pUserData)
+{
+	UpdateBatch *pBatch = new UpdateBatch();
+	pBatch->pServer = TheServer;
+	pBatch->characteristics.swap(characteristics);
+	pBatch->values.assign(pBatch->characteristics.size(), nullptr);
+	pBatch->remaining = pBatch->characteristics.size();
+	pBatch->pUserData = pUserData;
+
+	bUpdateBatchInFlight = true;
+
+	for (size_t i = 0; i < pBatch->characteristics.size(); ++i)
+	{
+		updateWorkers.submit([pBatch, i]()
+		{
+			pBatch->values[i] = pBatch->characteristics[i]->callOnComputeValue(pBatch->pUserData);
+
+			// The last one out sends the batch back to the main loop
+			if (pBatch->remaining.fetch_sub(1) == 1)
+			{
+				std::lock_guard<std::mutex> lock(computedBatchMutex);
+				pComputedBatch = pBatch;
+				computedBatchSourceId = g_idle_add(onUpdateBatchComputed, pBatch);
+			}
+		});
+	}
+}
+
 // Our idle function
 //
 // This method is used to process data on the same thread as our main loop. This allows us to communicate with our service from
@@ -130,50 +280,136 @@ static void initializationStateProcessor();
 // returning false when there is no work to do, we are nicer to the system.
 bool idleFunc(void *pUserData)
 {
-
 	// Don't do anything unless we're running
 	if (ggkGetServerRunState() != ERunning)
 	{
 		return false;
 	}
 
-	// Try to get an update
-	const int kQueueEntryLen = 1024;
-	char queueEntry[kQueueEntryLen];
-	if (ggkPopUpdateQueue(queueEntry, kQueueEntryLen, 0) != 1)
+	// Property changes go out first, one signal per interface
+	bool workPerformed = PropertyChanges::flush(pBusConnection);
+
+	// Wait for the previous batch to be sent before we take any more updates, to keep notifications in order
+	if (bUpdateBatchInFlight)
 	{
-		return false;
+		return workPerformed;
 	}
 
-	std::string entryString = queueEntry;
-	auto token = entryString.find('|');
-	if (token == std::string::npos)
+	// Let updates gather if that's what our batching controller wants
+	if (!BatchController::shouldDrain(static_cast<size_t>(ggkUpdateQueueSize())))
 	{
-		Logger::error("Queue entry was not formatted properly - could not find separating token");
-		return false;
+		return workPerformed;
 	}
 
-	DBusObjectPath objectPath = DBusObjectPath(entryString.substr(0, token));
-	std::string interfaceName = entryString.substr(token+1);
+	uint64_t startUS = BatchController::nowUS();
+	size_t sentCount = 0;
+	std::vector<std::shared_ptr<const GattCharacteristic>> batch;
 
-	// We have an update - call the onUpdatedValue method on the interface
-	std::shared_ptr<const DBusInterface> pInterface = TheServer->findInterface(objectPath, interfaceName);
-	if (nullptr == pInterface)
-	{
-		Logger::warn(SSTR << "Unable to find interface for update: path[" << objectPath << "], name[" << interfaceName << "]");
-	}
-	else
+	int batchSize = BatchController::getBatchSize();
+	for (int i = 0; i < batchSize; ++i)
 	{
+		// Try to get an update
+		const int kQueueEntryLen = 1024;
+		char queueEntry[kQueueEntryLen];
+		if (ggkPopUpdateQueue(queueEntry, kQueueEntryLen, 0) != 1)
+		{
+			break;
+		}
+
+		std::string entryString = queueEntry;
+		auto token = entryString.find('|');
+		if (token == std::string::npos)
+		{
+			Logger::error("Queue entry was not formatted properly - could not find separating token");
+			continue;
+		}
+
+		DBusObjectPath objectPath = DBusObjectPath(entryString.substr(0, token));
+		std::string interfaceName = entryString.substr(token+1);
+
+		// We have an update - find the interface it's for
+		std::shared_ptr<const DBusInterface> pInterface = TheServer->findInterface(objectPath, interfaceName);
+		if (nullptr == pInterface)
+		{
+			Logger::warn(SSTR << "Unable to find interface for update: path[" << objectPath << "], name[" << interfaceName << "]");
+			continue;
+		}
+
 		// Is it a characteristic?
-		if (std::shared_ptr<const GattCharacteristic> pCharacteristic = TRY_GET_CONST_INTERFACE_OF_TYPE(pInterface, GattCharacteristic))
+		std::shared_ptr<const GattCharacteristic> pCharacteristic = TRY_GET_CONST_INTERFACE_OF_TYPE(pInterface, GattCharacteristic);
+		if (nullptr == pCharacteristic)
 		{
-			Logger::debug(SSTR << "Processing updated value for interface '" << interfaceName << "' at path '" << objectPath << "'");
-			pCharacteristic->callOnUpdatedValue(pBusConnection, pUserData);
-			return true;
+			continue;
+		}
+
+		workPerformed = true;
+
+		// Characteristics that can compute their values off the main loop join the batch (once per batch is enough)
+		if (pCharacteristic->hasComputeValue() && updateWorkers.isRunning())
+		{
+			if (std::find(batch.begin(), batch.end(), pCharacteristic) == batch.end())
+			{
+				batch.push_back(pCharacteristic);
+			}
+
+			continue;
 		}
+
+		Logger::debug(SSTR << "Processing updated value for interface '" << interfaceName << "' at path '" << objectPath << "'");
+
+		// Without workers, computed values are computed here instead and sent the same way a computed batch is
+		if (pCharacteristic->hasComputeValue())
+		{
+			GVariant *pValue = pCharacteristic->callOnComputeValue(pUserData);
+			if (nullptr != pValue)
+			{
+				if (!pCharacteristic->isAggregated() || !AggregationChannel::addRecord(pCharacteristic, pValue))
+				{
+					pCharacteristic->sendChangeNotificationVariant(pBusConnection, pValue);
+				}
+
+				g_variant_unref(pValue);
+				sentCount += 1;
+			}
+
+			continue;
+		}
+
+		// Aggregated characteristics queue their value on their channel rather than notifying it themselves
+		if (pCharacteristic->isAggregated())
+		{
+			GVariant *pValue = pCharacteristic->readValueLocally(pBusConnection);
+			bool queued = nullptr != pValue && AggregationChannel::addRecord(pCharacteristic, pValue);
+			if (nullptr != pValue)
+			{
+				g_variant_unref(pValue);
+			}
+
+			if (queued)
+			{
+				continue;
+			}
+		}
+
+		pCharacteristic->callOnUpdatedValue(pBusConnection, pUserData);
+		sentCount += 1;
 	}
 
-	return false;
+	AggregationChannel::flush(pBusConnection);
+
+	if (sentCount > 0)
+	{
+		BatchController::recordFlush(BatchController::nowUS() - startUS, sentCount);
+	}
+
+	BatchController::drained(static_cast<size_t>(ggkUpdateQueueSize()));
+
+	if (!batch.empty())
+	{
+		dispatchUpdateBatch(batch, pUserData);
+	}
+
+	return workPerformed;
 }
 
 // ---------------------------------------------------------------------------------------------------------------------------------
@@ -192,56 +428,42 @@ void uninit()
   	// We've left our main loop - nullify its pointer so we know we're no longer running
   	pMainLoop = nullptr;
 
-	if (nullptr != pBluezAdapterObject)
-	{
-		g_object_unref(pBluezAdapterObject);
-		pBluezAdapterObject = nullptr;
-	}
+	// Let any in-flight value computations finish
+	updateWorkers.stop();
 
-	if (nullptr != pBluezDeviceObject)
+	// Our main loop is gone, so a batch that finished computing will never be sent; release it and its idle source
 	{
-		g_object_unref(pBluezDeviceObject);
-		pBluezDeviceObject = nullptr;
-	}
+		std::lock_guard<std::mutex> lock(computedBatchMutex);
+		if (nullptr != pComputedBatch)
+		{
+			g_source_remove(computedBatchSourceId);
+			for (GVariant *pValue : pComputedBatch->values)
+			{
+				if (nullptr != pValue)
+				{
+					g_variant_unref(pValue);
+				}
+			}
 
-	if (nullptr != pBluezAdapterInterfaceProxy)
-	{
-		g_object_unref(pBluezAdapterInterfaceProxy);
-		pBluezAdapterInterfaceProxy = nullptr;
-	}
+			delete pComputedBatch;
+			pComputedBatch = nullptr;
+			computedBatchSourceId = 0;
+		}
 
-	if (nullptr != pBluezDeviceInterfaceProxy)
-	{
-		g_object_unref(pBluezDeviceInterfaceProxy);
-		pBluezDeviceInterfaceProxy = nullptr;
+		bUpdateBatchInFlight = false;
 	}
 
-	if (nullptr != pBluezAdapterPropertiesInterfaceProxy)
-	{
-		g_object_unref(pBluezAdapterPropertiesInterfaceProxy);
-		pBluezAdapterPropertiesInterfaceProxy = nullptr;
-	}
+	// Stop collecting connection events and adapter state changes
+	HciAdapter::getInstance().setConnectionEventNotifier(nullptr);
+	HciAdapter::getInstance().removeAdapterStateListener(onAdapterStateChanged, nullptr);
 
-	if (nullptr != pBluezGattManagerProxy)
-	{
-		g_object_unref(pBluezGattManagerProxy);
-		pBluezGattManagerProxy = nullptr;
-	}
+	DBusBackend &backend = DBusBackend::getInstance();
 
-	if (nullptr != pBluezObjectManager)
-	{
-		g_object_unref(pBluezObjectManager);
-		pBluezObjectManager = nullptr;
-	}
+	backend.unregisterObjects();
 
-	if (!registeredObjectIds.empty())
-	{
-		for (guint id : registeredObjectIds)
-		{
-			g_dbus_connection_unregister_object(pBusConnection, id);
-		}
-		registeredObjectIds.clear();
-	}
+	// Drop any property changes that never made it out, and our aggregation channels
+	PropertyChanges::clear();
+	AggregationChannel::clear();
 
 	if (0 != periodicTimeoutId)
 	{
@@ -249,17 +471,33 @@ void uninit()
 		periodicTimeoutId = 0;
 	}
 
-  	if (ownedNameId > 0)
-  	{
-		g_bus_unown_name(ownedNameId);
+	if (0 != connectionInfoTimeoutId)
+	{
+		g_source_remove(connectionInfoTimeoutId);
+		connectionInfoTimeoutId = 0;
+	}
+
+	if (0 != overloadTimeoutId)
+	{
+		g_source_remove(overloadTimeoutId);
+		overloadTimeoutId = 0;
 	}
 
-	if (nullptr != pBusConnection)
+	if (0 != adapterSubscriptionId)
 	{
-		g_object_unref(pBusConnection);
-		pBusConnection = nullptr;
+		backend.unsubscribeSignal(adapterSubscriptionId);
+		adapterSubscriptionId = 0;
 	}
 
+	backend.unownName();
+	backend.releaseBus();
+	pBusConnection = nullptr;
+
+	// Release anybody waiting on a restart that will never finish
+	pRestartServer = nullptr;
+	bRestartInProgress = false;
+	bRestartPending = false;
+
 	if (nullptr != pMainLoop)
 	{
 		g_main_loop_unref(pMainLoop);
@@ -301,6 +539,220 @@ void shutdown()
 	}
 }
 
+// ---------------------------------------------------------------------------------------------------------------------------------
+// __        __                                     _             _
+// \ \      / /_ _ _ __ _ __ ___    _ __ ___  ___| |_ __ _ _ __| |_
+//  \ \ /\ / / _` | '__| '_ ` _ \  | '__/ _ \/ __| __/ _` | '__| __|
+//   \ V  V / (_| | |  | | | | | | | | |  __/\__ \ || (_| | |  | |_
+//    \_/\_/ \__,_|_|  |_| |_| |_| |_|  \___||___/\__\__,_|_|   \__|
+//
+// A warm restart replaces the server description (`TheServer`) without tearing down the bus connection, our owned name or the
+// adapter configuration. We unregister our application from BlueZ, swap in the new server, then let the initialization state
+// processor register the new object tree and application, exactly as it did during startup.
+// ---------------------------------------------------------------------------------------------------------------------------------
+
+// Completes a warm restart
+//
+// Called from the initialization state processor once the new object tree is registered with BlueZ
+static void finishRestart()
+{
+	bRestartInProgress = false;
+	bRestartPending = false;
+	Logger::info("Warm restart complete");
+}
+
+// Swaps in the new server and steps through the remainder of the initialization process to register it
+static void doRestartSwap()
+{
+	DBusBackend::getInstance().unregisterObjects();
+
+	std::atomic_store(&TheServer, pRestartServer);
+	pRestartServer = nullptr;
+	bRestartInProgress = true;
+
+	// Aggregation channels the new server doesn't have would still hold the old server's paths
+	AggregationChannel::removeStale();
+
+	// Property changes queued against the old tree would overwrite the new configurator's values at the same paths
+	PropertyChanges::clear();
+
+	// Keep going...
+	initializationStateProcessor();
+}
+
+// Begins a warm restart on the main loop (scheduled by `requestRestart()`)
+static gboolean onRestartRequested(gpointer /*pUserData*/)
+{
+	if (ggkGetServerRunState() != ERunning)
+	{
+		pRestartServer = nullptr;
+		bRestartPending = false;
+		return FALSE;
+	}
+
+	Logger::info("Warm restart: replacing the server description");
+
+	// Stop ticking the old object tree while it's being replaced
+	bool wasRegistered = bApplicationRegistered;
+	bApplicationRegistered = false;
+
+	if (!wasRegistered)
+	{
+		doRestartSwap();
+		return FALSE;
+	}
+
+	DBusBackend::getInstance().callMethod
+	(
+		"org.bluez",                                  // Bus name
+		DBusObjectPath(bluezGattManagerInterfaceName), // Object path
+		"org.bluez.GattManager1",                     // Interface name
+		"UnregisterApplication",                      // Method name
+		g_variant_new("(o)", "/"),                    // Parameters
+
+		// Reply callback
+		[] (GVariant *pReply, const char *pErrorMessage, void * /*pUserData*/)
+		{
+			if (nullptr == pReply)
+			{
+				Logger::warn(SSTR << "Failed to unregister application during warm restart: " << pErrorMessage);
+			}
+
+			if (ggkGetServerRunState() == ERunning)
+			{
+				doRestartSwap();
+			}
+		},
+
+		nullptr                                       // User data
+	);
+
+	return FALSE;
+}
+
+// Request a warm restart of a running server, replacing `TheServer` with `pNewServer`
+//
+// The bus connection, owned name and adapter configuration are kept. Only the GATT object tree is replaced and re-registered with
+// BlueZ. This method is non-blocking; use `isRestartPending()` to wait for completion.
+//
+// Returns false if the server isn't running or a restart is already in progress
+bool requestRestart(std::shared_ptr<Server> pNewServer)
+{
+	if (nullptr == pNewServer || ggkGetServerRunState() != ERunning)
+	{
+		return false;
+	}
+
+	bool expected = false;
+	if (!bRestartPending.compare_exchange_strong(expected, true))
+	{
+		Logger::warn("Ignoring restart request (a restart is already in progress)");
+		return false;
+	}
+
+	// This is handed to the main loop through g_idle_add(), which synchronizes with it
+	pRestartServer = pNewServer;
+	if (0 == g_idle_add(onRestartRequested, nullptr))
+	{
+		pRestartServer = nullptr;
+		bRestartPending = false;
+		return false;
+	}
+
+	return true;
+}
+
+// Returns true while a warm restart is in progress
+bool isRestartPending()
+{
+	return bRestartPending;
+}
+
+// ---------------------------------------------------------------------------------------------------------------------------------
+//   ____                            _   _                                        _
+//  / ___|___  _ __  _ __   ___  ___| |_(_) ___  _ __     _____   _____ _ __ | |_ ___
+// | |   / _ \| '_ \| '_ \ / _ \/ __| __| |/ _ \| '_ \   / _ \ \ / / _ \ '_ \| __/ __|
+// | |__| (_) | | | | | | |  __/ (__| |_| | (_) | | | | |  __/\ V /  __/ | | | |_\__ )
+//  \____\___/|_| |_|_| |_|\___|\___|\__|_|\___/|_| |_|  \___| \_/ \___|_| |_|\__|___/
+//
+// Connections and disconnections are parsed on the HciAdapter's event thread, which must never run application code (it would
+// hold up every other adapter event.) Instead, the event thread pushes each event onto a lock-free queue in the HciAdapter and
+// calls our notifier, which schedules a single idle callback on the main loop. That callback drains everything queued so far
+// and hands it to the application as one batch. A burst of connections therefore costs one main loop dispatch, not one each.
+// ---------------------------------------------------------------------------------------------------------------------------------
+
+// Sets the application's connection event callback (see `ggkRegisterConnectionCallback()`)
+void setConnectionCallback(GGKConnectionCallback callback, void *pUserData)
+{
+	std::lock_guard<std::mutex> guard(connectionCallbackMutex);
+	connectionCallback = callback;
+	pConnectionCallbackUserData = pUserData;
+}
+
+// Delivers the queued connection events to the application in one batch (runs on the main loop)
+static gboolean onConnectionEvents(gpointer /*pUserData*/)
+{
+	// Clear this first, so events queued while we deliver this batch schedule another one
+	bConnectionEventsScheduled = false;
+
+	std::vector<GGKConnectionEvent> batch;
+	HciAdapter::ConnectionEvent event;
+	while (HciAdapter::getInstance().popConnectionEvent(event))
+	{
+		GGKConnectionEvent connectionEvent;
+		connectionEvent.connected = event.connected ? 1 : 0;
+		snprintf(connectionEvent.address, sizeof(connectionEvent.address), "%s", event.getAddressString().c_str());
+		connectionEvent.addressType = event.addressType;
+		connectionEvent.reason = event.reason;
+		batch.push_back(connectionEvent);
+
+		// A client that's gone no longer limits the size of aggregation frames
+		if (!event.connected)
+		{
+			AggregationChannel::forgetClient(connectionEvent.address);
+		}
+	}
+
+	// Events are only dropped while the queue is full, so each drain is a good time to report any that were
+	uint64_t droppedEvents = HciAdapter::getInstance().getDroppedConnectionEventCount();
+	if (droppedEvents > reportedDroppedConnectionEvents)
+	{
+		Logger::warn(SSTR << (droppedEvents - reportedDroppedConnectionEvents) << " connection event(s) dropped since the last report; "
+			<< "the main loop is not keeping up with them");
+		reportedDroppedConnectionEvents = droppedEvents;
+	}
+
+	if (batch.empty())
+	{
+		return FALSE;
+	}
+
+	GGKConnectionCallback callback;
+	void *pUserData;
+	{
+		std::lock_guard<std::mutex> guard(connectionCallbackMutex);
+		callback = connectionCallback;
+		pUserData = pConnectionCallbackUserData;
+	}
+
+	Logger::debug(SSTR << "Delivering " << batch.size() << " connection event(s)");
+	if (nullptr != callback)
+	{
+		callback(batch.data(), static_cast<int>(batch.size()), pUserData);
+	}
+
+	return FALSE;
+}
+
+// Called on the HciAdapter's event thread each time a connection event is queued
+static void onConnectionEventQueued()
+{
+	if (!bConnectionEventsScheduled.exchange(true))
+	{
+		g_idle_add(onConnectionEvents, nullptr);
+	}
+}
+
 // ---------------------------------------------------------------------------------------------------------------------------------
 //  ____           _           _ _        _   _
 // |  _ \ ___ _ __(_) ___   __| (_) ___  | |_(_)_ __ ___   ___ _ __
@@ -314,7 +766,11 @@ void shutdown()
 //
 // A periodic timer is a timer fires every so often (see kPeriodicTimerFrequencySeconds.) This is used for our initialization
 // failure retries, but custom code can also be added to a server description (see `onEvent()`)
-gboolean onPeriodicTimer(gpointer pUserData)
+//
+// The timer's deadlines sit on a fixed grid (see `Clock::addPeriodicTimer()`). If we fell behind and `missed` deadlines went by,
+// we tick once for all of them, which keeps tick events on their own grid (see `TickEvent::tick()`.) A main loop that keeps falling
+// behind would miss deadlines on every call, so those are only logged once per kMissedDeadlineReportIntervalUS.
+gboolean onPeriodicTimer(uint64_t deadlineUS, uint64_t missed, gpointer pUserData)
 {
 	// If we're shutting down, don't do anything and stop the periodic timer
 	if (ggkGetServerRunState() > ERunning)
@@ -322,13 +778,22 @@ gboolean onPeriodicTimer(gpointer pUserData)
 		return FALSE;
 	}
 
+	unreportedMissedDeadlines += missed;
+	bool bReportDue = 0 == lastMissedDeadlineReportUS || deadlineUS - lastMissedDeadlineReportUS >= kMissedDeadlineReportIntervalUS;
+	if (unreportedMissedDeadlines > 0 && bReportDue)
+	{
+		Logger::warn(SSTR << "The periodic timer missed " << unreportedMissedDeadlines << " deadline(s) since the last report");
+		unreportedMissedDeadlines = 0;
+		lastMissedDeadlineReportUS = deadlineUS;
+	}
+
 	// Deal with retry timers
 	if (0 != retryTimeStart)
 	{
 		Logger::debug(SSTR << "Ticking retry timer");
 
 		// Has the retry time expired?
-		int secondsRemaining = time(nullptr) - retryTimeStart - kRetryDelaySeconds;
+		int secondsRemaining = Clock::getInstance().getWallTime() - retryTimeStart - kRetryDelaySeconds;
 		if (secondsRemaining >= 0)
 		{
 			retryTimeStart = 0;
@@ -347,7 +812,7 @@ gboolean onPeriodicTimer(gpointer pUserData)
 		{
 			if (object.isPublished())
 			{
-				object.tickEvents(pBusConnection, pUserData);
+				object.tickEvents(pBusConnection, pUserData, static_cast<int>(std::min<uint64_t>(missed + 1, kMaxTicksPerCall)));
 			}
 		}
 	}
@@ -355,6 +820,53 @@ gboolean onPeriodicTimer(gpointer pUserData)
 	return TRUE;
 }
 
+// Copies the measurements of the periodic timer that drives tick events into `stats`
+//
+// Returns false if the timer isn't running
+bool getPeriodicTimerStats(PeriodicTimerStats &stats)
+{
+	guint sourceId = periodicTimeoutId;
+	return 0 != sourceId && Clock::getPeriodicTimerStats(sourceId, stats);
+}
+
+// Connection information timer handler
+//
+// Polls the adapter for the link quality (RSSI and TX power) of each connected device. This only sends the requests; the results
+// arrive on the HciAdapter's event thread, so the main loop never waits on the adapter. See `getConnectionInfoPollIntervalMS()`
+// in Server.h to configure the interval.
+gboolean onConnectionInfoTimer(gpointer /*pUserData*/)
+{
+	// If we're shutting down, don't do anything and stop the timer
+	if (ggkGetServerRunState() > ERunning)
+	{
+		connectionInfoTimeoutId = 0;
+		return FALSE;
+	}
+
+	if (bApplicationRegistered && HciAdapter::getInstance().getActiveConnectionCount() > 0)
+	{
+		HciAdapter::getInstance().requestConnectionInformation();
+	}
+
+	return TRUE;
+}
+
+// Samples the load on the main loop so the server can shed work when it falls behind (see OverloadController.cpp) and retune its
+// notification batching (see BatchController.cpp)
+gboolean onOverloadTimer(gpointer /*pUserData*/)
+{
+	// If we're shutting down, don't do anything and stop the timer
+	if (ggkGetServerRunState() > ERunning)
+	{
+		overloadTimeoutId = 0;
+		return FALSE;
+	}
+
+	OverloadController::sample(static_cast<size_t>(ggkUpdateQueueSize()));
+	BatchController::sample();
+	return TRUE;
+}
+
 // ---------------------------------------------------------------------------------------------------------------------------------
 //  _____                 _
 // | ____|_   _____ _ __ | |_ ___
@@ -382,10 +894,18 @@ void onMethodCall
 	// Convert our input path into our custom type for path management
 	DBusObjectPath objectPath(pObjectPath);
 
+	// When the server is badly overloaded, turn reads away quickly rather than let them time out behind everything else
+	if (0 == strcmp(pMethodName, "ReadValue") && OverloadController::shouldRejectRead())
+	{
+		Logger::debug(SSTR << "Rejecting read while overloaded: [" << objectPath << "]:[" << pInterfaceName << "]");
+		DBusBackend::getInstance().methodReturnError(pInvocation, "org.bluez.Error.InProgress", "Server is busy");
+		return;
+	}
+
 	if (!TheServer->callMethod(objectPath, pInterfaceName, pMethodName, pConnection, pParameters, pInvocation, pUserData))
 	{
 		Logger::error(SSTR << " + Method not found: [" << pSender << "]:[" << objectPath << "]:[" << pInterfaceName << "]:[" << pMethodName << "]");
-		g_dbus_method_invocation_return_dbus_error(pInvocation, kErrorNotImplemented.c_str(), "This method is not implemented");
+		DBusBackend::getInstance().methodReturnError(pInvocation, kErrorNotImplemented, "This method is not implemented");
 		return;
 	}
 
@@ -417,6 +937,12 @@ GVariant *onGetProperty
 		return nullptr;
 	}
 
+	// Properties without a getter report their stored value (which reflects any changes made with `updatePropertyVariant()`)
+	if (!pProperty->getGetterFunc() && nullptr != pProperty->getValue())
+	{
+		return g_variant_ref(const_cast<GVariant *>(pProperty->getValue()));
+	}
+
 	if (!pProperty->getGetterFunc())
 	{
 		Logger::error(SSTR << "Property(get) func not found: " << propertyPath);
@@ -425,6 +951,7 @@ GVariant *onGetProperty
 	}
 
 	Logger::info(SSTR << "Calling property getter: " << propertyPath);
+	HandlerProfiler::Scope profile(HandlerProfiler::EPropertyGet, pObjectPath, pPropertyName);
 	GVariant *pResult = pProperty->getGetterFunc()(pConnection, pSender, objectPath.c_str(), pInterfaceName, pPropertyName, ppError, pUserData);
 
 	if (nullptr == pResult)
@@ -469,7 +996,8 @@ gboolean onSetProperty
 		return false;
 	}
 
-	Logger::info(SSTR << "Calling property getter: " << propertyPath);
+	Logger::info(SSTR << "Calling property setter: " << propertyPath);
+	HandlerProfiler::Scope profile(HandlerProfiler::EPropertySet, pObjectPath, pPropertyName);
 	if (!pProperty->getSetterFunc()(pConnection, pSender, objectPath.c_str(), pInterfaceName, pPropertyName, pValue, ppError, pUserData))
 	{
 	    g_set_error(ppError, G_IO_ERROR, G_IO_ERROR_FAILED, ("Property(set) failed: " + propertyPath).c_str(), pSender);
@@ -492,7 +1020,7 @@ gboolean onSetProperty
 // Convenience method for setting a retry timer so that operations can be continuously retried until we eventually succeed
 void setRetry()
 {
-	retryTimeStart = time(nullptr);
+	retryTimeStart = Clock::getInstance().getWallTime();
 }
 
 // Convenience method for setting a retry timer so that failures (related to initialization) can be continuously retried until we
@@ -513,35 +1041,31 @@ void setRetryFailure()
 //
 // ---------------------------------------------------------------------------------------------------------------------------------
 
-// Use the BlueZ GATT Manager proxy to register our GATT application with BlueZ
+// Use the BlueZ GATT Manager to register our GATT application with BlueZ
 void doRegisterApplication()
 {
 	g_auto(GVariantBuilder) builder;
 	g_variant_builder_init(&builder, G_VARIANT_TYPE("a{sv}"));
 	GVariant *pParams = g_variant_new("(oa{sv})", "/", &builder);
 
-	g_dbus_proxy_call
+	DBusBackend::getInstance().callMethod
 	(
-		pBluezGattManagerProxy,         // GDBusProxy *proxy
-		"RegisterApplication",          // const gchar *method_name   (ex: "GetManagedObjects")
-		pParams,                        // GVariant *parameters
-		G_DBUS_CALL_FLAGS_NONE,         // GDBusCallFlags flags
-		-1,                             // gint timeout_msec
-		nullptr,                        // GCancellable *cancellable
-
-		// GAsyncReadyCallback callback
-		[] (GObject * /*pSourceObject*/, GAsyncResult *pAsyncResult, gpointer /*pUserData*/)
+		"org.bluez",                                  // Bus name
+		DBusObjectPath(bluezGattManagerInterfaceName), // Object path
+		"org.bluez.GattManager1",                     // Interface name
+		"RegisterApplication",                        // Method name
+		pParams,                                      // Parameters
+
+		// Reply callback
+		[] (GVariant *pReply, const char *pErrorMessage, void * /*pUserData*/)
 		{
-			GError *pError = nullptr;
-			GVariant *pVariant = g_dbus_proxy_call_finish(pBluezGattManagerProxy, pAsyncResult, &pError);
-			if (nullptr == pVariant)
+			if (nullptr == pReply)
 			{
-				Logger::error(SSTR << "Failed to register application: " << (nullptr == pError ? "Unknown" : pError->message));
+				Logger::error(SSTR << "Failed to register application: " << pErrorMessage);
 				setRetryFailure();
 			}
 			else
 			{
-				g_variant_unref(pVariant);
 				Logger::debug(SSTR << "GATT application registered with BlueZ");
 				bApplicationRegistered = true;
 			}
@@ -550,7 +1074,7 @@ void doRegisterApplication()
 			initializationStateProcessor();
 		},
 
-		nullptr                         // gpointer user_data
+		nullptr                                       // User data
 	);
 }
 
@@ -566,85 +1090,22 @@ void doRegisterApplication()
 // use an XML description of our D-Bus objects.
 // ---------------------------------------------------------------------------------------------------------------------------------
 
-void registerNodeHierarchy(GDBusNodeInfo *pNode, const DBusObjectPath &basePath = DBusObjectPath(), int depth = 1)
+void registerObjects()
 {
-	std::string prefix;
-	prefix.insert(0, depth * 2, ' ');
-
-	static GDBusInterfaceVTable interfaceVtable;
-	interfaceVtable.method_call = onMethodCall;
-	interfaceVtable.get_property = onGetProperty;
-	interfaceVtable.set_property = onSetProperty;
-
-	GDBusInterfaceInfo **ppInterface = pNode->interfaces;
+	static const DBusBackend::Dispatch dispatch = { onMethodCall, onGetProperty, onSetProperty };
 
-	Logger::debug(SSTR << prefix << "+ " << pNode->path);
-
-	while(nullptr != *ppInterface)
+	// Register each object's hierarchy with the bus
+	for (const DBusObject &object : TheServer->getObjects())
 	{
-		GError *pError = nullptr;
-		Logger::debug(SSTR << prefix << "    (iface: " << (*ppInterface)->name << ")");
-		guint registeredObjectId = g_dbus_connection_register_object
-		(
-			pBusConnection,             // GDBusConnection *connection
-			basePath.c_str(),           // const gchar *object_path
-			*ppInterface,               // GDBusInterfaceInfo *interface_info
-			&interfaceVtable,           // const GDBusInterfaceVTable *vtable
-			nullptr,                    // gpointer user_data
-			nullptr,                    // GDestroyNotify user_data_free_func
-			&pError                     // GError **error
-		);
-
-		if (0 == registeredObjectId)
+		if (!DBusBackend::getInstance().registerObject(object, dispatch))
 		{
-			Logger::error(SSTR << "Failed to register object: " << (nullptr == pError ? "Unknown" : pError->message));
-
 			// Cleanup and pretend like we were never here
-			g_dbus_node_info_unref(pNode);
-			registeredObjectIds.clear();
+			DBusBackend::getInstance().unregisterObjects();
 
 			// Try again later
 			setRetryFailure();
 			return;
 		}
-
-		// Save the registered object Id so we can clean it up later
-		registeredObjectIds.push_back(registeredObjectId);
-
-		++ppInterface;
-	}
-
-	GDBusNodeInfo **ppChild = pNode->nodes;
-	while(nullptr != *ppChild)
-	{
-		registerNodeHierarchy(*ppChild, basePath + (*ppChild)->path, depth + 1);
-
-		++ppChild;
-	}
-}
-
-void registerObjects()
-{
-	// Parse each object into an XML interface tree
-	for (const DBusObject &object : TheServer->getObjects())
-	{
-		GError *pError = nullptr;
-		std::string xmlString = object.generateIntrospectionXML();
-		GDBusNodeInfo *pNode = g_dbus_node_info_new_for_xml(xmlString.c_str(), &pError);
-		if (nullptr == pNode)
-		{
-			Logger::error(SSTR << "Failed to introspect XML: " << (nullptr == pError ? "Unknown" : pError->message));
-			setRetryFailure();
-			return;
-		}
-
-		Logger::debug(SSTR << "Registering object hierarchy with D-Bus hierarchy");
-
-		// Register the node hierarchy
-		registerNodeHierarchy(pNode, DBusObjectPath(pNode->path));
-
-		// Cleanup the node
-		g_dbus_node_info_unref(pNode);
 	}
 
 	// Keep going
@@ -779,132 +1240,134 @@ void configureAdapter()
 //
 // ---------------------------------------------------------------------------------------------------------------------------------
 
-// Find the BlueZ's GATT Manager interface for the *first* Bluetooth adapter provided by BlueZ. We'll need this to register our
-// GATT server with BlueZ.
-void findAdapterInterface()
+// Called when BlueZ adds interfaces to our adapter's object
+//
+// Our subscription only matches signals for the adapter itself, so remote devices coming and going never wake us up. If we're
+// still waiting for the adapter, there's no need to wait out the retry delay: try again now.
+void onAdapterInterfacesAdded(const char * /*pObjectPath*/, GVariant * /*pParameters*/, void * /*pUserData*/)
 {
-	// Get a list of the BlueZ's D-Bus objects
-	GList *pObjects = g_dbus_object_manager_get_objects(pBluezObjectManager);
-	if (nullptr == pObjects)
+	if (!bluezGattManagerInterfaceName.empty() || 0 == retryTimeStart)
 	{
-		Logger::error(SSTR << "Unable to get ObjectManager objects");
-		setRetryFailure();
 		return;
 	}
 
-	// Scan the list of objects we find one with a GATT manager interface
-	//
-	// Note that if there are multiple interfaces, we will only find the first
-	for (guint i = 0; i < g_list_length(pObjects) && bluezGattManagerInterfaceName.empty(); ++i)
-	{
-		// Current object in question
-		pBluezAdapterObject = static_cast<GDBusObject *>(g_list_nth_data(pObjects, i));
-		if (nullptr == pBluezAdapterObject) { continue; }
-
-		// See if it has a GATT manager interface
-		pBluezGattManagerProxy = reinterpret_cast<GDBusProxy *>(g_dbus_object_get_interface(pBluezAdapterObject, "org.bluez.GattManager1"));
-		if (nullptr == pBluezGattManagerProxy) { continue; }
-
-		// Get the interface proxy for this adapter - this will come in handy later
-		pBluezAdapterInterfaceProxy = reinterpret_cast<GDBusProxy *>(g_dbus_object_get_interface(pBluezAdapterObject, "org.bluez.Adapter1"));
-		if (nullptr == pBluezAdapterInterfaceProxy)
-		{
-			Logger::warn(SSTR << "Failed to get adapter proxy for interface 'org.bluez.Adapter1'");
-			continue;
-		}
-
-		// Get the interface proxy for this adapter's properties - this will come in handy later
-		pBluezAdapterPropertiesInterfaceProxy = reinterpret_cast<GDBusProxy *>(g_dbus_object_get_interface(pBluezAdapterObject, "org.freedesktop.DBus.Properties"));
-		if (nullptr == pBluezAdapterPropertiesInterfaceProxy)
-		{
-			Logger::warn(SSTR << "Failed to get adapter properties proxy for interface 'org.freedesktop.DBus.Properties'");
-			continue;
-		}
+	Logger::info(SSTR << "BlueZ adapter '" << kBluezAdapterPath << "' appeared");
+	retryTimeStart = 0;
+	initializationStateProcessor();
+}
 
-		// Finally, save off the interface name, we're done!
-		bluezGattManagerInterfaceName = g_dbus_proxy_get_object_path(pBluezGattManagerProxy);
-		break;
+// Called on the main loop after the adapter was powered on
+//
+// If we're waiting to retry configuring the adapter, there's no need to wait out the retry delay: try again now.
+static gboolean onAdapterPowered(gpointer /*pUserData*/)
+{
+	if (bAdapterConfigured || 0 == retryTimeStart || ggkGetServerRunState() > ERunning)
+	{
+		return FALSE;
 	}
 
-	// Get a fresh copy of our objects so we can release the entire list
-	pBluezAdapterObject = g_dbus_object_manager_get_object(pBluezObjectManager, g_dbus_object_get_object_path(pBluezAdapterObject));
-
-	// We'll need access to the device object so we can set properties on it
-	pBluezDeviceObject = g_dbus_object_manager_get_object(pBluezObjectManager, g_dbus_object_get_object_path(pBluezAdapterObject));
+	Logger::info("The adapter was powered on; retrying now");
+	retryTimeStart = 0;
+	initializationStateProcessor();
+	return FALSE;
+}
 
-	// Cleanup the list
-	for (guint i = 0; i < g_list_length(pObjects) && bluezGattManagerInterfaceName.empty(); ++i)
+// Called on the HciAdapter's event thread each time a new adapter state is published
+//
+// We only care about the adapter being powered on (by an rfkill unblock, for example) while we're waiting to retry.
+static void onAdapterStateChanged(const HciAdapter::AdapterState &state, uint32_t changedSettings, void * /*pUserData*/)
+{
+	if (0 != (changedSettings & HciAdapter::EHciPowered) && 0 != (state.settings.masks & HciAdapter::EHciPowered))
 	{
-		g_object_unref(g_list_nth_data(pObjects, i));
+		g_idle_add(onAdapterPowered, nullptr);
 	}
+}
 
-	g_list_free(pObjects);
+// Verify that the adapter has a GATT manager. This is the last step in finding the adapter.
+void findGattManagerInterface()
+{
+	DBusBackend::getInstance().callMethod
+	(
+		"org.bluez",                            // Bus name
+		DBusObjectPath(kBluezAdapterPath),      // Object path
+		"org.freedesktop.DBus.Properties",      // Interface name
+		"GetAll",                               // Method name
+		g_variant_new("(s)", "org.bluez.GattManager1"), // Parameters
+
+		// Reply callback
+		[] (GVariant *pReply, const char *pErrorMessage, void * /*pUserData*/)
+		{
+			if (nullptr == pReply)
+			{
+				Logger::error(SSTR << "Unable to find the GATT manager interface 'org.bluez.GattManager1' on '" << kBluezAdapterPath << "': " << pErrorMessage);
+				setRetryFailure();
+				return;
+			}
 
-	// If we didn't find the adapter object, reset things and we'll try again later
-	if (nullptr == pBluezAdapterObject || nullptr == pBluezDeviceObject)
-	{
-		Logger::warn(SSTR << "Unable to find BlueZ objects outside of object list");
-		bluezGattManagerInterfaceName.clear();
-	}
+			// Finally, save off the interface name, we're done!
+			bluezGattManagerInterfaceName = kBluezAdapterPath;
 
-	// If we never ended up with an interface name, bail now
-	if (bluezGattManagerInterfaceName.empty())
-	{
-		Logger::error(SSTR << "Unable to find the adapter");
-		setRetryFailure();
-		return;
-	}
+			// Keep going
+			initializationStateProcessor();
+		},
 
-	// Keep going
-	initializationStateProcessor();
+		nullptr                                 // User data
+	);
 }
 
-// ---------------------------------------------------------------------------------------------------------------------------------
-//  ____  _            _____   ___  _     _           _   __  __
-// | __ )| |_   _  ___|__  /  / _ \| |__ (_) ___  ___| |_|  \/  | __ _ _ __   __ _  __ _  ___ _ __
-// |  _ \| | | | |/ _ \ / /  | | | | '_ \| |/ _ \/ __| __| |\/| |/ _` | '_ \ / _` |/ _` |/ _ \ '__|
-// | |_) | | |_| |  __// /_  | |_| | |_) | |  __/ (__| |_| |  | | (_| | | | | (_| | (_| |  __/ |
-// |____/|_|\__,_|\___/____|  \___/|_.__// |\___|\___|\__|_|  |_|\__,_|_| |_|\__,_|\__, |\___|_|
-//                                     |__/                                        |___/
+// Find the BlueZ's GATT Manager interface for the *first* Bluetooth adapter provided by BlueZ. We'll need this to register our
+// GATT server with BlueZ.
 //
-// ---------------------------------------------------------------------------------------------------------------------------------
-
-// Get the D-Bus Object Manager client to the BlueZ ObjectManager object
+// We only ever talk to the adapter's own object: we ask for its properties on 'org.bluez.Adapter1' and then 'org.bluez.GattManager1'
+// (either call fails if the object or interface doesn't exist.) We never ask BlueZ's ObjectManager for its full list of objects,
+// which includes every remote device BlueZ has seen and can be very large in a busy RF environment.
 //
-// An ObjectManager allows us to find out what objects (and from those, interfaces, etc.) are available from an owned name. We'll
-// use this to interrogate BlueZ's objects to find an adapter we can use, among other things.
-void getBluezObjectManager()
+// If the adapter isn't there yet, we watch for BlueZ adding it (see `onAdapterInterfacesAdded()`.)
+void findAdapterInterface()
 {
-	g_dbus_object_manager_client_new
-	(
-		pBusConnection,                             // GDBusConnection
-		G_DBUS_OBJECT_MANAGER_CLIENT_FLAGS_NONE,    // GDBusObjectManagerClientFlags
-		"org.bluez",                                // Owner name (or well-known name)
-		"/",                                        // Object path
-		nullptr,                                    // GDBusProxyTypeFunc get_proxy_type_func
-		nullptr,                                    // gpointer get_proxy_type_user_data
-		nullptr,                                    // GDestroyNotify get_proxy_type_destroy_notify
-		nullptr,                                    // GCancellable *cancellable
-
-		// GAsyncReadyCallback callback
-		[] (GObject * /*pSourceObject*/, GAsyncResult *pAsyncResult, gpointer /*pUserData*/)
+	DBusBackend &backend = DBusBackend::getInstance();
+
+	if (0 == adapterSubscriptionId)
+	{
+		adapterSubscriptionId = backend.subscribeSignal
+		(
+			"org.bluez",                            // Bus name
+			"org.freedesktop.DBus.ObjectManager",   // Interface name
+			"InterfacesAdded",                      // Signal name
+			DBusObjectPath(kBluezAdapterPath),      // First argument (the object path that gained interfaces)
+			onAdapterInterfacesAdded,               // Callback
+			nullptr                                 // User data
+		);
+
+		if (0 == adapterSubscriptionId)
 		{
-			// Store BlueZ's ObjectManager
-			GError *pError = nullptr;
-			pBluezObjectManager = g_dbus_object_manager_client_new_finish(pAsyncResult, &pError);
+			Logger::warn(SSTR << "Unable to watch for the adapter to appear; will poll for it instead");
+		}
+	}
 
-			if (nullptr == pBluezObjectManager)
+	backend.callMethod
+	(
+		"org.bluez",                            // Bus name
+		DBusObjectPath(kBluezAdapterPath),      // Object path
+		"org.freedesktop.DBus.Properties",      // Interface name
+		"GetAll",                               // Method name
+		g_variant_new("(s)", "org.bluez.Adapter1"), // Parameters
+
+		// Reply callback
+		[] (GVariant *pReply, const char *pErrorMessage, void * /*pUserData*/)
+		{
+			if (nullptr == pReply)
 			{
-				Logger::error(SSTR << "Failed to get an ObjectManager client: " << (nullptr == pError ? "Unknown" : pError->message));
+				Logger::error(SSTR << "Unable to find the adapter '" << kBluezAdapterPath << "': " << pErrorMessage);
 				setRetryFailure();
 				return;
 			}
 
 			// Keep going
-			initializationStateProcessor();
+			findGattManagerInterface();
 		},
 
-		nullptr                                     // gpointer user_data
+		nullptr                                 // User data
 	);
 }
 
@@ -927,17 +1390,17 @@ void doOwnedNameAcquire()
 	// Our name is not presently lost
 	bOwnedNameAcquired = false;
 
-	ownedNameId = g_bus_own_name_on_connection
+	bool result = DBusBackend::getInstance().ownName
 	(
-		pBusConnection,                    // GDBusConnection *connection
-		TheServer->getOwnedName().c_str(), // const gchar *name
-		G_BUS_NAME_OWNER_FLAGS_NONE,       // GBusNameOwnerFlags flags
+		TheServer->getOwnedName(),
 
-		// GBusNameAcquiredCallback name_acquired_handler
-		[](GDBusConnection *, const gchar *, gpointer)
+		// Name acquired
+		[](const char *)
 		{
 			// Handy way to get periodic activity
-			periodicTimeoutId = g_timeout_add_seconds(kPeriodicTimerFrequencySeconds, onPeriodicTimer, pBusConnection);
+			unreportedMissedDeadlines = 0;
+			lastMissedDeadlineReportUS = 0;
+			periodicTimeoutId = Clock::getInstance().addPeriodicTimer(kPeriodicTimerFrequencySeconds * 1000000ULL, onPeriodicTimer, pBusConnection);
 			if (periodicTimeoutId <= 0)
 			{
 				Logger::fatal(SSTR << "Failed to add a periodic timer");
@@ -945,6 +1408,21 @@ void doOwnedNameAcquire()
 				shutdown();
 			}
 
+			// Link quality polling is optional
+			int pollIntervalMS = TheServer->getConnectionInfoPollIntervalMS();
+			if (0 == connectionInfoTimeoutId && pollIntervalMS > 0)
+			{
+				connectionInfoTimeoutId = Clock::getInstance().addTimeout(pollIntervalMS, onConnectionInfoTimer, nullptr);
+			}
+
+			// Watch our own load (this stays on real time, as it measures the real main loop)
+			if (0 == overloadTimeoutId)
+			{
+				OverloadController::reset();
+				BatchController::reset();
+				overloadTimeoutId = g_timeout_add(OverloadController::kSampleIntervalMS, onOverloadTimer, nullptr);
+			}
+
 			// Bus name acquired
 			bOwnedNameAcquired = true;
 
@@ -952,8 +1430,8 @@ void doOwnedNameAcquire()
 			initializationStateProcessor();
 		},
 
-		// GBusNameLostCallback name_lost_handler
-		[](GDBusConnection *, const gchar *, gpointer)
+		// Name lost
+		[](const char *)
 		{
 			// Bus name lost
 			bOwnedNameAcquired = false;
@@ -974,11 +1452,15 @@ void doOwnedNameAcquire()
 
 			// Keep going...
 			initializationStateProcessor();
-		},
-
-		nullptr,                          // gpointer user_data
-		nullptr                           // GDestroyNotify user_data_free_func
+		}
 	);
+
+	if (!result)
+	{
+		Logger::fatal(SSTR << "Unable to request an owned name ('" << TheServer->getOwnedName() << "') on the bus");
+		setServerHealth(EFailedInit);
+		shutdown();
+	}
 }
 
 // ---------------------------------------------------------------------------------------------------------------------------------
@@ -996,29 +1478,23 @@ void doOwnedNameAcquire()
 void doBusAcquire()
 {
 	// Acquire a connection to the SYSTEM bus
-	g_bus_get
+	Logger::debug(SSTR << "Using the " << DBusBackend::getInstance().getName() << " D-Bus backend");
+	DBusBackend::getInstance().acquireBus
 	(
-		G_BUS_TYPE_SYSTEM,      // GBusType bus_type
-		nullptr,                // GCancellable *cancellable
-
-		// GAsyncReadyCallback callback
-		[] (GObject */*pSourceObject*/, GAsyncResult *pAsyncResult, gpointer /*pUserData*/)
+		[] (GDBusConnection *pConnection, const char *pErrorMessage)
 		{
-			GError *pError = nullptr;
-			pBusConnection = g_bus_get_finish(pAsyncResult, &pError);
+			pBusConnection = pConnection;
 
 			if (nullptr == pBusConnection)
 			{
-				Logger::fatal(SSTR << "Failed to get bus connection: " << (nullptr == pError ? "Unknown" : pError->message));
+				Logger::fatal(SSTR << "Failed to get bus connection: " << pErrorMessage);
 				setServerHealth(EFailedInit);
 				shutdown();
 			}
 
 			// Continue
 			initializationStateProcessor();
-		},
-
-		nullptr                 // gpointer user_data
+		}
 	);
 }
 
@@ -1063,16 +1539,6 @@ void initializationStateProcessor()
 		return;
 	}
 
-	//
-	// Get BlueZ's ObjectManager
-	//
-	if (nullptr == pBluezObjectManager)
-	{
-		Logger::debug(SSTR << "Getting BlueZ ObjectManager");
-		getBluezObjectManager();
-		return;
-	}
-
 	//
 	// Find the adapter interface
 	//
@@ -1096,7 +1562,7 @@ void initializationStateProcessor()
 	//
 	// Register our object with D-bus
 	//
-	if (registeredObjectIds.empty())
+	if (!DBusBackend::getInstance().hasRegisteredObjects())
 	{
 		Logger::debug(SSTR << "Registering with D-Bus");
 		registerObjects();
@@ -1121,6 +1587,13 @@ void initializationStateProcessor()
 		return;
 	}
 
+	// A warm restart ends here, as we're already running
+	if (bRestartInProgress)
+	{
+		finishRestart();
+		return;
+	}
+
 	// Successful initialization - switch to running state
 	setServerRunState(ERunning);
 }
@@ -1155,6 +1628,20 @@ void runServerThread()
 	// There are alternatives, but using async methods is the recommended way.
 	initializationStateProcessor();
 
+	// Discard any connection events left over from a previous run, then start collecting them on the main loop
+	HciAdapter::ConnectionEvent staleEvent;
+	while (HciAdapter::getInstance().popConnectionEvent(staleEvent)) {}
+	bConnectionEventsScheduled = false;
+	HciAdapter::getInstance().setConnectionEventNotifier(onConnectionEventQueued);
+	HciAdapter::getInstance().addAdapterStateListener(onAdapterStateChanged, nullptr);
+
+	// Start the workers that compute updated values off the main loop
+	bUpdateBatchInFlight = false;
+	if (!updateWorkers.start(kUpdateWorkerThreads))
+	{
+		Logger::warn("Unable to start value computation workers; updated values will be computed on the main loop");
+	}
+
 	Logger::debug(SSTR << "Creating GLib main loop");
 	pMainLoop = g_main_loop_new(NULL, FALSE);
 
@@ -1169,7 +1656,7 @@ void runServerThread()
 			// Try to process some data and if no data is processed, sleep for the requested frequency
 			if (!idleFunc(pUserData))
 			{
-				std::this_thread::sleep_for(std::chrono::milliseconds(kIdleFrequencyMS));
+				Clock::getInstance().sleepMS(kIdleFrequencyMS);
 			}
 
 			// Always return TRUE so our idle remains in tact
@@ -22,13 +22,39 @@
 
 #pragma once
 
+#include <memory>
+
+#include "../include/Gobbledegook.h"
+
 namespace ggk {
 
+struct Server;
+struct PeriodicTimerStats;
+
 // Trigger a graceful, asynchronous shutdown of the server
 //
 // This method is non-blocking and as such, will only trigger the shutdown process but not wait for it
 void shutdown();
 
+// Request a warm restart of a running server, replacing `TheServer` with `pNewServer`
+//
+// The bus connection, owned name and adapter configuration are kept. Only the GATT object tree is replaced and re-registered with
+// BlueZ. This method is non-blocking; use `isRestartPending()` to wait for completion.
+//
+// Returns false if the server isn't running or a restart is already in progress
+bool requestRestart(std::shared_ptr<Server> pNewServer);
+
+// Returns true while a warm restart is in progress
+bool isRestartPending();
+
+// Copies the measurements of the periodic timer that drives tick events into `stats`
+//
+// Returns false if the timer isn't running
+bool getPeriodicTimerStats(PeriodicTimerStats &stats);
+
+// Sets the application's connection event callback (see `ggkRegisterConnectionCallback()`)
+void setConnectionCallback(GGKConnectionCallback callback, void *pUserData);
+
 // Entry point for the asynchronous server thread
 //
 // This method should not be called directly, instead, direct your attention over to `ggkStart()`
@@ -0,0 +1,155 @@
+// Copyright 2017-2019 Paul Nettle
+//
+// This file is part of Gobbledegook.
+//
+// Use of this source code is governed by a BSD-style license that can be found
+// in the LICENSE file in the root of the source tree.
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//
+// >>
+// >>>  INSIDE THIS FILE
+// >>
+//
+// Shares identical property values and names across the server description while it is being built
+//
+// >>
+// >>>  DISCUSSION
+// >>
+//
+// A server description repeats itself. Every characteristic has its own `Flags` array (most of them one of a handful of
+// combinations), its own `Service` path (the same for every characteristic in a service) and its own copy of names like
+// "org.bluez.GattCharacteristic1" and "UUID". Built one at a time, each of those is a separate allocation, and a large generated
+// tree holds thousands of identical copies.
+//
+// Property values are GVariants, which are immutable and reference counted, and a property's value is only ever replaced (never
+// changed in place), so equal values can safely be one value with many references. Names never change once the server is
+// built. While an `InternTable` is alive, `GattProperty` passes its name and value through `intern()` and `DBusInterface` passes its
+// name, and they get back the first equal value or string seen rather than a copy of their own.
+//
+// `Server::Server()` holds a table for the whole of the configurator's run. Values are matched on their type and serialized data.
+// The table holds a reference to each distinct value until it is destroyed, after which the values live as long as the properties
+// that use them. Outside of a table (updating a property while the server runs, for example) nothing is shared.
+//
+// When the table is destroyed it logs what it shared. The byte counts are estimates: a value's serialized size plus
+// `kVariantOverhead` for each duplicate value, and the size of a string (and its heap buffer, if it has one) less the size of a
+// shared pointer for each duplicate string, less what the table's own shared strings cost.
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+#include "InternTable.h"
+#include "../include/Logger.h"
+
+namespace ggk {
+
+// The innermost table on this thread
+static thread_local InternTable *pCurrentTable = nullptr;
+
+// The longest string that std::string holds without a heap buffer (libstdc++)
+static const size_t kInlineStringCapacity = 15;
+
+// Our estimate of what a shared string's control block costs beyond the string itself
+static const size_t kSharedStringOverhead = 16;
+
+// Returns our estimate of the memory used by a std::string holding `str`
+static size_t stringFootprint(const std::string &str)
+{
+	size_t size = sizeof(std::string);
+	if (str.capacity() > kInlineStringCapacity)
+	{
+		size += str.capacity() + 1;
+	}
+
+	return size;
+}
+
+// Makes `intern()` share values and strings on this thread until this object is destroyed
+//
+// The report of what was shared is logged when it is destroyed.
+InternTable::InternTable()
+: valueRequests(0), valuesShared(0), valueBytesSaved(0), stringRequests(0), stringsShared(0), stringBytesSaved(0), pOuter(pCurrentTable)
+{
+	pCurrentTable = this;
+}
+
+InternTable::~InternTable()
+{
+	pCurrentTable = pOuter;
+
+	for (auto &entry : values)
+	{
+		g_variant_unref(entry.second);
+	}
+
+	// Each distinct string costs us a control block and a pointer more than a plain copy would have
+	size_t stringCost = strings.size() * (kSharedStringOverhead + sizeof(std::shared_ptr<const std::string>));
+	long long totalSaved = static_cast<long long>(valueBytesSaved) + static_cast<long long>(stringBytesSaved) - static_cast<long long>(stringCost);
+
+	Logger::info(SSTR << "Interned " << valueRequests << " value(s) into " << values.size() << " (" << valuesShared << " shared) and "
+		<< stringRequests << " name(s) into " << strings.size() << " (" << stringsShared << " shared), saving about " << totalSaved
+		<< " bytes");
+}
+
+// Returns a value equal to `pValue`, shared with earlier callers where possible
+//
+// A floating `pValue` is consumed, so use the result in its place and take your own reference to it with `g_variant_ref_sink()` as
+// you would have with `pValue`. A non-floating `pValue` is left as it is. With no table on this thread, `pValue` is returned.
+GVariant *InternTable::intern(GVariant *pValue)
+{
+	InternTable *pTable = pCurrentTable;
+	if (nullptr == pTable || nullptr == pValue)
+	{
+		return pValue;
+	}
+
+	// Our reference: the floating one if there was one, otherwise a new one
+	g_variant_ref_sink(pValue);
+	pTable->valueRequests += 1;
+
+	gsize size = g_variant_get_size(pValue);
+	std::string key = g_variant_get_type_string(pValue);
+	key.push_back('\0');
+	if (size > 0)
+	{
+		key.append(static_cast<const char *>(g_variant_get_data(pValue)), size);
+	}
+
+	auto it = pTable->values.find(key);
+	if (it == pTable->values.end())
+	{
+		pTable->values[key] = pValue;
+		return pValue;
+	}
+
+	g_variant_unref(pValue);
+	pTable->valuesShared += 1;
+	pTable->valueBytesSaved += size + kVariantOverhead;
+	return it->second;
+}
+
+// Returns a shared copy of `str`
+//
+// With no table on this thread, this is a new copy.
+std::shared_ptr<const std::string> InternTable::intern(const std::string &str)
+{
+	InternTable *pTable = pCurrentTable;
+	if (nullptr == pTable)
+	{
+		return std::make_shared<const std::string>(str);
+	}
+
+	pTable->stringRequests += 1;
+
+	auto it = pTable->strings.find(str);
+	if (it == pTable->strings.end())
+	{
+		std::shared_ptr<const std::string> pShared = std::make_shared<const std::string>(str);
+		pTable->strings[str] = pShared;
+		return pShared;
+	}
+
+	pTable->stringsShared += 1;
+	pTable->stringBytesSaved += stringFootprint(str) - sizeof(std::shared_ptr<const std::string>);
+	return it->second;
+}
+
+}; // namespace ggk
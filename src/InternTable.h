@@ -0,0 +1,77 @@
+// Copyright 2017-2019 Paul Nettle
+//
+// This file is part of Gobbledegook.
+//
+// Use of this source code is governed by a BSD-style license that can be found
+// in the LICENSE file in the root of the source tree.
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//
+// >>
+// >>>  INSIDE THIS FILE
+// >>
+//
+// Shares identical property values and names across the server description while it is being built
+//
+// >>
+// >>>  DISCUSSION
+// >>
+//
+// See the discussion at the top of InternTable.cpp
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+#pragma once
+
+#include <gio/gio.h>
+#include <stddef.h>
+#include <map>
+#include <memory>
+#include <string>
+
+namespace ggk {
+
+class InternTable
+{
+public:
+	// Our estimate of what GLib allocates for each GVariant beyond its serialized data
+	static const size_t kVariantOverhead = 64;
+
+	// Makes `intern()` share values and strings on this thread until this object is destroyed
+	//
+	// The report of what was shared is logged when it is destroyed.
+	InternTable();
+	~InternTable();
+
+	// Returns a value equal to `pValue`, shared with earlier callers where possible
+	//
+	// A floating `pValue` is consumed, so use the result in its place and take your own reference to it with `g_variant_ref_sink()`
+	// as you would have with `pValue`. A non-floating `pValue` is left as it is. With no table on this thread, `pValue` is returned.
+	static GVariant *intern(GVariant *pValue);
+
+	// Returns a shared copy of `str`
+	//
+	// With no table on this thread, this is a new copy.
+	static std::shared_ptr<const std::string> intern(const std::string &str);
+
+private:
+	InternTable(const InternTable &) = delete;
+	InternTable &operator =(const InternTable &) = delete;
+
+	// Interned values, keyed by their type string and serialized data
+	std::map<std::string, GVariant *> values;
+
+	// Interned strings
+	std::map<std::string, std::shared_ptr<const std::string> > strings;
+
+	// What was shared, for the report
+	size_t valueRequests;
+	size_t valuesShared;
+	size_t valueBytesSaved;
+	size_t stringRequests;
+	size_t stringsShared;
+	size_t stringBytesSaved;
+
+	InternTable *pOuter;
+};
+
+}; // namespace ggk
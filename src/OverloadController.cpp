@@ -0,0 +1,247 @@
+// Copyright 2017-2019 Paul Nettle
+//
+// This file is part of Gobbledegook.
+//
+// Use of this source code is governed by a BSD-style license that can be found
+// in the LICENSE file in the root of the source tree.
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//
+// >>
+// >>>  INSIDE THIS FILE
+// >>
+//
+// Watches the load on the main loop and decides how much work to shed
+//
+// >>
+// >>>  DISCUSSION
+// >>
+//
+// Everything the server does runs on a single GLib main loop. During a storm of D-Bus calls or a flood of notifications, that loop
+// falls behind and every client sees its requests time out at once. Rather than let that happen, we shed work in steps.
+//
+// The load is judged from two measurements, sampled by a main loop timer every `kSampleIntervalMS`:
+//
+//     * Queue depth    - the number of entries waiting in the update queue (see `ggkPushUpdateQueue()`)
+//     * Dispatch lag   - how late the sampling timer fires. A busy main loop dispatches its timers late.
+//
+// Each level has a threshold for each measurement (see `kThresholds`.) Crossing either threshold of a level escalates straight to
+// that level, so a sudden storm is handled on the first sample. Recovery is deliberately slower: once both measurements have
+// stayed below half of the current level's thresholds for `kRecoverySamples` consecutive samples, we step down one level. This
+// keeps the server from flapping between levels while a storm dies down.
+//
+// The levels and what they shed are described with `GGKOverloadLevel` in Gobbledegook.h. The rest of the server asks this class
+// what to do (`getTickMultiplier()`, `shouldCoalesceUpdates()`, etc.) and the answers are cheap, since the level is a single
+// atomic value. Every transition is logged and counted in the statistics.
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+
+#include "OverloadController.h"
+#include "../include/Logger.h"
+
+namespace ggk {
+
+// The thresholds for entering a level
+struct OverloadThreshold
+{
+	size_t queueDepth;
+	int dispatchLagMS;
+};
+
+// Indexed by GGKOverloadLevel (EOverloadNormal has no threshold)
+static const OverloadThreshold kThresholds[] =
+{
+	{ 0, 0 },
+	{ 64, 50 },
+	{ 256, 200 },
+	{ 1024, 500 },
+	{ 4096, 1000 }
+};
+
+static const int kLevelCount = EOverloadRejectReads + 1;
+
+static std::atomic<int> currentLevel(EOverloadNormal);
+
+// Sampling state (main loop only)
+static std::chrono::steady_clock::time_point lastSampleTime;
+static bool bHaveLastSample = false;
+static int quietSamples = 0;
+
+// Statistics
+static std::mutex statsMutex;
+static GGKOverloadStats stats = {};
+static std::atomic<unsigned long long> coalescedUpdates(0);
+static std::atomic<unsigned long long> droppedNotifications(0);
+static std::atomic<unsigned long long> rejectedReads(0);
+
+// Moves to a new level, logging and counting the transition
+static void setLevel(int level, size_t queueDepth, int lagMS)
+{
+	int previous = currentLevel.exchange(level);
+	if (previous == level)
+	{
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> guard(statsMutex);
+		stats.transitions += 1;
+		stats.levelEntries[level] += 1;
+	}
+
+	GGKOverloadLevel from = static_cast<GGKOverloadLevel>(previous);
+	GGKOverloadLevel to = static_cast<GGKOverloadLevel>(level);
+	if (level > previous)
+	{
+		Logger::warn(SSTR << "Server overloaded (queue depth " << queueDepth << ", dispatch lag " << lagMS << "ms): " << ggkGetOverloadLevelString(from) << " -> " << ggkGetOverloadLevelString(to));
+	}
+	else
+	{
+		Logger::status(SSTR << "Server load easing (queue depth " << queueDepth << ", dispatch lag " << lagMS << "ms): " << ggkGetOverloadLevelString(from) << " -> " << ggkGetOverloadLevelString(to));
+	}
+}
+
+// Records a load sample (call from the main loop every `kSampleIntervalMS`)
+//
+// The dispatch lag is measured from how late this call is relative to the previous one.
+void OverloadController::sample(size_t queueDepth)
+{
+	std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+
+	int lagMS = 0;
+	if (bHaveLastSample)
+	{
+		int elapsedMS = static_cast<int>(std::chrono::duration_cast<std::chrono::milliseconds>(now - lastSampleTime).count());
+		lagMS = elapsedMS > kSampleIntervalMS ? elapsedMS - kSampleIntervalMS : 0;
+	}
+
+	lastSampleTime = now;
+	bHaveLastSample = true;
+
+	{
+		std::lock_guard<std::mutex> guard(statsMutex);
+		stats.queueDepth = static_cast<int>(queueDepth);
+		stats.dispatchLagMS = lagMS;
+		if (lagMS > stats.maxDispatchLagMS) { stats.maxDispatchLagMS = lagMS; }
+	}
+
+	// Find the highest level whose thresholds are crossed
+	int target = EOverloadNormal;
+	for (int level = kLevelCount - 1; level > EOverloadNormal; --level)
+	{
+		if (queueDepth >= kThresholds[level].queueDepth || lagMS >= kThresholds[level].dispatchLagMS)
+		{
+			target = level;
+			break;
+		}
+	}
+
+	int level = currentLevel.load();
+
+	// Escalate immediately
+	if (target > level)
+	{
+		quietSamples = 0;
+		setLevel(target, queueDepth, lagMS);
+		return;
+	}
+
+	if (level == EOverloadNormal)
+	{
+		return;
+	}
+
+	// Step down one level once things have been quiet for a while
+	const OverloadThreshold &threshold = kThresholds[level];
+	if (queueDepth < threshold.queueDepth / 2 && lagMS < threshold.dispatchLagMS / 2)
+	{
+		quietSamples += 1;
+		if (quietSamples >= kRecoverySamples)
+		{
+			quietSamples = 0;
+			setLevel(level - 1, queueDepth, lagMS);
+		}
+	}
+	else
+	{
+		quietSamples = 0;
+	}
+}
+
+// Returns to `EOverloadNormal` and clears the lag history (but not the statistics)
+void OverloadController::reset()
+{
+	bHaveLastSample = false;
+	quietSamples = 0;
+	setLevel(EOverloadNormal, 0, 0);
+}
+
+// Returns the current level
+GGKOverloadLevel OverloadController::getLevel()
+{
+	return static_cast<GGKOverloadLevel>(currentLevel.load(std::memory_order_relaxed));
+}
+
+// Returns the factor by which tick event periods are stretched at the current level
+int OverloadController::getTickMultiplier()
+{
+	GGKOverloadLevel level = getLevel();
+	if (level >= EOverloadCoalesce) { return 4; }
+	if (level >= EOverloadStretchTicks) { return 2; }
+	return 1;
+}
+
+// Returns true if duplicate update queue entries should be merged
+bool OverloadController::shouldCoalesceUpdates()
+{
+	return getLevel() >= EOverloadCoalesce;
+}
+
+// Records an update that was merged into one already queued
+void OverloadController::countCoalescedUpdate()
+{
+	coalescedUpdates.fetch_add(1, std::memory_order_relaxed);
+}
+
+// Returns true if a notification should be dropped, counting the drop
+bool OverloadController::shouldDropNotification(bool lowPriority)
+{
+	if (!lowPriority || getLevel() < EOverloadDropLowPriority)
+	{
+		return false;
+	}
+
+	droppedNotifications.fetch_add(1, std::memory_order_relaxed);
+	return true;
+}
+
+// Returns true if a read should be rejected, counting the rejection
+bool OverloadController::shouldRejectRead()
+{
+	if (getLevel() < EOverloadRejectReads)
+	{
+		return false;
+	}
+
+	rejectedReads.fetch_add(1, std::memory_order_relaxed);
+	return true;
+}
+
+// Copies the current statistics
+void OverloadController::getStats(GGKOverloadStats &result)
+{
+	{
+		std::lock_guard<std::mutex> guard(statsMutex);
+		result = stats;
+	}
+
+	result.level = getLevel();
+	result.coalescedUpdates = coalescedUpdates.load(std::memory_order_relaxed);
+	result.droppedNotifications = droppedNotifications.load(std::memory_order_relaxed);
+	result.rejectedReads = rejectedReads.load(std::memory_order_relaxed);
+}
+
+}; // namespace ggk
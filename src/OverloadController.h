@@ -0,0 +1,70 @@
+// Copyright 2017-2019 Paul Nettle
+//
+// This file is part of Gobbledegook.
+//
+// Use of this source code is governed by a BSD-style license that can be found
+// in the LICENSE file in the root of the source tree.
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//
+// >>
+// >>>  INSIDE THIS FILE
+// >>
+//
+// Watches the load on the main loop and decides how much work to shed
+//
+// >>
+// >>>  DISCUSSION
+// >>
+//
+// See the discussion at the top of OverloadController.cpp
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+#pragma once
+
+#include <stddef.h>
+
+#include "../include/Gobbledegook.h"
+
+namespace ggk {
+
+class OverloadController
+{
+public:
+	// How often the main loop samples its load
+	static const int kSampleIntervalMS = 100;
+
+	// Number of consecutive quiet samples required before stepping down a level
+	static const int kRecoverySamples = 10;
+
+	// Records a load sample (call from the main loop every `kSampleIntervalMS`)
+	//
+	// The dispatch lag is measured from how late this call is relative to the previous one.
+	static void sample(size_t queueDepth);
+
+	// Returns to `EOverloadNormal` and clears the lag history (but not the statistics)
+	static void reset();
+
+	// Returns the current level
+	static GGKOverloadLevel getLevel();
+
+	// Returns the factor by which tick event periods are stretched at the current level
+	static int getTickMultiplier();
+
+	// Returns true if duplicate update queue entries should be merged
+	static bool shouldCoalesceUpdates();
+
+	// Records an update that was merged into one already queued
+	static void countCoalescedUpdate();
+
+	// Returns true if a notification should be dropped, counting the drop
+	static bool shouldDropNotification(bool lowPriority);
+
+	// Returns true if a read should be rejected, counting the rejection
+	static bool shouldRejectRead();
+
+	// Copies the current statistics
+	static void getStats(GGKOverloadStats &stats);
+};
+
+}; // namespace ggk
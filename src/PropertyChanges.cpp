@@ -0,0 +1,176 @@
+// Copyright 2017-2019 Paul Nettle
+//
+// This file is part of Gobbledegook.
+//
+// Use of this source code is governed by a BSD-style license that can be found
+// in the LICENSE file in the root of the source tree.
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//
+// >>
+// >>>  INSIDE THIS FILE
+// >>
+//
+// Runtime changes to GATT properties, applied and announced in batches
+//
+// >>
+// >>>  DISCUSSION
+// >>
+//
+// Properties such as a characteristic's `Flags` are normally fixed when the server description is built. When one changes while
+// the server is running (see `GattInterface::updatePropertyVariant()`), BlueZ only finds out if we send it a `PropertiesChanged`
+// signal; otherwise it keeps using whatever it read from `GetManagedObjects` when the application was registered.
+//
+// Changes can be made from any thread, so they aren't applied right away. They are queued here and applied on the main loop at
+// the start of each idle pass (see idleFunc() in Init.cpp.) Applying them on the main loop means the values read by
+// `GetManagedObjects` and `Properties.Get` never change underneath a reply that is being built, and every reply sent after a
+// change goes out agrees with the signal that announced it.
+//
+// All of the changes to an interface that were queued since the last pass go out together in one `PropertiesChanged` signal. If
+// a property is changed more than once in that time, only its latest value is applied.
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+#include <map>
+#include <mutex>
+#include <utility>
+
+#include "PropertyChanges.h"
+#include "../include/DBusInterface.h"
+#include "../include/DBusObject.h"
+#include "../include/GattCharacteristic.h"
+#include "../include/GattDescriptor.h"
+#include "../include/GattProperty.h"
+#include "../include/GattService.h"
+#include "../include/Server.h"
+#include "../include/Utils.h"
+#include "../include/Logger.h"
+
+namespace ggk {
+
+// Queued values by property name, for each interface (keyed by path and interface name)
+typedef std::map<std::string, GVariant *> PendingValues;
+typedef std::map<std::pair<std::string, std::string>, PendingValues> PendingInterfaces;
+
+static std::mutex pendingMutex;
+static PendingInterfaces pending;
+
+// Releases the values in `interfaces`
+static void releasePending(PendingInterfaces &interfaces)
+{
+	for (auto &interface : interfaces)
+	{
+		for (auto &value : interface.second)
+		{
+			g_variant_unref(value.second);
+		}
+	}
+
+	interfaces.clear();
+}
+
+// Returns the GATT interface at `path` named `interfaceName`, or nullptr if there isn't one
+static std::shared_ptr<GattInterface> findGattInterface(const DBusObjectPath &path, const std::string &interfaceName)
+{
+	std::shared_ptr<const DBusInterface> pInterface = TheServer->findInterface(path, interfaceName);
+	if (nullptr == pInterface)
+	{
+		return nullptr;
+	}
+
+	// Our interfaces are only handed out as const; this is the one place that changes them, and only on the main loop
+	std::shared_ptr<const GattInterface> pGattInterface;
+	if (std::shared_ptr<const GattService> pService = TRY_GET_CONST_INTERFACE_OF_TYPE(pInterface, GattService)) { pGattInterface = pService; }
+	if (std::shared_ptr<const GattCharacteristic> pCharacteristic = TRY_GET_CONST_INTERFACE_OF_TYPE(pInterface, GattCharacteristic)) { pGattInterface = pCharacteristic; }
+	if (std::shared_ptr<const GattDescriptor> pDescriptor = TRY_GET_CONST_INTERFACE_OF_TYPE(pInterface, GattDescriptor)) { pGattInterface = pDescriptor; }
+
+	return std::const_pointer_cast<GattInterface>(pGattInterface);
+}
+
+// Queues a new value for a property, replacing any value still queued for it (any thread)
+//
+// A floating `pValue` is sunk; otherwise the queue takes its own reference to it.
+void PropertyChanges::queue(const DBusObjectPath &path, const std::string &interfaceName, const std::string &propertyName, GVariant *pValue)
+{
+	g_variant_ref_sink(pValue);
+
+	std::lock_guard<std::mutex> lock(pendingMutex);
+
+	GVariant *&pQueued = pending[std::make_pair(path.toString(), interfaceName)][propertyName];
+	if (nullptr != pQueued)
+	{
+		g_variant_unref(pQueued);
+	}
+
+	pQueued = pValue;
+}
+
+// Applies every queued change and sends one `PropertiesChanged` signal per interface (main loop only)
+//
+// Returns true if anything was applied
+bool PropertyChanges::flush(GDBusConnection *pConnection)
+{
+	PendingInterfaces changes;
+
+	{
+		std::lock_guard<std::mutex> lock(pendingMutex);
+		changes.swap(pending);
+	}
+
+	if (changes.empty())
+	{
+		return false;
+	}
+
+	for (auto &interface : changes)
+	{
+		DBusObjectPath path(interface.first.first);
+		const std::string &interfaceName = interface.first.second;
+
+		std::shared_ptr<GattInterface> pInterface = findGattInterface(path, interfaceName);
+		if (nullptr == pInterface)
+		{
+			Logger::warn(SSTR << "Dropping property changes for missing interface '" << interfaceName << "' at path '" << path << "'");
+			continue;
+		}
+
+		g_auto(GVariantBuilder) changed;
+		g_variant_builder_init(&changed, G_VARIANT_TYPE("a{sv}"));
+		int changedCount = 0;
+
+		for (auto &value : interface.second)
+		{
+			GattProperty *pProperty = pInterface->findProperty(value.first);
+			if (nullptr == pProperty)
+			{
+				Logger::warn(SSTR << "Dropping change to missing property '" << value.first << "' on '" << interfaceName << "' at path '" << path << "'");
+				continue;
+			}
+
+			pProperty->setValue(value.second);
+			g_variant_builder_add(&changed, "{sv}", value.first.c_str(), value.second);
+			changedCount += 1;
+		}
+
+		if (0 == changedCount)
+		{
+			continue;
+		}
+
+		GVariant *pParameters = g_variant_new("(sa{sv}@as)", interfaceName.c_str(), &changed, g_variant_new_strv(nullptr, 0));
+		pInterface->getOwner().emitSignal(pConnection, "org.freedesktop.DBus.Properties", "PropertiesChanged", pParameters);
+
+		Logger::debug(SSTR << "Sent " << changedCount << " property change(s) for '" << interfaceName << "' at path '" << path << "'");
+	}
+
+	releasePending(changes);
+	return true;
+}
+
+// Discards every queued change
+void PropertyChanges::clear()
+{
+	std::lock_guard<std::mutex> lock(pendingMutex);
+	releasePending(pending);
+}
+
+}; // namespace ggk
@@ -0,0 +1,49 @@
+// Copyright 2017-2019 Paul Nettle
+//
+// This file is part of Gobbledegook.
+//
+// Use of this source code is governed by a BSD-style license that can be found
+// in the LICENSE file in the root of the source tree.
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//
+// >>
+// >>>  INSIDE THIS FILE
+// >>
+//
+// Runtime changes to GATT properties, applied and announced in batches
+//
+// >>
+// >>>  DISCUSSION
+// >>
+//
+// See the discussion at the top of PropertyChanges.cpp
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+#pragma once
+
+#include <gio/gio.h>
+#include <string>
+
+#include "../include/DBusObjectPath.h"
+
+namespace ggk {
+
+class PropertyChanges
+{
+public:
+	// Queues a new value for a property, replacing any value still queued for it (any thread)
+	//
+	// A floating `pValue` is sunk; otherwise the queue takes its own reference to it.
+	static void queue(const DBusObjectPath &path, const std::string &interfaceName, const std::string &propertyName, GVariant *pValue);
+
+	// Applies every queued change and sends one `PropertiesChanged` signal per interface (main loop only)
+	//
+	// Returns true if anything was applied
+	static bool flush(GDBusConnection *pConnection);
+
+	// Discards every queued change
+	static void clear();
+};
+
+}; // namespace ggk
@@ -0,0 +1,1137 @@
+// Copyright 2017-2019 Paul Nettle
+//
+// This file is part of Gobbledegook.
+//
+// Use of this source code is governed by a BSD-style license that can be found
+// in the LICENSE file in the root of the source tree.
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//
+// >>
+// >>>  INSIDE THIS FILE
+// >>
+//
+// The sd-bus (libsystemd) implementation of our D-Bus backend
+//
+// >>
+// >>>  DISCUSSION
+// >>
+//
+// This backend is only compiled when configured with `--with-dbus-backend=sdbus`.
+//
+// sd-bus has no worker thread of its own. Instead, we wrap the bus connection in a GSource that is attached to the server's
+// main loop, so all bus traffic is processed on the server thread, exactly as our callbacks expect.
+//
+// Each object in our hierarchy is registered as a plain object callback (`sd_bus_add_object`) rather than a typed vtable.
+// Incoming messages are handled as follows:
+//
+//     org.freedesktop.DBus.Introspectable - answered from the introspection XML generated at registration
+//     org.freedesktop.DBus.Properties     - routed to the dispatch table's getter/setter (GetAll uses the property names
+//                                           captured at registration)
+//     everything else                     - checked against the interfaces and methods captured at registration, then the
+//                                           message body is converted to a GVariant tuple and routed to the dispatch
+//                                           table's method handler
+//
+// GDBus checks each method call against the introspection data before it reaches us, and our method handlers rely on that (they
+// unpack their parameters without checking the types), so we make the same checks: a call to an interface or method we don't
+// have is answered with UnknownInterface or UnknownMethod, and a call whose signature doesn't match the method's input arguments
+// is answered with InvalidArgs.
+//
+// The `GDBusMethodInvocation *` passed to method handlers is the incoming `sd_bus_message` (with a reference held until the reply
+// is sent) and the `GDBusConnection *` is the `sd_bus`. Neither may be passed to GIO.
+//
+// Values are converted between GVariant and the sd-bus wire format directly, one element at a time. Byte arrays (by far the most
+// common payload for GATT values) are copied as a single block.
+//
+// See the discussion at the top of DBusBackend.cpp for more information.
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+#if defined(GGK_DBUS_BACKEND_SDBUS)
+
+#include <errno.h>
+#include <poll.h>
+#include <string.h>
+#include <sstream>
+
+#include "SdBusBackend.h"
+#include "../include/DBusObject.h"
+#include "../include/DBusInterface.h"
+#include "../include/GattInterface.h"
+#include "../include/GattService.h"
+#include "../include/GattCharacteristic.h"
+#include "../include/GattDescriptor.h"
+#include "../include/Logger.h"
+
+namespace ggk {
+
+// Context for an outstanding outgoing method call
+struct SdBusPendingCall
+{
+	SdBusBackend *pBackend;
+	DBusBackend::CallReplyCallback callback;
+	void *pUserData;
+};
+
+// ---------------------------------------------------------------------------------------------------------------------------------
+// GVariant <-> sd-bus message conversion
+// ---------------------------------------------------------------------------------------------------------------------------------
+
+static int appendVariant(sd_bus_message *pMessage, GVariant *pVariant);
+
+// Append each child of a container GVariant
+static int appendChildren(sd_bus_message *pMessage, GVariant *pVariant)
+{
+	gsize count = g_variant_n_children(pVariant);
+	for (gsize i = 0; i < count; ++i)
+	{
+		GVariant *pChild = g_variant_get_child_value(pVariant, i);
+		int result = appendVariant(pMessage, pChild);
+		g_variant_unref(pChild);
+
+		if (result < 0)
+		{
+			return result;
+		}
+	}
+
+	return 0;
+}
+
+// Append a container GVariant as an sd-bus container of the given type
+static int appendContainer(sd_bus_message *pMessage, char type, const std::string &contents, GVariant *pVariant)
+{
+	int result = sd_bus_message_open_container(pMessage, type, contents.c_str());
+	if (result < 0) { return result; }
+
+	result = appendChildren(pMessage, pVariant);
+	if (result < 0) { return result; }
+
+	return sd_bus_message_close_container(pMessage);
+}
+
+// Append a single GVariant value to a message
+static int appendVariant(sd_bus_message *pMessage, GVariant *pVariant)
+{
+	std::string type = g_variant_get_type_string(pVariant);
+
+	switch(type[0])
+	{
+		case 'y': { uint8_t value = g_variant_get_byte(pVariant); return sd_bus_message_append_basic(pMessage, 'y', &value); }
+		case 'b': { int value = g_variant_get_boolean(pVariant) ? 1 : 0; return sd_bus_message_append_basic(pMessage, 'b', &value); }
+		case 'n': { int16_t value = g_variant_get_int16(pVariant); return sd_bus_message_append_basic(pMessage, 'n', &value); }
+		case 'q': { uint16_t value = g_variant_get_uint16(pVariant); return sd_bus_message_append_basic(pMessage, 'q', &value); }
+		case 'i': { int32_t value = g_variant_get_int32(pVariant); return sd_bus_message_append_basic(pMessage, 'i', &value); }
+		case 'u': { uint32_t value = g_variant_get_uint32(pVariant); return sd_bus_message_append_basic(pMessage, 'u', &value); }
+		case 'x': { int64_t value = g_variant_get_int64(pVariant); return sd_bus_message_append_basic(pMessage, 'x', &value); }
+		case 't': { uint64_t value = g_variant_get_uint64(pVariant); return sd_bus_message_append_basic(pMessage, 't', &value); }
+		case 'd': { double value = g_variant_get_double(pVariant); return sd_bus_message_append_basic(pMessage, 'd', &value); }
+		case 's':
+		case 'o':
+		case 'g':
+		{
+			return sd_bus_message_append_basic(pMessage, type[0], g_variant_get_string(pVariant, nullptr));
+		}
+		case 'v':
+		{
+			GVariant *pInner = g_variant_get_variant(pVariant);
+			int result = sd_bus_message_open_container(pMessage, 'v', g_variant_get_type_string(pInner));
+			if (result >= 0) { result = appendVariant(pMessage, pInner); }
+			if (result >= 0) { result = sd_bus_message_close_container(pMessage); }
+			g_variant_unref(pInner);
+			return result;
+		}
+		case 'a':
+		{
+			// Byte arrays go across as a single block
+			if (type == "ay")
+			{
+				gsize size = 0;
+				const void *pData = g_variant_get_fixed_array(pVariant, &size, 1);
+				return sd_bus_message_append_array(pMessage, 'y', pData, size);
+			}
+
+			return appendContainer(pMessage, 'a', type.substr(1), pVariant);
+		}
+		case '(':
+		{
+			return appendContainer(pMessage, 'r', type.substr(1, type.length() - 2), pVariant);
+		}
+		case '{':
+		{
+			return appendContainer(pMessage, 'e', type.substr(1, type.length() - 2), pVariant);
+		}
+		default:
+		{
+			Logger::error(SSTR << "Unsupported GVariant type for sd-bus: '" << type << "'");
+			return -EINVAL;
+		}
+	}
+}
+
+// Append a tuple of parameters as the body of a message
+//
+// Floating references are consumed. A null `pParameters` appends nothing.
+static int appendBody(sd_bus_message *pMessage, GVariant *pParameters)
+{
+	if (nullptr == pParameters)
+	{
+		return 0;
+	}
+
+	g_variant_ref_sink(pParameters);
+
+	int result = 0;
+	if (g_variant_get_type_string(pParameters)[0] == '(')
+	{
+		result = appendChildren(pMessage, pParameters);
+	}
+	else
+	{
+		result = appendVariant(pMessage, pParameters);
+	}
+
+	g_variant_unref(pParameters);
+	return result;
+}
+
+// Release a set of (possibly floating) values collected while reading a container
+static void releaseVariants(std::vector<GVariant *> &values)
+{
+	for (GVariant *pValue : values)
+	{
+		g_variant_unref(pValue);
+	}
+
+	values.clear();
+}
+
+// Read the next value from a message as a (floating) GVariant
+//
+// Returns nullptr at the end of the current container or on error
+static GVariant *readVariant(sd_bus_message *pMessage)
+{
+	char type = 0;
+	const char *pContents = nullptr;
+	if (sd_bus_message_peek_type(pMessage, &type, &pContents) <= 0)
+	{
+		return nullptr;
+	}
+
+	std::string contents = nullptr == pContents ? "" : pContents;
+
+	switch(type)
+	{
+		case 'y': { uint8_t value; if (sd_bus_message_read_basic(pMessage, type, &value) < 0) { return nullptr; } return g_variant_new_byte(value); }
+		case 'b': { int value; if (sd_bus_message_read_basic(pMessage, type, &value) < 0) { return nullptr; } return g_variant_new_boolean(value); }
+		case 'n': { int16_t value; if (sd_bus_message_read_basic(pMessage, type, &value) < 0) { return nullptr; } return g_variant_new_int16(value); }
+		case 'q': { uint16_t value; if (sd_bus_message_read_basic(pMessage, type, &value) < 0) { return nullptr; } return g_variant_new_uint16(value); }
+		case 'i': { int32_t value; if (sd_bus_message_read_basic(pMessage, type, &value) < 0) { return nullptr; } return g_variant_new_int32(value); }
+		case 'u': { uint32_t value; if (sd_bus_message_read_basic(pMessage, type, &value) < 0) { return nullptr; } return g_variant_new_uint32(value); }
+		case 'x': { int64_t value; if (sd_bus_message_read_basic(pMessage, type, &value) < 0) { return nullptr; } return g_variant_new_int64(value); }
+		case 't': { uint64_t value; if (sd_bus_message_read_basic(pMessage, type, &value) < 0) { return nullptr; } return g_variant_new_uint64(value); }
+		case 'd': { double value; if (sd_bus_message_read_basic(pMessage, type, &value) < 0) { return nullptr; } return g_variant_new_double(value); }
+		case 's': { const char *pValue; if (sd_bus_message_read_basic(pMessage, type, &pValue) < 0) { return nullptr; } return g_variant_new_string(pValue); }
+		case 'o': { const char *pValue; if (sd_bus_message_read_basic(pMessage, type, &pValue) < 0) { return nullptr; } return g_variant_new_object_path(pValue); }
+		case 'g': { const char *pValue; if (sd_bus_message_read_basic(pMessage, type, &pValue) < 0) { return nullptr; } return g_variant_new_signature(pValue); }
+		case 'a':
+		{
+			// Byte arrays come across as a single block
+			if (contents == "y")
+			{
+				const void *pData = nullptr;
+				size_t size = 0;
+				if (sd_bus_message_read_array(pMessage, 'y', &pData, &size) < 0) { return nullptr; }
+				return g_variant_new_fixed_array(G_VARIANT_TYPE_BYTE, pData, size, 1);
+			}
+
+			if (sd_bus_message_enter_container(pMessage, 'a', contents.c_str()) < 0) { return nullptr; }
+
+			std::string arrayType = "a" + contents;
+			GVariantBuilder builder;
+			g_variant_builder_init(&builder, G_VARIANT_TYPE(arrayType.c_str()));
+
+			int more = 0;
+			while((more = sd_bus_message_peek_type(pMessage, nullptr, nullptr)) > 0)
+			{
+				GVariant *pElement = readVariant(pMessage);
+				if (nullptr == pElement)
+				{
+					g_variant_builder_clear(&builder);
+					return nullptr;
+				}
+
+				g_variant_builder_add_value(&builder, pElement);
+			}
+
+			if (more < 0 || sd_bus_message_exit_container(pMessage) < 0)
+			{
+				g_variant_builder_clear(&builder);
+				return nullptr;
+			}
+
+			return g_variant_builder_end(&builder);
+		}
+		case 'v':
+		{
+			if (sd_bus_message_enter_container(pMessage, 'v', contents.c_str()) < 0) { return nullptr; }
+
+			GVariant *pInner = readVariant(pMessage);
+			if (nullptr == pInner) { return nullptr; }
+
+			if (sd_bus_message_exit_container(pMessage) < 0)
+			{
+				g_variant_unref(pInner);
+				return nullptr;
+			}
+
+			return g_variant_new_variant(pInner);
+		}
+		case 'r':
+		case 'e':
+		{
+			if (sd_bus_message_enter_container(pMessage, type, contents.c_str()) < 0) { return nullptr; }
+
+			std::vector<GVariant *> children;
+			int more = 0;
+			while((more = sd_bus_message_peek_type(pMessage, nullptr, nullptr)) > 0)
+			{
+				GVariant *pChild = readVariant(pMessage);
+				if (nullptr == pChild)
+				{
+					releaseVariants(children);
+					return nullptr;
+				}
+
+				children.push_back(pChild);
+			}
+
+			if (more < 0 || sd_bus_message_exit_container(pMessage) < 0 || (type == 'e' && children.size() != 2))
+			{
+				releaseVariants(children);
+				return nullptr;
+			}
+
+			if (type == 'e')
+			{
+				return g_variant_new_dict_entry(children[0], children[1]);
+			}
+
+			return g_variant_new_tuple(children.data(), children.size());
+		}
+		default:
+		{
+			Logger::error(SSTR << "Unsupported sd-bus type for GVariant: '" << type << "'");
+			return nullptr;
+		}
+	}
+}
+
+// Read the remaining body of a message as a (floating) GVariant tuple
+static GVariant *readBody(sd_bus_message *pMessage)
+{
+	std::vector<GVariant *> children;
+
+	int more = 0;
+	while((more = sd_bus_message_peek_type(pMessage, nullptr, nullptr)) > 0)
+	{
+		GVariant *pChild = readVariant(pMessage);
+		if (nullptr == pChild)
+		{
+			releaseVariants(children);
+			return nullptr;
+		}
+
+		children.push_back(pChild);
+	}
+
+	if (more < 0)
+	{
+		releaseVariants(children);
+		return nullptr;
+	}
+
+	return g_variant_new_tuple(children.data(), children.size());
+}
+
+// Append a single value wrapped in a variant container (as used by org.freedesktop.DBus.Properties)
+static int appendBoxed(sd_bus_message *pMessage, GVariant *pValue)
+{
+	int result = sd_bus_message_open_container(pMessage, 'v', g_variant_get_type_string(pValue));
+	if (result >= 0) { result = appendVariant(pMessage, pValue); }
+	if (result >= 0) { result = sd_bus_message_close_container(pMessage); }
+	return result;
+}
+
+
+// ---------------------------------------------------------------------------------------------------------------------------------
+// Main loop integration
+// ---------------------------------------------------------------------------------------------------------------------------------
+
+// Our GLib event source, which drives the sd-bus connection from the server's main loop
+struct SdBusSource
+{
+	GSource source;
+	sd_bus *pBus;
+	GPollFD pollFd;
+};
+
+// Returns the number of milliseconds until sd-bus needs attention for a timeout, or -1 if there is no timeout pending
+static gint busTimeoutMS(sd_bus *pBus)
+{
+	uint64_t timeoutUS = 0;
+	if (sd_bus_get_timeout(pBus, &timeoutUS) < 0 || UINT64_MAX == timeoutUS)
+	{
+		return -1;
+	}
+
+	// sd-bus timeouts are absolute on CLOCK_MONOTONIC, as is g_get_monotonic_time()
+	uint64_t nowUS = static_cast<uint64_t>(g_get_monotonic_time());
+	if (timeoutUS <= nowUS)
+	{
+		return 0;
+	}
+
+	return static_cast<gint>((timeoutUS - nowUS + 999) / 1000);
+}
+
+static GSourceFuncs busSourceFuncs =
+{
+	// prepare: update the events we're polling for and report any pending timeout
+	[](GSource *pSource, gint *pTimeoutMS) -> gboolean
+	{
+		SdBusSource *pBusSource = reinterpret_cast<SdBusSource *>(pSource);
+
+		int events = sd_bus_get_events(pBusSource->pBus);
+		pBusSource->pollFd.events = (events & POLLIN ? G_IO_IN : 0) | (events & POLLOUT ? G_IO_OUT : 0);
+
+		*pTimeoutMS = busTimeoutMS(pBusSource->pBus);
+		return 0 == *pTimeoutMS;
+	},
+
+	// check: ready if the socket is ready or a timeout expired
+	[](GSource *pSource) -> gboolean
+	{
+		SdBusSource *pBusSource = reinterpret_cast<SdBusSource *>(pSource);
+		return 0 != pBusSource->pollFd.revents || 0 == busTimeoutMS(pBusSource->pBus);
+	},
+
+	// dispatch: process everything sd-bus has for us
+	[](GSource *pSource, GSourceFunc, gpointer) -> gboolean
+	{
+		SdBusSource *pBusSource = reinterpret_cast<SdBusSource *>(pSource);
+
+		int result = 0;
+		while((result = sd_bus_process(pBusSource->pBus, nullptr)) > 0) {}
+
+		if (result < 0)
+		{
+			Logger::error(SSTR << "Failed to process sd-bus messages: " << strerror(-result));
+		}
+
+		return G_SOURCE_CONTINUE;
+	},
+
+	nullptr, nullptr, nullptr
+};
+
+// ---------------------------------------------------------------------------------------------------------------------------------
+// Construction
+// ---------------------------------------------------------------------------------------------------------------------------------
+
+SdBusBackend::SdBusBackend()
+: pBus(nullptr), pBusSource(nullptr), busAcquiredCallback(nullptr), pNameRequestSlot(nullptr), pNameLostSlot(nullptr),
+  nameAcquiredCallback(nullptr), nameLostCallback(nullptr), dispatch(), nextSubscriptionId(1)
+{
+}
+
+SdBusBackend::~SdBusBackend()
+{
+}
+
+// ---------------------------------------------------------------------------------------------------------------------------------
+// Bus connection
+// ---------------------------------------------------------------------------------------------------------------------------------
+
+// Asynchronously connect to the SYSTEM bus. The callback is always called from the main loop.
+void SdBusBackend::acquireBus(BusAcquiredCallback callback)
+{
+	busAcquiredCallback = callback;
+
+	int result = sd_bus_open_system(&pBus);
+	if (result < 0)
+	{
+		Logger::error(SSTR << "Failed to open the system bus: " << strerror(-result));
+		pBus = nullptr;
+	}
+	else
+	{
+		// Attach the bus to the default main context, which is where our main loop runs
+		pBusSource = reinterpret_cast<SdBusSource *>(g_source_new(&busSourceFuncs, sizeof(SdBusSource)));
+		pBusSource->pBus = pBus;
+		pBusSource->pollFd.fd = sd_bus_get_fd(pBus);
+		pBusSource->pollFd.events = G_IO_IN;
+		pBusSource->pollFd.revents = 0;
+		g_source_add_poll(&pBusSource->source, &pBusSource->pollFd);
+		g_source_attach(&pBusSource->source, nullptr);
+	}
+
+	// sd_bus_open_system() completes the connection asynchronously, but the caller expects to hear about it from the main loop
+	g_idle_add
+	(
+		[](gpointer pUserData) -> gboolean
+		{
+			SdBusBackend *pBackend = static_cast<SdBusBackend *>(pUserData);
+			pBackend->busAcquiredCallback(pBackend->getConnection(), nullptr == pBackend->pBus ? "Unable to open the system bus" : nullptr);
+			return G_SOURCE_REMOVE;
+		},
+		this
+	);
+}
+
+// Release the bus connection
+void SdBusBackend::releaseBus()
+{
+	while (!subscriptions.empty())
+	{
+		unsubscribeSignal(subscriptions.begin()->first);
+	}
+
+	if (nullptr != pBusSource)
+	{
+		g_source_destroy(&pBusSource->source);
+		g_source_unref(&pBusSource->source);
+		pBusSource = nullptr;
+	}
+
+	if (nullptr != pBus)
+	{
+		sd_bus_flush_close_unref(pBus);
+		pBus = nullptr;
+	}
+}
+
+// ---------------------------------------------------------------------------------------------------------------------------------
+// Name ownership
+// ---------------------------------------------------------------------------------------------------------------------------------
+
+// Request an owned name on the bus
+bool SdBusBackend::ownName(const std::string &name, NameCallback acquiredCallback, NameCallback lostCallback)
+{
+	ownedName = name;
+	nameAcquiredCallback = acquiredCallback;
+	nameLostCallback = lostCallback;
+
+	// Watch for the bus taking our name away from us
+	int result = sd_bus_match_signal
+	(
+		pBus, &pNameLostSlot,
+		"org.freedesktop.DBus", "/org/freedesktop/DBus", "org.freedesktop.DBus", "NameLost",
+		[](sd_bus_message *pMessage, void *pUserData, sd_bus_error *) -> int
+		{
+			SdBusBackend *pBackend = static_cast<SdBusBackend *>(pUserData);
+			const char *pName = nullptr;
+			if (sd_bus_message_read(pMessage, "s", &pName) >= 0 && nullptr != pName && pBackend->ownedName == pName)
+			{
+				pBackend->nameLostCallback(pName);
+			}
+			return 0;
+		},
+		this
+	);
+
+	if (result < 0)
+	{
+		Logger::error(SSTR << "Failed to watch for NameLost: " << strerror(-result));
+		return false;
+	}
+
+	// We don't queue for the name (same as GDBus with G_BUS_NAME_OWNER_FLAGS_NONE), so we either get it or we don't
+	result = sd_bus_request_name_async
+	(
+		pBus, &pNameRequestSlot, name.c_str(), 0,
+		[](sd_bus_message *pMessage, void *pUserData, sd_bus_error *) -> int
+		{
+			SdBusBackend *pBackend = static_cast<SdBusBackend *>(pUserData);
+
+			// 1 = primary owner, 4 = already the owner
+			uint32_t reply = 0;
+			if (!sd_bus_message_is_method_error(pMessage, nullptr) && sd_bus_message_read(pMessage, "u", &reply) >= 0 && (1 == reply || 4 == reply))
+			{
+				pBackend->nameAcquiredCallback(pBackend->ownedName.c_str());
+			}
+			else
+			{
+				pBackend->nameLostCallback(pBackend->ownedName.c_str());
+			}
+			return 1;
+		},
+		this
+	);
+
+	if (result < 0)
+	{
+		Logger::error(SSTR << "Failed to request owned name '" << name << "': " << strerror(-result));
+		return false;
+	}
+
+	return true;
+}
+
+// Release our owned name, if we have one
+void SdBusBackend::unownName()
+{
+	if (nullptr != pNameRequestSlot)
+	{
+		sd_bus_slot_unref(pNameRequestSlot);
+		pNameRequestSlot = nullptr;
+	}
+
+	if (nullptr != pNameLostSlot)
+	{
+		sd_bus_slot_unref(pNameLostSlot);
+		pNameLostSlot = nullptr;
+	}
+
+	if (nullptr != pBus && !ownedName.empty())
+	{
+		sd_bus_release_name(pBus, ownedName.c_str());
+	}
+
+	ownedName.clear();
+}
+
+// ---------------------------------------------------------------------------------------------------------------------------------
+// Object registration
+// ---------------------------------------------------------------------------------------------------------------------------------
+
+// Register a single object and (recursively) its children
+bool SdBusBackend::registerNode(const DBusObject &object)
+{
+	std::string path = object.getPath().toString();
+
+	Logger::debug(SSTR << "  + " << path);
+
+	RegisteredNode node;
+	node.pSlot = nullptr;
+
+	// Build the introspection for this node alone, with our children listed by name only
+	node.introspectionXML = "<!DOCTYPE node PUBLIC '-//freedesktop//DTD D-BUS Object Introspection 1.0//EN' 'http://www.freedesktop.org/standards/dbus/1.0/introspect.dtd'>\n";
+	node.introspectionXML += "<node>\n";
+
+	for (std::shared_ptr<const DBusInterface> pInterface : object.getInterfaces())
+	{
+		Logger::debug(SSTR << "      (iface: " << pInterface->getName() << ")");
+		node.introspectionXML += pInterface->generateIntrospectionXML(1);
+
+		// Save the method signatures so we can validate incoming calls
+		std::map<std::string, std::string> &signatures = node.methodSignatures[pInterface->getName()];
+		for (const DBusMethod &method : pInterface->getMethods())
+		{
+			std::string &signature = signatures[method.getName()];
+			for (const std::string &inArg : method.getInArgs())
+			{
+				signature += inArg;
+			}
+		}
+
+		// Save the property names so we can answer GetAll
+		std::vector<std::string> &names = node.propertyNames[pInterface->getName()];
+		std::shared_ptr<const GattInterface> pGattInterface;
+		if (std::shared_ptr<const GattService> pService = TRY_GET_CONST_INTERFACE_OF_TYPE(pInterface, GattService)) { pGattInterface = pService; }
+		if (std::shared_ptr<const GattCharacteristic> pCharacteristic = TRY_GET_CONST_INTERFACE_OF_TYPE(pInterface, GattCharacteristic)) { pGattInterface = pCharacteristic; }
+		if (std::shared_ptr<const GattDescriptor> pDescriptor = TRY_GET_CONST_INTERFACE_OF_TYPE(pInterface, GattDescriptor)) { pGattInterface = pDescriptor; }
+		if (nullptr != pGattInterface)
+		{
+			for (const GattProperty &property : pGattInterface->getProperties())
+			{
+				names.push_back(property.getName());
+			}
+		}
+	}
+
+	for (const DBusObject &child : object.getChildren())
+	{
+		std::string childName = child.getPathNode().toString();
+		if (!childName.empty() && childName[0] == '/') { childName.erase(0, 1); }
+		node.introspectionXML += "  <node name='" + childName + "'/>\n";
+	}
+
+	node.introspectionXML += "</node>\n";
+
+	int result = sd_bus_add_object(pBus, &node.pSlot, path.c_str(), onObjectMessage, this);
+	if (result < 0)
+	{
+		Logger::error(SSTR << "Failed to register object '" << path << "': " << strerror(-result));
+		return false;
+	}
+
+	registeredNodes[path] = node;
+
+	for (const DBusObject &child : object.getChildren())
+	{
+		if (!registerNode(child))
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+// Register an object (and its children) with the bus, dispatching all method calls and property access through `dispatch`
+bool SdBusBackend::registerObject(const DBusObject &object, const Dispatch &dispatch)
+{
+	this->dispatch = dispatch;
+
+	Logger::debug(SSTR << "Registering object hierarchy with D-Bus hierarchy");
+
+	if (!registerNode(object))
+	{
+		// Pretend like we were never here
+		unregisterObjects();
+		return false;
+	}
+
+	return true;
+}
+
+// Unregister all objects registered through `registerObject()`
+void SdBusBackend::unregisterObjects()
+{
+	for (auto &entry : registeredNodes)
+	{
+		sd_bus_slot_unref(entry.second.pSlot);
+	}
+
+	registeredNodes.clear();
+}
+
+// ---------------------------------------------------------------------------------------------------------------------------------
+// Incoming messages
+// ---------------------------------------------------------------------------------------------------------------------------------
+
+// Entry point for all messages sent to one of our registered objects
+int SdBusBackend::onObjectMessage(sd_bus_message *pMessage, void *pUserData, sd_bus_error * /*pRetError*/)
+{
+	SdBusBackend *pBackend = static_cast<SdBusBackend *>(pUserData);
+
+	if (!sd_bus_message_is_method_call(pMessage, nullptr, nullptr))
+	{
+		return 0;
+	}
+
+	const char *pPath = sd_bus_message_get_path(pMessage);
+	auto node = pBackend->registeredNodes.find(nullptr == pPath ? "" : pPath);
+	if (node == pBackend->registeredNodes.end())
+	{
+		return 0;
+	}
+
+	pBackend->stats.methodCallsIn += 1;
+
+	if (sd_bus_message_is_method_call(pMessage, "org.freedesktop.DBus.Introspectable", "Introspect"))
+	{
+		pBackend->stats.methodReplies += 1;
+		return sd_bus_reply_method_return(pMessage, "s", node->second.introspectionXML.c_str());
+	}
+
+	if (sd_bus_message_is_method_call(pMessage, "org.freedesktop.DBus.Properties", nullptr))
+	{
+		return pBackend->handleProperties(pMessage, node->first, node->second);
+	}
+
+	pBackend->handleMethodCall(pMessage, node->first, node->second);
+	return 1;
+}
+
+// Handle org.freedesktop.DBus.Properties (Get, GetAll and Set) for one of our objects
+int SdBusBackend::handleProperties(sd_bus_message *pMessage, const std::string &path, const RegisteredNode &node)
+{
+	const char *pSender = sd_bus_message_get_sender(pMessage);
+	const char *pInterfaceName = nullptr;
+	const char *pPropertyName = nullptr;
+	GError *pError = nullptr;
+
+	stats.methodReplies += 1;
+
+	if (sd_bus_message_is_method_call(pMessage, nullptr, "Get"))
+	{
+		if (sd_bus_message_read(pMessage, "ss", &pInterfaceName, &pPropertyName) < 0)
+		{
+			stats.errors += 1;
+			return sd_bus_reply_method_errorf(pMessage, SD_BUS_ERROR_INVALID_ARGS, "Expected (ss)");
+		}
+
+		GVariant *pValue = dispatch.getProperty(getConnection(), pSender, path.c_str(), pInterfaceName, pPropertyName, &pError, nullptr);
+		if (nullptr == pValue)
+		{
+			stats.errors += 1;
+			int result = sd_bus_reply_method_errorf(pMessage, SD_BUS_ERROR_FAILED, "%s", nullptr == pError ? "Property(get) failed" : pError->message);
+			g_clear_error(&pError);
+			return result;
+		}
+
+		g_variant_ref_sink(pValue);
+
+		sd_bus_message *pReply = nullptr;
+		int result = sd_bus_message_new_method_return(pMessage, &pReply);
+		if (result >= 0) { result = appendBoxed(pReply, pValue); }
+		if (result >= 0) { result = sd_bus_send(nullptr, pReply, nullptr); }
+
+		sd_bus_message_unref(pReply);
+		g_variant_unref(pValue);
+		return result;
+	}
+
+	if (sd_bus_message_is_method_call(pMessage, nullptr, "GetAll"))
+	{
+		if (sd_bus_message_read(pMessage, "s", &pInterfaceName) < 0)
+		{
+			stats.errors += 1;
+			return sd_bus_reply_method_errorf(pMessage, SD_BUS_ERROR_INVALID_ARGS, "Expected (s)");
+		}
+
+		sd_bus_message *pReply = nullptr;
+		int result = sd_bus_message_new_method_return(pMessage, &pReply);
+		if (result >= 0) { result = sd_bus_message_open_container(pReply, 'a', "{sv}"); }
+
+		auto names = node.propertyNames.find(pInterfaceName);
+		if (names != node.propertyNames.end())
+		{
+			for (const std::string &name : names->second)
+			{
+				if (result < 0) { break; }
+
+				GVariant *pValue = dispatch.getProperty(getConnection(), pSender, path.c_str(), pInterfaceName, name.c_str(), &pError, nullptr);
+				g_clear_error(&pError);
+				if (nullptr == pValue) { continue; }
+
+				g_variant_ref_sink(pValue);
+				result = sd_bus_message_open_container(pReply, 'e', "sv");
+				if (result >= 0) { result = sd_bus_message_append_basic(pReply, 's', name.c_str()); }
+				if (result >= 0) { result = appendBoxed(pReply, pValue); }
+				if (result >= 0) { result = sd_bus_message_close_container(pReply); }
+				g_variant_unref(pValue);
+			}
+		}
+
+		if (result >= 0) { result = sd_bus_message_close_container(pReply); }
+		if (result >= 0) { result = sd_bus_send(nullptr, pReply, nullptr); }
+
+		sd_bus_message_unref(pReply);
+		return result;
+	}
+
+	if (sd_bus_message_is_method_call(pMessage, nullptr, "Set"))
+	{
+		char type = 0;
+		const char *pContents = nullptr;
+		GVariant *pValue = nullptr;
+		if (sd_bus_message_read(pMessage, "ss", &pInterfaceName, &pPropertyName) >= 0 &&
+			sd_bus_message_peek_type(pMessage, &type, &pContents) > 0 && 'v' == type &&
+			sd_bus_message_enter_container(pMessage, 'v', pContents) >= 0)
+		{
+			pValue = readVariant(pMessage);
+			sd_bus_message_exit_container(pMessage);
+		}
+
+		if (nullptr == pValue)
+		{
+			stats.errors += 1;
+			return sd_bus_reply_method_errorf(pMessage, SD_BUS_ERROR_INVALID_ARGS, "Expected (ssv)");
+		}
+
+		g_variant_ref_sink(pValue);
+		gboolean success = dispatch.setProperty(getConnection(), pSender, path.c_str(), pInterfaceName, pPropertyName, pValue, &pError, nullptr);
+		g_variant_unref(pValue);
+
+		int result = 0;
+		if (success)
+		{
+			result = sd_bus_reply_method_return(pMessage, nullptr);
+		}
+		else
+		{
+			stats.errors += 1;
+			result = sd_bus_reply_method_errorf(pMessage, SD_BUS_ERROR_FAILED, "%s", nullptr == pError ? "Property(set) failed" : pError->message);
+		}
+
+		g_clear_error(&pError);
+		return result;
+	}
+
+	stats.errors += 1;
+	return sd_bus_reply_method_errorf(pMessage, SD_BUS_ERROR_UNKNOWN_METHOD, "Unknown method");
+}
+
+// Validate an incoming method call, then convert it to a GVariant tuple and dispatch it
+//
+// The message reference we take here is released by `methodReturnValue()` or `methodReturnError()`
+void SdBusBackend::handleMethodCall(sd_bus_message *pMessage, const std::string &path, const RegisteredNode &node)
+{
+	const char *pInterfaceName = sd_bus_message_get_interface(pMessage);
+	const char *pMethodName = sd_bus_message_get_member(pMessage);
+
+	auto interface = node.methodSignatures.find(nullptr == pInterfaceName ? "" : pInterfaceName);
+	if (interface == node.methodSignatures.end())
+	{
+		stats.errors += 1;
+		sd_bus_reply_method_errorf(pMessage, SD_BUS_ERROR_UNKNOWN_INTERFACE, "No such interface '%s' on object at path %s",
+			nullptr == pInterfaceName ? "" : pInterfaceName, path.c_str());
+		return;
+	}
+
+	auto method = interface->second.find(nullptr == pMethodName ? "" : pMethodName);
+	if (method == interface->second.end())
+	{
+		stats.errors += 1;
+		sd_bus_reply_method_errorf(pMessage, SD_BUS_ERROR_UNKNOWN_METHOD, "No such method '%s'", nullptr == pMethodName ? "" : pMethodName);
+		return;
+	}
+
+	const char *pSignature = sd_bus_message_get_signature(pMessage, 1);
+	if (method->second != (nullptr == pSignature ? "" : pSignature))
+	{
+		stats.errors += 1;
+		sd_bus_reply_method_errorf(pMessage, SD_BUS_ERROR_INVALID_ARGS, "Type of message, '(%s)', does not match expected type '(%s)'",
+			nullptr == pSignature ? "" : pSignature, method->second.c_str());
+		return;
+	}
+
+	GVariant *pParameters = readBody(pMessage);
+	if (nullptr == pParameters)
+	{
+		stats.errors += 1;
+		sd_bus_reply_method_errorf(pMessage, SD_BUS_ERROR_INVALID_ARGS, "Unable to read method parameters");
+		return;
+	}
+
+	g_variant_ref_sink(pParameters);
+	sd_bus_message_ref(pMessage);
+
+	dispatch.methodCall
+	(
+		getConnection(),
+		sd_bus_message_get_sender(pMessage),
+		path.c_str(),
+		pInterfaceName,
+		pMethodName,
+		pParameters,
+		reinterpret_cast<GDBusMethodInvocation *>(pMessage),
+		nullptr
+	);
+
+	g_variant_unref(pParameters);
+}
+
+// ---------------------------------------------------------------------------------------------------------------------------------
+// Method replies
+// ---------------------------------------------------------------------------------------------------------------------------------
+
+// Reply to a method invocation with a value
+void SdBusBackend::methodReturnValue(GDBusMethodInvocation *pInvocation, GVariant *pParameters)
+{
+	if (completeLocalInvocation(pInvocation, pParameters, nullptr))
+	{
+		return;
+	}
+
+	sd_bus_message *pCall = reinterpret_cast<sd_bus_message *>(pInvocation);
+	sd_bus_message *pReply = nullptr;
+
+	stats.methodReplies += 1;
+
+	int result = sd_bus_message_new_method_return(pCall, &pReply);
+	if (result >= 0) { result = appendBody(pReply, pParameters); }
+	else if (nullptr != pParameters) { g_variant_unref(g_variant_ref_sink(pParameters)); }
+	if (result >= 0) { result = sd_bus_send(nullptr, pReply, nullptr); }
+
+	if (result < 0)
+	{
+		stats.errors += 1;
+		Logger::error(SSTR << "Failed to send method reply: " << strerror(-result));
+	}
+
+	sd_bus_message_unref(pReply);
+	sd_bus_message_unref(pCall);
+}
+
+// Reply to a method invocation with a D-Bus error
+void SdBusBackend::methodReturnError(GDBusMethodInvocation *pInvocation, const std::string &errorName, const std::string &errorMessage)
+{
+	if (completeLocalInvocation(pInvocation, nullptr, errorName.c_str()))
+	{
+		return;
+	}
+
+	sd_bus_message *pCall = reinterpret_cast<sd_bus_message *>(pInvocation);
+
+	stats.methodReplies += 1;
+	stats.errors += 1;
+
+	sd_bus_reply_method_errorf(pCall, errorName.c_str(), "%s", errorMessage.c_str());
+	sd_bus_message_unref(pCall);
+}
+
+// ---------------------------------------------------------------------------------------------------------------------------------
+// Signals
+// ---------------------------------------------------------------------------------------------------------------------------------
+
+// Emit a signal from `path`
+bool SdBusBackend::emitSignal(GDBusConnection *pConnection, const DBusObjectPath &path, const std::string &interfaceName, const std::string &signalName, GVariant *pParameters)
+{
+	sd_bus *pSignalBus = reinterpret_cast<sd_bus *>(pConnection);
+	sd_bus_message *pSignal = nullptr;
+
+	int result = sd_bus_message_new_signal(pSignalBus, &pSignal, path.c_str(), interfaceName.c_str(), signalName.c_str());
+	if (result >= 0) { result = appendBody(pSignal, pParameters); }
+	else if (nullptr != pParameters) { g_variant_unref(g_variant_ref_sink(pParameters)); }
+	if (result >= 0) { result = sd_bus_send(pSignalBus, pSignal, nullptr); }
+
+	sd_bus_message_unref(pSignal);
+
+	if (result < 0)
+	{
+		stats.errors += 1;
+		Logger::error(SSTR << "Failed to emit signal named '" << signalName << "': " << strerror(-result));
+		return false;
+	}
+
+	stats.signalsOut += 1;
+	return true;
+}
+
+// ---------------------------------------------------------------------------------------------------------------------------------
+// Outgoing method calls
+// ---------------------------------------------------------------------------------------------------------------------------------
+
+// Asynchronously call a method on a remote object
+void SdBusBackend::callMethod(const std::string &busName, const DBusObjectPath &path, const std::string &interfaceName, const std::string &methodName, GVariant *pParameters, CallReplyCallback callback, void *pUserData)
+{
+	stats.methodCallsOut += 1;
+
+	sd_bus_message *pCall = nullptr;
+	int result = sd_bus_message_new_method_call(pBus, &pCall, busName.c_str(), path.c_str(), interfaceName.c_str(), methodName.c_str());
+	if (result >= 0) { result = appendBody(pCall, pParameters); }
+	else if (nullptr != pParameters) { g_variant_unref(g_variant_ref_sink(pParameters)); }
+
+	SdBusPendingCall *pPending = new SdBusPendingCall;
+	pPending->pBackend = this;
+	pPending->callback = callback;
+	pPending->pUserData = pUserData;
+
+	if (result >= 0)
+	{
+		result = sd_bus_call_async
+		(
+			pBus, nullptr, pCall,
+			[](sd_bus_message *pReply, void *pUserData, sd_bus_error *) -> int
+			{
+				SdBusPendingCall *pPending = static_cast<SdBusPendingCall *>(pUserData);
+
+				if (sd_bus_message_is_method_error(pReply, nullptr))
+				{
+					const sd_bus_error *pError = sd_bus_message_get_error(pReply);
+					pPending->pBackend->stats.errors += 1;
+					pPending->callback(nullptr, nullptr == pError || nullptr == pError->message ? "Unknown" : pError->message, pPending->pUserData);
+				}
+				else
+				{
+					GVariant *pResult = readBody(pReply);
+					if (nullptr == pResult)
+					{
+						pPending->pBackend->stats.errors += 1;
+						pPending->callback(nullptr, "Unable to read method reply", pPending->pUserData);
+					}
+					else
+					{
+						g_variant_ref_sink(pResult);
+						pPending->callback(pResult, nullptr, pPending->pUserData);
+						g_variant_unref(pResult);
+					}
+				}
+
+				delete pPending;
+				return 1;
+			},
+			pPending, 0
+		);
+	}
+
+	sd_bus_message_unref(pCall);
+
+	if (result < 0)
+	{
+		stats.errors += 1;
+		callback(nullptr, strerror(-result), pUserData);
+		delete pPending;
+	}
+}
+
+// ---------------------------------------------------------------------------------------------------------------------------------
+// Signal subscriptions
+// ---------------------------------------------------------------------------------------------------------------------------------
+
+// Subscribe to a signal sent by `busName`, filtered on its first argument being the object path `arg0Path`
+//
+// `sd_bus_match_signal()` can't express an arg0path filter, so we build the match rule ourselves.
+unsigned int SdBusBackend::subscribeSignal(const std::string &busName, const std::string &interfaceName, const std::string &signalName, const DBusObjectPath &arg0Path, SignalCallback callback, void *pUserData)
+{
+	std::ostringstream match;
+	match << "type='signal',sender='" << busName << "',interface='" << interfaceName << "',member='" << signalName << "',arg0path='" << arg0Path << "'";
+	std::string rule = match.str();
+
+	Subscription *pSubscription = new Subscription;
+	pSubscription->pSlot = nullptr;
+	pSubscription->callback = callback;
+	pSubscription->pUserData = pUserData;
+
+	int result = sd_bus_add_match
+	(
+		pBus, &pSubscription->pSlot, rule.c_str(),
+		[](sd_bus_message *pMessage, void *pUserData, sd_bus_error *) -> int
+		{
+			Subscription *pSubscription = static_cast<Subscription *>(pUserData);
+
+			GVariant *pParameters = readBody(pMessage);
+			if (nullptr != pParameters)
+			{
+				g_variant_ref_sink(pParameters);
+				pSubscription->callback(sd_bus_message_get_path(pMessage), pParameters, pSubscription->pUserData);
+				g_variant_unref(pParameters);
+			}
+			return 0;
+		},
+		pSubscription
+	);
+
+	if (result < 0)
+	{
+		Logger::error(SSTR << "Failed to add match rule \"" << rule << "\": " << strerror(-result));
+		stats.errors += 1;
+		delete pSubscription;
+		return 0;
+	}
+
+	unsigned int subscriptionId = nextSubscriptionId++;
+	subscriptions[subscriptionId] = pSubscription;
+	return subscriptionId;
+}
+
+// Cancel a subscription made with `subscribeSignal()`
+void SdBusBackend::unsubscribeSignal(unsigned int subscriptionId)
+{
+	auto it = subscriptions.find(subscriptionId);
+	if (it == subscriptions.end())
+	{
+		return;
+	}
+
+	sd_bus_slot_unref(it->second->pSlot);
+	delete it->second;
+	subscriptions.erase(it);
+}
+
+}; // namespace ggk
+
+#endif // GGK_DBUS_BACKEND_SDBUS
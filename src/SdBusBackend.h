@@ -0,0 +1,112 @@
+// Copyright 2017-2019 Paul Nettle
+//
+// This file is part of Gobbledegook.
+//
+// Use of this source code is governed by a BSD-style license that can be found
+// in the LICENSE file in the root of the source tree.
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//
+// >>
+// >>>  INSIDE THIS FILE
+// >>
+//
+// The sd-bus (libsystemd) implementation of our D-Bus backend
+//
+// >>
+// >>>  DISCUSSION
+// >>
+//
+// This backend is only compiled when configured with `--with-dbus-backend=sdbus`.
+//
+// See the discussion at the top of SdBusBackend.cpp
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+#pragma once
+
+#if defined(GGK_DBUS_BACKEND_SDBUS)
+
+#include <systemd/sd-bus.h>
+#include <glib.h>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "../include/DBusBackend.h"
+
+namespace ggk {
+
+struct SdBusSource;
+
+class SdBusBackend : public DBusBackend
+{
+public:
+	SdBusBackend();
+	virtual ~SdBusBackend();
+
+	virtual const char *getName() const { return "sd-bus"; }
+
+	virtual void acquireBus(BusAcquiredCallback callback);
+	virtual void releaseBus();
+	virtual GDBusConnection *getConnection() const { return reinterpret_cast<GDBusConnection *>(pBus); }
+
+	virtual bool ownName(const std::string &name, NameCallback acquiredCallback, NameCallback lostCallback);
+	virtual void unownName();
+
+	virtual bool registerObject(const DBusObject &object, const Dispatch &dispatch);
+	virtual void unregisterObjects();
+	virtual bool hasRegisteredObjects() const { return !registeredNodes.empty(); }
+
+	virtual void methodReturnValue(GDBusMethodInvocation *pInvocation, GVariant *pParameters);
+	virtual void methodReturnError(GDBusMethodInvocation *pInvocation, const std::string &errorName, const std::string &errorMessage);
+
+	virtual bool emitSignal(GDBusConnection *pConnection, const DBusObjectPath &path, const std::string &interfaceName, const std::string &signalName, GVariant *pParameters);
+
+	virtual void callMethod(const std::string &busName, const DBusObjectPath &path, const std::string &interfaceName, const std::string &methodName, GVariant *pParameters, CallReplyCallback callback, void *pUserData);
+
+	virtual unsigned int subscribeSignal(const std::string &busName, const std::string &interfaceName, const std::string &signalName, const DBusObjectPath &arg0Path, SignalCallback callback, void *pUserData);
+	virtual void unsubscribeSignal(unsigned int subscriptionId);
+
+private:
+	// A registered object path, along with what we need to answer the standard interfaces for it
+	struct RegisteredNode
+	{
+		sd_bus_slot *pSlot;
+		std::string introspectionXML;
+		std::map<std::string, std::vector<std::string> > propertyNames;
+
+		// The input signature of each method, by interface name and then method name
+		std::map<std::string, std::map<std::string, std::string> > methodSignatures;
+	};
+
+	// A signal subscription made with `subscribeSignal()`
+	struct Subscription
+	{
+		sd_bus_slot *pSlot;
+		SignalCallback callback;
+		void *pUserData;
+	};
+
+	bool registerNode(const DBusObject &object);
+
+	static int onObjectMessage(sd_bus_message *pMessage, void *pUserData, sd_bus_error *pRetError);
+	int handleProperties(sd_bus_message *pMessage, const std::string &path, const RegisteredNode &node);
+	void handleMethodCall(sd_bus_message *pMessage, const std::string &path, const RegisteredNode &node);
+
+	sd_bus *pBus;
+	SdBusSource *pBusSource;
+	BusAcquiredCallback busAcquiredCallback;
+	std::string ownedName;
+	sd_bus_slot *pNameRequestSlot;
+	sd_bus_slot *pNameLostSlot;
+	NameCallback nameAcquiredCallback;
+	NameCallback nameLostCallback;
+	Dispatch dispatch;
+	std::map<std::string, RegisteredNode> registeredNodes;
+	std::map<unsigned int, Subscription *> subscriptions;
+	unsigned int nextSubscriptionId;
+};
+
+}; // namespace ggk
+
+#endif // GGK_DBUS_BACKEND_SDBUS
@@ -149,6 +149,7 @@
 // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
 
 #include <algorithm>
+#include <atomic>
 
 #include "../include/Server.h"
 #include "../include/ServerUtils.h"
@@ -162,6 +163,7 @@
 #include "../include/GattCharacteristic.h"
 #include "../include/GattDescriptor.h"
 #include "../include/Logger.h"
+#include "InternTable.h"
 
 namespace ggk {
 
@@ -182,6 +184,9 @@ namespace ggk {
 // Our one and only server. It's global.
 std::shared_ptr<Server> TheServer = nullptr;
 
+// The application's batch data getter (this outlives any one server)
+static std::atomic<GGKServerDataBatchGetter> dataBatchGetter(nullptr);
+
 // ---------------------------------------------------------------------------------------------------------------------------------
 // Object implementation
 // ---------------------------------------------------------------------------------------------------------------------------------
@@ -219,6 +224,9 @@ std::shared_ptr<Server> TheServer = nullptr;
 Server::Server(const std::string &serviceName, const std::string &advertisingName, const std::string &advertisingShortName,
        GGKServerConfigurator configurator, GGKServerDataGetter getter, GGKServerDataSetter setter)
 {
+	// Share identical property values and names across the description while we build it (see InternTable.cpp)
+	InternTable internTable;
+
 	// Save our names
 	this->serviceName = serviceName;
 	std::transform(this->serviceName.begin(), this->serviceName.end(), this->serviceName.begin(), ::tolower);
@@ -228,6 +236,7 @@ Server::Server(const std::string &serviceName, const std::string &advertisingNam
 	// Register getter & setter for server data
 	dataGetter = getter;
 	dataSetter = setter;
+	this->configurator = configurator;
 
 	// Adapter configuration flags - set these flags based on how you want the adapter configured
 	enableBREDR = false;
@@ -237,6 +246,9 @@ Server::Server(const std::string &serviceName, const std::string &advertisingNam
 	enableAdvertising = true;
 	enableBondable = false;
 
+	// How often to poll connected devices for their link quality (RSSI and TX power), in milliseconds. Set to 0 to disable.
+	connectionInfoPollIntervalMS = 5000;
+
 	//
 	// Define the server
 	//
@@ -304,6 +316,20 @@ Server::Server(const std::string &serviceName, const std::string &advertisingNam
 	});
 }
 
+// Returns the application's batch data getter, or nullptr if it hasn't registered one (see `ggkRegisterDataBatchGetter()`)
+//
+// Unlike the other delegates, this one outlives any particular server, so it carries across restarts.
+GGKServerDataBatchGetter Server::getDataBatchGetter()
+{
+	return dataBatchGetter.load();
+}
+
+// Registers the application's batch data getter
+void Server::setDataBatchGetter(GGKServerDataBatchGetter getter)
+{
+	dataBatchGetter = getter;
+}
+
 // ---------------------------------------------------------------------------------------------------------------------------------
 // Utilitarian
 // ---------------------------------------------------------------------------------------------------------------------------------
@@ -30,6 +30,7 @@
 
 #include "../include/ServerUtils.h"
 #include "../include/DBusObject.h"
+#include "../include/DBusBackend.h"
 #include "../include/DBusInterface.h"
 #include "../include/GattProperty.h"
 #include "../include/GattService.h"
@@ -38,6 +39,7 @@
 #include "../include/Server.h"
 #include "../include/Logger.h"
 #include "../include/Utils.h"
+#include "../include/Clock.h"
 
 namespace ggk {
 
@@ -191,7 +193,7 @@ void ServerUtils::getManagedObjects(GDBusMethodInvocation *pInvocation)
 	}
 
 	GVariant *pParams = g_variant_new("(a{oa{sa{sv}}})", pObjectArray);
-	g_dbus_method_invocation_return_value(pInvocation, pParams);
+	DBusBackend::getInstance().methodReturnValue(pInvocation, pParams);
 }
 
 // WARNING: Hacky code - don't count on this working properly on all systems
@@ -260,7 +262,7 @@ std::string ServerUtils::getCpuInfo(int16_t &cpuCount)
 // See: https://www.bluetooth.com/specifications/gatt/viewer?attributeXmlFile=org.bluetooth.characteristic.current_time.xml
 GVariant *ServerUtils::gvariantCurrentTime()
 {
-	time_t timeValue = time(nullptr);
+	time_t timeValue = Clock::getInstance().getWallTime();
 	struct tm *pTimeStruct = localtime(&timeValue);
 	guint16 year = pTimeStruct->tm_year + 1900;
 	guint8 wday = guint8(pTimeStruct->tm_wday == 0 ? 7 : pTimeStruct->tm_wday);
@@ -289,7 +291,7 @@ GVariant *ServerUtils::gvariantCurrentTime()
 GVariant *ServerUtils::gvariantLocalTime()
 {
 	tzset();
-	time_t timeValue = time(nullptr);
+	time_t timeValue = Clock::getInstance().getWallTime();
 	struct tm *pTimeStruct = localtime(&timeValue);
 
 	gint8 utcOffset = -gint8(timezone / 60 / 15); // UTC time (uses 15-minute increments, 0 = UTC time)
@@ -0,0 +1,182 @@
+// Copyright 2017-2019 Paul Nettle
+//
+// This file is part of Gobbledegook.
+//
+// Use of this source code is governed by a BSD-style license that can be found
+// in the LICENSE file in the root of the source tree.
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//
+// >>
+// >>>  INSIDE THIS FILE
+// >>
+//
+// A named group of related values that are published and read as a single consistent snapshot
+//
+// >>
+// >>>  DISCUSSION
+// >>
+//
+// Values are normally shared with the server one at a time through `GGKServerDataSetter`/`GGKServerDataGetter`. That's fine for
+// independent values, but related values (the x/y/z axes of an accelerometer, or a reading and its timestamp) are updated by the
+// application as several separate writes. A `ReadValue` or notification on the server thread can see some members from the new
+// update and some from the old one.
+//
+// A snapshot group holds all of the related values as one fixed-size block (typically a plain struct.) The application publishes
+// the whole block at once and the server reads a consistent copy of the whole block.
+//
+// The block is stored in a versioned double buffer. A producer always writes into the slot that readers are NOT currently
+// directed to, then flips `currentSlot` to point at it. Each slot also carries a sequence number (a seqlock) that is odd while
+// the slot is being written. A reader copies the current slot and accepts the copy only if the sequence number was even and
+// unchanged across the copy.
+//
+// Because producers write to the other slot, a reader can only be disturbed if two complete publishes land during its copy. The
+// reader then simply tries again, up to `kMaxReadAttempts` times. Readers never take a lock, so the server thread is never
+// stalled behind a producer. Producers are serialized with each other through `publishMutex`.
+//
+// Groups are never destroyed. They live in a fixed table so that `find()` can be lock-free.
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+#include <string.h>
+
+#include "../include/SnapshotGroup.h"
+#include "../include/Logger.h"
+
+namespace ggk {
+
+// Our table of groups. Entries [0, groupCount) are fully constructed and never change.
+static SnapshotGroup *groups[SnapshotGroup::kMaxGroups];
+static std::atomic<int> groupCount(0);
+static std::mutex groupCreateMutex;
+
+SnapshotGroup::SnapshotGroup(const std::string &name, size_t size)
+: name(name), size(size), currentSlot(0), version(0), readFailures(0)
+{
+	for (Slot &slot : slots)
+	{
+		slot.sequence.store(0, std::memory_order_relaxed);
+		slot.version = 0;
+		slot.data.assign(size, 0);
+	}
+}
+
+// Creates a new group of `size` bytes with the given name, initialized to all zeros
+//
+// If a group with this name already exists and has the same size, the existing group is returned. Otherwise, returns nullptr on
+// failure.
+SnapshotGroup *SnapshotGroup::create(const std::string &name, size_t size)
+{
+	if (name.empty() || size == 0)
+	{
+		Logger::error("Snapshot groups require a name and a non-zero size");
+		return nullptr;
+	}
+
+	std::lock_guard<std::mutex> guard(groupCreateMutex);
+
+	SnapshotGroup *pExisting = find(name);
+	if (nullptr != pExisting)
+	{
+		if (pExisting->getSize() == size) { return pExisting; }
+
+		Logger::error(SSTR << "Snapshot group '" << name << "' already exists with a size of " << pExisting->getSize() << " bytes");
+		return nullptr;
+	}
+
+	int count = groupCount.load(std::memory_order_relaxed);
+	if (count >= kMaxGroups)
+	{
+		Logger::error(SSTR << "Unable to create snapshot group '" << name << "': the maximum of " << kMaxGroups << " groups has been reached");
+		return nullptr;
+	}
+
+	groups[count] = new SnapshotGroup(name, size);
+	groupCount.store(count + 1, std::memory_order_release);
+	return groups[count];
+}
+
+// Returns the group with the given name, or nullptr if no such group exists
+//
+// This does not take any locks and is safe to call from any thread.
+SnapshotGroup *SnapshotGroup::find(const std::string &name)
+{
+	int count = groupCount.load(std::memory_order_acquire);
+	for (int i = 0; i < count; ++i)
+	{
+		if (groups[i]->getName() == name) { return groups[i]; }
+	}
+
+	return nullptr;
+}
+
+// Publishes a complete snapshot of the group
+//
+// `dataSize` must match the size of the group. Producers are serialized with each other, but never with readers.
+//
+// Returns true on success, false if the size does not match
+bool SnapshotGroup::publish(const void *pData, size_t dataSize)
+{
+	if (nullptr == pData || dataSize != size)
+	{
+		Logger::error(SSTR << "Snapshot group '" << name << "' expects " << size << " bytes, but " << dataSize << " were published");
+		return false;
+	}
+
+	std::lock_guard<std::mutex> guard(publishMutex);
+
+	// Write into the slot readers are not directed to
+	int next = 1 - currentSlot.load(std::memory_order_relaxed);
+	Slot &slot = slots[next];
+
+	slot.sequence.fetch_add(1, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+
+	memcpy(slot.data.data(), pData, size);
+	slot.version = version.load(std::memory_order_relaxed) + 1;
+
+	slot.sequence.fetch_add(1, std::memory_order_release);
+
+	// Direct readers to the new snapshot
+	currentSlot.store(next, std::memory_order_release);
+	version.store(slot.version, std::memory_order_release);
+	return true;
+}
+
+// Copies the most recently published snapshot into `pData`
+//
+// `dataSize` must match the size of the group. If `pVersion` is not null, it receives the version of the snapshot that was copied.
+//
+// This method never blocks. Returns false if the size does not match or if a consistent copy could not be made within
+// `kMaxReadAttempts` attempts, in which case `pData` is left in an undefined state.
+bool SnapshotGroup::read(void *pData, size_t dataSize, uint64_t *pVersion) const
+{
+	if (nullptr == pData || dataSize != size)
+	{
+		Logger::error(SSTR << "Snapshot group '" << name << "' holds " << size << " bytes, but " << dataSize << " were requested");
+		return false;
+	}
+
+	for (int attempt = 0; attempt < kMaxReadAttempts; ++attempt)
+	{
+		const Slot &slot = slots[currentSlot.load(std::memory_order_acquire)];
+
+		uint32_t before = slot.sequence.load(std::memory_order_acquire);
+		if ((before & 1) != 0) { continue; }
+
+		memcpy(pData, slot.data.data(), size);
+		uint64_t slotVersion = slot.version;
+
+		std::atomic_thread_fence(std::memory_order_acquire);
+		if (slot.sequence.load(std::memory_order_relaxed) == before)
+		{
+			if (nullptr != pVersion) { *pVersion = slotVersion; }
+			return true;
+		}
+	}
+
+	readFailures.fetch_add(1, std::memory_order_relaxed);
+	Logger::debug(SSTR << "Snapshot group '" << name << "' is being published too quickly to read a consistent copy");
+	return false;
+}
+
+}; // namespace ggk
@@ -0,0 +1,82 @@
+// Copyright 2017-2019 Paul Nettle
+//
+// This file is part of Gobbledegook.
+//
+// Use of this source code is governed by a BSD-style license that can be found
+// in the LICENSE file in the root of the source tree.
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//
+// >>
+// >>>  INSIDE THIS FILE
+// >>
+//
+// A fixed-size, lock-free queue for handing items from one thread to another
+//
+// >>
+// >>>  DISCUSSION
+// >>
+//
+// This is a single-producer, single-consumer ring buffer. Exactly one thread may push and exactly one (other) thread may pop.
+// Neither side ever blocks or allocates: `push()` fails if the queue is full and `pop()` fails if it is empty.
+//
+// The producer owns `tail` and the consumer owns `head`. Each side publishes its index with release semantics after touching a
+// slot, and reads the other side's index with acquire semantics before touching one, so a slot is never read and written at the
+// same time.
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+#pragma once
+
+#include <stddef.h>
+#include <atomic>
+
+namespace ggk {
+
+template<typename T, size_t Capacity>
+class SpscQueue
+{
+public:
+	SpscQueue()
+	: head(0), tail(0)
+	{
+	}
+
+	// Adds an item to the queue (producer thread only)
+	//
+	// Returns false if the queue is full
+	bool push(const T &item)
+	{
+		size_t currentTail = tail.load(std::memory_order_relaxed);
+		if (currentTail - head.load(std::memory_order_acquire) >= Capacity)
+		{
+			return false;
+		}
+
+		slots[currentTail % Capacity] = item;
+		tail.store(currentTail + 1, std::memory_order_release);
+		return true;
+	}
+
+	// Removes the oldest item from the queue (consumer thread only)
+	//
+	// Returns false if the queue is empty
+	bool pop(T &item)
+	{
+		size_t currentHead = head.load(std::memory_order_relaxed);
+		if (currentHead == tail.load(std::memory_order_acquire))
+		{
+			return false;
+		}
+
+		item = slots[currentHead % Capacity];
+		head.store(currentHead + 1, std::memory_order_release);
+		return true;
+	}
+
+private:
+	T slots[Capacity];
+	std::atomic<size_t> head;
+	std::atomic<size_t> tail;
+};
+
+}; // namespace ggk
@@ -0,0 +1,147 @@
+// Copyright 2017-2019 Paul Nettle
+//
+// This file is part of Gobbledegook.
+//
+// Use of this source code is governed by a BSD-style license that can be found
+// in the LICENSE file in the root of the source tree.
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//
+// >>
+// >>>  INSIDE THIS FILE
+// >>
+//
+// A small pool of worker threads for computing characteristic values off the main loop
+//
+// >>
+// >>>  DISCUSSION
+// >>
+//
+// When many characteristics are updated at once, fetching their data and encoding their values one at a time on the main loop
+// serializes the whole burst on a single core. Characteristics that provide an `onComputeValue` callback have that work done here,
+// in parallel, while the main loop only emits the resulting change notifications (see the idle processing in Init.cpp.)
+//
+// This is a plain job queue: a mutex and condition variable guarding a deque of jobs. Jobs are coarse (one per characteristic
+// value) so there is no need for anything more elaborate.
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+#include <system_error>
+
+#include "WorkerPool.h"
+#include "../include/Logger.h"
+
+namespace ggk {
+
+WorkerPool::WorkerPool()
+: stopping(false)
+{
+}
+
+// Stops the pool (see `stop()`)
+WorkerPool::~WorkerPool()
+{
+	stop();
+}
+
+// Starts `threadCount` worker threads
+//
+// If `threadCount` is 0, one thread per hardware thread is started.
+//
+// Returns true on success, or false if the pool is already running or no threads could be started
+bool WorkerPool::start(unsigned int threadCount)
+{
+	if (isRunning())
+	{
+		return false;
+	}
+
+	if (threadCount == 0)
+	{
+		threadCount = std::thread::hardware_concurrency();
+		if (threadCount == 0) { threadCount = 1; }
+	}
+
+	stopping = false;
+
+	for (unsigned int i = 0; i < threadCount; ++i)
+	{
+		try
+		{
+			threads.push_back(std::thread(&WorkerPool::runWorker, this));
+		}
+		catch(std::system_error &ex)
+		{
+			Logger::warn(SSTR << "Worker thread was unable to start (code " << ex.code() << "): " << ex.what());
+			break;
+		}
+	}
+
+	Logger::debug(SSTR << "Started " << threads.size() << " value computation worker(s)");
+	return isRunning();
+}
+
+// Stops the worker threads, waiting for them to finish the jobs already queued
+void WorkerPool::stop()
+{
+	{
+		std::lock_guard<std::mutex> guard(jobsMutex);
+		stopping = true;
+	}
+
+	jobsAvailable.notify_all();
+
+	for (std::thread &thread : threads)
+	{
+		if (thread.joinable())
+		{
+			thread.join();
+		}
+	}
+
+	threads.clear();
+}
+
+// Queues a job to run on the next available worker
+//
+// Returns false if the pool isn't running
+bool WorkerPool::submit(const Job &job)
+{
+	if (!isRunning())
+	{
+		return false;
+	}
+
+	{
+		std::lock_guard<std::mutex> guard(jobsMutex);
+		jobs.push_back(job);
+	}
+
+	jobsAvailable.notify_one();
+	return true;
+}
+
+// Entry point for each worker thread
+void WorkerPool::runWorker()
+{
+	while (true)
+	{
+		Job job;
+
+		{
+			std::unique_lock<std::mutex> lock(jobsMutex);
+			jobsAvailable.wait(lock, [this] { return stopping || !jobs.empty(); });
+
+			if (jobs.empty())
+			{
+				return;
+			}
+
+			job = jobs.front();
+			jobs.pop_front();
+		}
+
+		job();
+	}
+}
+
+}; // namespace ggk
@@ -0,0 +1,77 @@
+// Copyright 2017-2019 Paul Nettle
+//
+// This file is part of Gobbledegook.
+//
+// Use of this source code is governed by a BSD-style license that can be found
+// in the LICENSE file in the root of the source tree.
+
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//
+// >>
+// >>>  INSIDE THIS FILE
+// >>
+//
+// A small pool of worker threads for computing characteristic values off the main loop
+//
+// >>
+// >>>  DISCUSSION
+// >>
+//
+// See the discussion at the top of WorkerPool.cpp
+// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace ggk {
+
+class WorkerPool
+{
+public:
+	// A unit of work to run on a worker thread
+	typedef std::function<void()> Job;
+
+	WorkerPool();
+
+	// Stops the pool (see `stop()`)
+	~WorkerPool();
+
+	// Starts `threadCount` worker threads
+	//
+	// If `threadCount` is 0, one thread per hardware thread is started.
+	//
+	// Returns true on success, or false if the pool is already running or no threads could be started
+	bool start(unsigned int threadCount);
+
+	// Stops the worker threads, waiting for them to finish the jobs already queued
+	void stop();
+
+	// Returns true if the pool has running workers
+	bool isRunning() const { return !threads.empty(); }
+
+	// Returns the number of worker threads
+	size_t getThreadCount() const { return threads.size(); }
+
+	// Queues a job to run on the next available worker
+	//
+	// Returns false if the pool isn't running
+	bool submit(const Job &job);
+
+private:
+	// Entry point for each worker thread
+	void runWorker();
+
+	std::vector<std::thread> threads;
+	std::deque<Job> jobs;
+	std::mutex jobsMutex;
+	std::condition_variable jobsAvailable;
+	bool stopping;
+};
+
+}; // namespace ggk
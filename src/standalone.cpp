@@ -93,6 +93,8 @@
 // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
 
 #include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
 #include <iostream>
 #include <thread>
 #include <sstream>
@@ -123,6 +125,16 @@ static uint8_t serverDataBatteryLevel = 78;
 // The text string ("text/string") used by our custom text string service (see Server.cpp)
 static std::string serverDataTextString = "Hello, world!";
 
+//
+// Generated services
+//
+
+// The number of generated services to add to the server description (see the `-g` option)
+static int generatedServiceCount = 0;
+
+// The number of characteristics in each generated service
+static const int kGeneratedCharacteristicCount = 4;
+
 //
 // Logging
 //
@@ -170,6 +182,27 @@ void signalHandler(int signum)
 	}
 }
 
+//
+// Connection events
+//
+
+// Called by the server (on its own thread) with each batch of connections and disconnections
+void onConnectionEvents(const GGKConnectionEvent *pEvents, int eventCount, void * /*pUserData*/)
+{
+	for (int i = 0; i < eventCount; ++i)
+	{
+		const GGKConnectionEvent &event = pEvents[i];
+		if (event.connected)
+		{
+			LogStatus((std::string("Device connected: ") + event.address).c_str());
+		}
+		else
+		{
+			LogStatus((std::string("Device disconnected: ") + event.address + " (reason " + std::to_string(event.reason) + ")").c_str());
+		}
+	}
+}
+
 //
 // Server data management
 //
@@ -458,7 +491,59 @@ void serverConfigurator(ggk::DBusObject &dBusObject)
 			.gattDescriptorEnd()
 
 		.gattCharacteristicEnd()
+	.gattServiceEnd()
+
+	// Custom batch read service (custom: 0000C001-1E3D-FAD4-74E2-97A033F1BFEE)
+	//
+	// A client that wants several of the values above can write their UUIDs to this characteristic and read them all back in a
+	// single frame, rather than reading each characteristic separately. The values come from the `onReadValue` methods above.
+	.gattServiceBegin("batch", "0000C001-1E3D-FAD4-74E2-97A033F1BFEE")
+
+		// Characteristic: Batch read (custom: 0000C002-1E3D-FAD4-74E2-97A033F1BFEE)
+		.gattBatchReadCharacteristicBegin("read", "0000C002-1E3D-FAD4-74E2-97A033F1BFEE")
+		.gattCharacteristicEnd()
 	.gattServiceEnd(); // << -- NOTE THE SEMICOLON
+
+	// Generated services (custom: 0000D001-1E3D-FAD4-74E2-97A033F1BFEE)
+	//
+	// With the `-g` option, we add that many instances of a custom service (a service may appear more than once), each with the
+	// same set of characteristics. This makes a large, repetitive server description for measuring what a description costs to
+	// build and to hold. Run with `-v` to see what the server shared while building it (see InternTable.cpp).
+	for (int serviceIndex = 0; serviceIndex < generatedServiceCount; ++serviceIndex)
+	{
+		ggk::GattService &service = dBusObject.gattServiceBegin("generated" + std::to_string(serviceIndex), "0000D001-1E3D-FAD4-74E2-97A033F1BFEE");
+
+		for (int characteristicIndex = 0; characteristicIndex < kGeneratedCharacteristicCount; ++characteristicIndex)
+		{
+			// Characteristic: Generated value (custom: 0000D002-1E3D-FAD4-74E2-97A033F1BFEE and up)
+			char uuid[37];
+			snprintf(uuid, sizeof(uuid), "0000D%03X-1E3D-FAD4-74E2-97A033F1BFEE", 0x002 + characteristicIndex);
+
+			service.gattCharacteristicBegin("value" + std::to_string(characteristicIndex), uuid, {"read", "notify"})
+
+				// Standard characteristic "ReadValue" method call
+				.onReadValue(CHARACTERISTIC_METHOD_CALLBACK_LAMBDA
+				{
+					self.methodReturnValue(pInvocation, "Generated", true);
+				})
+
+				// GATT Descriptor: Characteristic User Description (0x2901)
+				.gattDescriptorBegin("description", "2901", {"read"})
+
+					// Standard descriptor "ReadValue" method call
+					.onReadValue(DESCRIPTOR_METHOD_CALLBACK_LAMBDA
+					{
+						const char *pDescription = "A generated characteristic for measuring large server descriptions";
+						self.methodReturnValue(pInvocation, pDescription, true);
+					})
+
+				.gattDescriptorEnd()
+
+			.gattCharacteristicEnd();
+		}
+
+		service.gattServiceEnd();
+	}
 }
 
 // Called by the server when it wants to retrieve a named value
@@ -536,6 +621,8 @@ int dataSetter(const char *pName, const void *pData)
 int main(int argc, char **ppArgv)
 {
 	// A basic command-line parser
+	bool profile = false;
+	bool timing = false;
 	for (int i = 1; i < argc; ++i)
 	{
 		std::string arg = ppArgv[i];
@@ -551,11 +638,24 @@ int main(int argc, char **ppArgv)
 		{
 			logLevel = Debug;
 		}
+		else if (arg == "-p")
+		{
+			profile = true;
+			ggkProfilingEnable(1);
+		}
+		else if (arg == "-t")
+		{
+			timing = true;
+		}
+		else if (arg == "-g" && i + 1 < argc)
+		{
+			generatedServiceCount = std::max(atoi(ppArgv[++i]), 0);
+		}
 		else
 		{
 			LogFatal((std::string("Unknown parameter: '") + arg + "'").c_str());
 			LogFatal("");
-			LogFatal("Usage: standalone [-q | -v | -d]");
+			LogFatal("Usage: standalone [-q | -v | -d] [-p] [-t] [-g <services>]");
 			return -1;
 		}
 	}
@@ -574,6 +674,9 @@ int main(int argc, char **ppArgv)
 	ggkLogRegisterAlways(LogAlways);
 	ggkLogRegisterTrace(LogTrace);
 
+	// Find out when devices come and go
+	ggkRegisterConnectionCallback(onConnectionEvents, nullptr);
+
 	// Start the server's ascync processing
 	//
 	// This starts the server on a thread and begins the initialization process
@@ -597,6 +700,16 @@ int main(int argc, char **ppArgv)
 
 		serverDataBatteryLevel = std::max(serverDataBatteryLevel - 1, 0);
 		ggkNofifyUpdatedCharacteristic("/com/gobbledegook/battery/level");
+
+		// Report how well the periodic timer (which drives our time/current notifications) is keeping to its grid
+		GGKTimerStats stats;
+		if (timing && ggkGetTimerStats(&stats))
+		{
+			LogAlways((std::string("Periodic timer: ") + std::to_string(stats.calls) + " calls, "
+				+ std::to_string(stats.missedDeadlines) + " missed, lateness "
+				+ std::to_string(stats.minLatenessUS) + "/" + std::to_string(stats.meanLatenessUS) + "/" + std::to_string(stats.maxLatenessUS)
+				+ "us (min/mean/max), jitter " + std::to_string(stats.jitterUS) + "us, drift " + std::to_string(stats.driftUS) + "us").c_str());
+		}
 	}
 
 	// Wait for the server to come to a complete stop (CTRL-C from the command line)
@@ -605,6 +718,12 @@ int main(int argc, char **ppArgv)
 		return -1;
 	}
 
+	// Report the most expensive handlers if we were profiling
+	if (profile)
+	{
+		ggkProfilingDump(10);
+	}
+
 	// Return the final server health status as a success (0) or error (-1)
   	return ggkGetServerHealth() == EOk ? 0 : 1;
 }